@@ -0,0 +1,151 @@
+#include "compiler_context.h"
+
+#include "profiler.h"
+
+namespace
+{
+	const Error FULL_FIELD_DATA{ ErrorCode::FullFieldData, "Script field data is full" };
+	const Error TOO_MANY_VARIABLES{ ErrorCode::TooManyVariables, "Too many user variables" };
+}
+
+CompilerContext::CompilerContext() :
+	_script{},
+	_stream{ _script, 1 },
+	_constants{},
+	_internals{},
+	_variables{},
+	_fieldCount{ 0 },
+	_types{},
+	_diagnostics{},
+	_sourceMap{},
+	_location{}
+{
+	_script.setVersion();
+}
+
+Script& CompilerContext::script() { return _script; }
+const Script& CompilerContext::script() const { return _script; }
+
+ScriptCodeStream& CompilerContext::stream() { return _stream; }
+
+void CompilerContext::emit(ScriptCodeBuilder& fragment)
+{
+	if (!tryEmit(fragment))
+		throw FullCodeData{};
+}
+
+Result<void> CompilerContext::tryEmit(ScriptCodeBuilder& fragment)
+{
+	const uint16_t first = _stream.size();
+	const Result<void> result = _stream.tryFlush(fragment);
+	if (result)
+	{
+		for (uint16_t index = first; index < _stream.size(); ++index)
+			_sourceMap.add(SourceMapTarget::Code, index, _location);
+	}
+	return result;
+}
+
+uint16_t CompilerContext::constantField(const field_value_t value) { return unwrap(tryConstantField(value)); }
+uint16_t CompilerContext::internalField(const ScriptCode internal) { return unwrap(tryInternalField(internal)); }
+uint16_t CompilerContext::variableField(const std::string& name) { return unwrap(tryVariableField(name)); }
+
+Result<uint16_t> CompilerContext::tryConstantField(const field_value_t value)
+{
+	const auto& it = _constants.find(value);
+	if (it != _constants.end())
+		return it->second;
+
+	const Result<uint16_t> index = allocateField({ FieldType::Constant, value });
+	if (index)
+		_constants[value] = index.value();
+	return index;
+}
+
+Result<uint16_t> CompilerContext::tryInternalField(const ScriptCode internal)
+{
+	const auto& it = _internals.find(internal);
+	if (it != _internals.end())
+		return it->second;
+
+	const Result<uint16_t> index = allocateField({ FieldType::Internal, internal });
+	if (index)
+		_internals[internal] = index.value();
+	return index;
+}
+
+Result<uint16_t> CompilerContext::tryVariableField(const std::string& name)
+{
+	const auto& it = _variables.find(name);
+	if (it != _variables.end())
+		return it->second;
+
+	if (_variables.size() >= MAX_VARS)
+		return TOO_MANY_VARIABLES;
+
+	const Result<uint16_t> index = allocateField({ FieldType::User, static_cast<field_value_t>(_variables.size()) });
+	if (index)
+		_variables[name] = index.value();
+	return index;
+}
+
+bool CompilerContext::hasVariable(const std::string& name) const { return _variables.find(name) != _variables.end(); }
+
+const TypeRegistry& CompilerContext::types() const { return _types; }
+
+uint16_t CompilerContext::fieldCount() const { return _fieldCount; }
+uint16_t CompilerContext::variableCount() const { return static_cast<uint16_t>(_variables.size()); }
+
+Diagnostics& CompilerContext::diagnostics() { return _diagnostics; }
+const Diagnostics& CompilerContext::diagnostics() const { return _diagnostics; }
+
+SourceMap& CompilerContext::sourceMap() { return _sourceMap; }
+const SourceMap& CompilerContext::sourceMap() const { return _sourceMap; }
+
+void CompilerContext::setLocation(const std::string& file, uint32_t line, uint32_t column, const std::string& symbol)
+{
+	_location = { _sourceMap.file(file), line, column, _sourceMap.symbol(symbol) };
+}
+
+const SourceLocation& CompilerContext::location() const { return _location; }
+
+void CompilerContext::writeToFile(const std::string& file, bool writeSourceMap) const
+{
+	_script.writeToFile(file);
+	if (writeSourceMap)
+		_sourceMap.writeToFile(SourceMap::sidecarFile(file));
+}
+
+void CompilerContext::reset()
+{
+	_script.clear();
+	_script.setVersion();
+	_stream.reset(1);
+	_constants.clear();
+	_internals.clear();
+	_variables.clear();
+	_fieldCount = 0;
+	_diagnostics.clear();
+	_sourceMap.clear();
+	_location = {};
+}
+
+Result<uint16_t> CompilerContext::allocateField(const ScriptField& field)
+{
+	if (_fieldCount >= MAX_FIELDS)
+		return FULL_FIELD_DATA;
+
+	_script.fieldData[_fieldCount] = field;
+	_sourceMap.add(SourceMapTarget::Field, _fieldCount, _location);
+	PROFILE_COUNT(ProfileCounter::Fields, 1);
+	return _fieldCount++;
+}
+
+uint16_t CompilerContext::unwrap(const Result<uint16_t>& result)
+{
+	if (result)
+		return result.value();
+	if (result.error().code == ErrorCode::TooManyVariables)
+		throw TooManyVariables{};
+	throw FullFieldData{};
+}
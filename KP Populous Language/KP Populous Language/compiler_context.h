@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <map>
+
+#include "script.h"
+#include "datatypes.h"
+#include "result.h"
+#include "source_map.h"
+
+class TooManyVariables : public std::exception {};
+
+class CompilerContext
+{
+private:
+	Script _script;
+	ScriptCodeStream _stream;
+
+	std::map<field_value_t, uint16_t> _constants;
+	std::map<ScriptCode, uint16_t> _internals;
+	std::map<std::string, uint16_t> _variables;
+
+	uint16_t _fieldCount;
+
+	TypeRegistry _types;
+
+	Diagnostics _diagnostics;
+
+	SourceMap _sourceMap;
+	SourceLocation _location;
+
+public:
+	CompilerContext();
+	CompilerContext(const CompilerContext&) = delete;
+
+	CompilerContext& operator= (const CompilerContext&) = delete;
+
+	Script& script();
+	const Script& script() const;
+
+	ScriptCodeStream& stream();
+
+	void emit(ScriptCodeBuilder& fragment);
+	Result<void> tryEmit(ScriptCodeBuilder& fragment);
+
+	uint16_t constantField(const field_value_t value);
+	uint16_t internalField(const ScriptCode internal);
+	uint16_t variableField(const std::string& name);
+
+	Result<uint16_t> tryConstantField(const field_value_t value);
+	Result<uint16_t> tryInternalField(const ScriptCode internal);
+	Result<uint16_t> tryVariableField(const std::string& name);
+
+	bool hasVariable(const std::string& name) const;
+
+	const TypeRegistry& types() const;
+
+	uint16_t fieldCount() const;
+	uint16_t variableCount() const;
+
+	Diagnostics& diagnostics();
+	const Diagnostics& diagnostics() const;
+
+	SourceMap& sourceMap();
+	const SourceMap& sourceMap() const;
+
+	void setLocation(const std::string& file, uint32_t line, uint32_t column, const std::string& symbol = "");
+	const SourceLocation& location() const;
+
+	void writeToFile(const std::string& file, bool writeSourceMap = true) const;
+
+	void reset();
+
+private:
+	Result<uint16_t> allocateField(const ScriptField& field);
+
+	static uint16_t unwrap(const Result<uint16_t>& result);
+};
@@ -0,0 +1,137 @@
+#include "compression.h"
+
+#include <cstring>
+
+namespace
+{
+	constexpr size_t MIN_MATCH = 4;
+	constexpr size_t MAX_OFFSET = 0xffff;
+	constexpr unsigned int HASH_BITS = 12;
+
+	inline uint32_t read32(const uint8_t* p)
+	{
+		uint32_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	inline uint32_t hash32(const uint32_t value) { return (value * 2654435761U) >> (32 - HASH_BITS); }
+
+	void write_length(std::vector<uint8_t>& output, size_t length)
+	{
+		while (length >= 255)
+		{
+			output.push_back(255);
+			length -= 255;
+		}
+		output.push_back(static_cast<uint8_t>(length));
+	}
+
+	bool read_length(const uint8_t*& ip, const uint8_t* const end, size_t& length)
+	{
+		for (;;)
+		{
+			if (ip >= end)
+				return false;
+			const uint8_t c = *ip++;
+			length += c;
+			if (c != 255)
+				return true;
+		}
+	}
+
+	void write_sequence(std::vector<uint8_t>& output, const uint8_t* literals, const size_t literalCount, const size_t offset, const size_t matchLength)
+	{
+		const size_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+		output.push_back(static_cast<uint8_t>(((literalCount < 15 ? literalCount : 15) << 4) | (matchCode < 15 ? matchCode : 15)));
+		if (literalCount >= 15)
+			write_length(output, literalCount - 15);
+		output.insert(output.end(), literals, literals + literalCount);
+
+		if (!matchLength)
+			return;
+
+		output.push_back(static_cast<uint8_t>(offset & 0xff));
+		output.push_back(static_cast<uint8_t>(offset >> 8));
+		if (matchCode >= 15)
+			write_length(output, matchCode - 15);
+	}
+}
+
+std::vector<uint8_t> lz_compress(const uint8_t* data, const size_t size)
+{
+	std::vector<uint8_t> output{};
+	output.reserve(size / 2 + 16);
+
+	std::vector<uint32_t> table(static_cast<size_t>(1) << HASH_BITS, UINT32_MAX);
+	size_t anchor = 0;
+	size_t pos = 0;
+	while (pos + MIN_MATCH <= size)
+	{
+		const uint32_t sequence = read32(data + pos);
+		uint32_t& slot = table[hash32(sequence)];
+		const size_t candidate = slot;
+		slot = static_cast<uint32_t>(pos);
+
+		if (candidate == UINT32_MAX || pos - candidate > MAX_OFFSET || read32(data + candidate) != sequence)
+		{
+			++pos;
+			continue;
+		}
+
+		size_t length = MIN_MATCH;
+		while (pos + length < size && data[candidate + length] == data[pos + length])
+			++length;
+
+		write_sequence(output, data + anchor, pos - anchor, pos - candidate, length);
+		pos += length;
+		anchor = pos;
+	}
+
+	write_sequence(output, data + anchor, size - anchor, 0, 0);
+	return output;
+}
+
+bool lz_decompress(const uint8_t* data, const size_t size, std::vector<uint8_t>& output, const size_t rawSize)
+{
+	output.clear();
+	output.reserve(rawSize);
+
+	const uint8_t* ip = data;
+	const uint8_t* const end = data + size;
+	while (ip < end)
+	{
+		const uint8_t token = *ip++;
+
+		size_t literalCount = token >> 4;
+		if (literalCount == 15 && !read_length(ip, end, literalCount))
+			return false;
+		if (static_cast<size_t>(end - ip) < literalCount || output.size() + literalCount > rawSize)
+			return false;
+		output.insert(output.end(), ip, ip + literalCount);
+		ip += literalCount;
+
+		if (ip >= end)
+			break;
+
+		if (end - ip < 2)
+			return false;
+		const size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+		ip += 2;
+		if (offset == 0 || offset > output.size())
+			return false;
+
+		size_t length = token & 0x0f;
+		if (length == 15 && !read_length(ip, end, length))
+			return false;
+		length += MIN_MATCH;
+		if (output.size() + length > rawSize)
+			return false;
+
+		size_t from = output.size() - offset;
+		for (size_t i = 0; i < length; ++i)
+			output.push_back(output[from + i]);
+	}
+
+	return output.size() == rawSize;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstddef>
+#include <cinttypes>
+#include <vector>
+
+std::vector<uint8_t> lz_compress(const uint8_t* data, const size_t size);
+bool lz_decompress(const uint8_t* data, const size_t size, std::vector<uint8_t>& output, const size_t rawSize);
@@ -0,0 +1,259 @@
+#include "condition_hoisting.h"
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstring>
+
+#include "every_staggering.h"
+#include "profiler.h"
+
+namespace
+{
+	struct ConditionUse
+	{
+		uint16_t begin;
+		uint16_t end;
+	};
+
+	struct HoistCandidate
+	{
+		std::vector<ScriptCode> condition;
+		std::vector<ConditionUse> uses;
+		uint16_t target;
+		double benefit;
+	};
+
+	uint16_t skip_block(const Script& script, uint16_t pos, uint16_t end)
+	{
+		int depth = 0;
+		for (; pos < end; ++pos)
+			if ((depth += Script::blockDelta(script.codeData[pos])) == 0 && script.codeData[pos] == InstructionToken::End)
+				return pos;
+		return end;
+	}
+
+	void collect_uses(const Script& script, const EveryBlock& block, std::map<std::vector<ScriptCode>, std::vector<ConditionUse>>& uses)
+	{
+		for (uint16_t pos = block.body + 1; pos < block.end; ++pos)
+		{
+			const ScriptCode code = script.codeData[pos];
+			if (code == InstructionToken::Every)
+			{
+				pos = skip_block(script, script.findCode(InstructionToken::Begin, pos), block.end);
+				continue;
+			}
+			if (code != InstructionToken::If)
+				continue;
+
+			uint16_t end = pos + 1;
+			while (end < block.end && Script::isConditionCode(script.codeData[end]))
+				++end;
+			if (end > pos + 1)
+				uses[{ script.codeData + pos + 1, script.codeData + end }].push_back({ static_cast<uint16_t>(pos + 1), end });
+			pos = end - 1;
+		}
+	}
+
+	bool reads_field(const Script& script, const std::vector<ScriptCode>& condition, bool (ScriptField::*predicate)() const)
+	{
+		for (const ScriptCode code : condition)
+			if (code < MAX_FIELDS && (script.fieldData[code].*predicate)())
+				return true;
+		return false;
+	}
+
+	bool is_written(const Script& script, uint16_t begin, uint16_t end, const std::vector<ScriptCode>& condition)
+	{
+		const bool internals = reads_field(script, condition, &ScriptField::isInternal);
+		bool operands = false;
+		for (uint16_t pos = begin; pos < end; ++pos)
+		{
+			const ScriptCode code = script.codeData[pos];
+			if (code < TOKEN_OFFSET)
+			{
+				if (operands && std::find(condition.begin(), condition.end(), code) != condition.end())
+					return true;
+				continue;
+			}
+
+			operands = false;
+			switch (code)
+			{
+				case InstructionToken::If:
+					while (pos + 1 < end && Script::isConditionCode(script.codeData[pos + 1]))
+						++pos;
+					break;
+
+				case InstructionToken::Every:
+				case InstructionToken::Else:
+				case InstructionToken::Endif:
+				case InstructionToken::Begin:
+				case InstructionToken::End:
+					break;
+
+				case InstructionToken::Set:
+				case InstructionToken::Increment:
+				case InstructionToken::Decrement:
+					if (pos + 1 < end && std::find(condition.begin(), condition.end(), script.codeData[pos + 1]) != condition.end())
+						return true;
+					pos += 2;
+					break;
+
+				default:
+					if (internals)
+						return true;
+					operands = true;
+					break;
+			}
+		}
+		return false;
+	}
+
+	std::vector<uint32_t> control_contexts(const Script& script, const std::vector<EveryBlock>& blocks)
+	{
+		std::vector<uint32_t> contexts(blocks.size(), 0);
+		std::vector<uint32_t> stack{};
+		uint32_t every = 0;
+		size_t next = 0;
+		const uint16_t length = script.length();
+		for (uint16_t pos = 1; pos < length && next < blocks.size(); ++pos)
+		{
+			if (pos == blocks[next].position)
+				contexts[next++] = stack.empty() ? 0 : stack.back();
+
+			switch (script.codeData[pos])
+			{
+				case InstructionToken::If:
+					stack.push_back(pos * 2U);
+					break;
+
+				case InstructionToken::Else:
+					if (!stack.empty())
+						stack.back() |= 1;
+					break;
+
+				case InstructionToken::Every:
+					every = pos * 2U;
+					break;
+
+				case InstructionToken::Begin:
+					stack.push_back(every ? every : stack.empty() ? 0 : stack.back());
+					every = 0;
+					break;
+
+				case InstructionToken::End:
+				case InstructionToken::Endif:
+					if (!stack.empty())
+						stack.pop_back();
+					break;
+			}
+		}
+		return contexts;
+	}
+
+	uint16_t spare_variable(Script& script)
+	{
+		bool used[MAX_VARS] = {};
+		for (uint16_t idx = 0; idx < MAX_FIELDS; ++idx)
+			if (script.fieldData[idx].isUser() && script.fieldData[idx].index >= 0 && script.fieldData[idx].index < static_cast<field_value_t>(MAX_VARS))
+				used[script.fieldData[idx].index] = true;
+
+		for (uint16_t var = 0; var < MAX_VARS; ++var)
+			if (!used[var])
+				return script.addField({ FieldType::User, static_cast<field_value_t>(var) });
+		return MAX_FIELDS;
+	}
+}
+
+ConditionHoisting::ConditionHoisting(const CostTable& table, double threshold) :
+	_table{ table },
+	_threshold{ threshold }
+{}
+
+double ConditionHoisting::threshold() const { return _threshold; }
+
+OptimizationStats ConditionHoisting::run(Script& script) const
+{
+	PROFILE_SCOPE("ConditionHoisting::run");
+
+	const double reuse = _table.cost(0) * 2 + _table.cost(InstructionToken::Equalto);
+	const double overhead = _table.cost(InstructionToken::Set) * 2 + _table.cost(0) * 4 + _table.cost(InstructionToken::If) +
+		_table.cost(InstructionToken::Begin) + _table.cost(InstructionToken::End) + _table.cost(InstructionToken::Endif);
+
+	OptimizationStats stats{};
+	for (;;)
+	{
+		const std::vector<EveryBlock> blocks = EveryStaggering::collect(script);
+		const std::vector<uint32_t> contexts = control_contexts(script, blocks);
+		std::vector<bool> grouped(blocks.size(), false);
+		std::vector<HoistCandidate> candidates{};
+		for (size_t first = 0; first < blocks.size(); ++first)
+		{
+			if (grouped[first])
+				continue;
+
+			std::map<std::vector<ScriptCode>, std::vector<ConditionUse>> uses{};
+			for (size_t idx = first; idx < blocks.size(); ++idx)
+			{
+				if (blocks[idx].period != blocks[first].period || blocks[idx].offset != blocks[first].offset || contexts[idx] != contexts[first])
+					continue;
+				grouped[idx] = true;
+				collect_uses(script, blocks[idx], uses);
+			}
+
+			for (const auto& entry : uses)
+			{
+				if (entry.second.size() < 2 || reads_field(script, entry.first, &ScriptField::isVolatile))
+					continue;
+
+				double cost = 0;
+				for (const ScriptCode code : entry.first)
+					cost += _table.cost(code);
+
+				const double count = static_cast<double>(entry.second.size());
+				const double benefit = count * cost - (cost + overhead + count * reuse);
+				if (benefit >= _threshold && !is_written(script, blocks[first].body + 1, entry.second.back().begin, entry.first))
+					candidates.push_back({ entry.first, entry.second, static_cast<uint16_t>(blocks[first].body + 1), benefit });
+			}
+		}
+
+		if (candidates.empty())
+			return stats;
+
+		const HoistCandidate& candidate = *std::max_element(candidates.begin(), candidates.end(),
+			[](const HoistCandidate& a, const HoistCandidate& b) { return a.benefit < b.benefit; });
+
+		const std::vector<ScriptField> fields{ script.fieldData, script.fieldData + MAX_FIELDS };
+		const uint16_t var = spare_variable(script);
+		const uint16_t zero = script.addField({ FieldType::Constant, 0 });
+		const uint16_t one = script.addField({ FieldType::Constant, 1 });
+
+		const uint16_t length = script.length();
+		std::vector<ScriptCode> codes{ script.codeData, script.codeData + candidate.target };
+		codes.insert(codes.end(), { InstructionToken::Set, var, zero, InstructionToken::If });
+		codes.insert(codes.end(), candidate.condition.begin(), candidate.condition.end());
+		codes.insert(codes.end(), { InstructionToken::Begin, InstructionToken::Set, var, one, InstructionToken::End, InstructionToken::Endif });
+
+		uint16_t pos = candidate.target;
+		for (const ConditionUse& use : candidate.uses)
+		{
+			codes.insert(codes.end(), script.codeData + pos, script.codeData + use.begin);
+			codes.insert(codes.end(), { var, InstructionToken::Equalto, one });
+			pos = use.end;
+		}
+		codes.insert(codes.end(), script.codeData + pos, script.codeData + length);
+
+		if (var >= MAX_FIELDS || zero >= MAX_FIELDS || one >= MAX_FIELDS || codes.size() > MAX_CODES)
+		{
+			std::copy(fields.begin(), fields.end(), script.fieldData);
+			return stats;
+		}
+
+		++stats.rewrites;
+		if (codes.size() < length)
+			stats.codesSaved += length - static_cast<uint32_t>(codes.size());
+		std::memset(script.codeData, 0, MAX_CODES * sizeof(ScriptCode));
+		std::memcpy(script.codeData, codes.data(), codes.size() * sizeof(ScriptCode));
+	}
+}
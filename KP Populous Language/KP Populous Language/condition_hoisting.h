@@ -0,0 +1,19 @@
+#pragma once
+
+#include "script.h"
+#include "optimizer.h"
+#include "cost_analyzer.h"
+
+class ConditionHoisting
+{
+private:
+	CostTable _table;
+	double _threshold;
+
+public:
+	ConditionHoisting(const CostTable& table = {}, double threshold = 1);
+
+	double threshold() const;
+
+	OptimizationStats run(Script& script) const;
+};
@@ -10,3 +10,4 @@ bool ScriptField::isInvalid() const { return type == FieldType::Invalid; }
 bool ScriptField::isConstant() const { return type == FieldType::Constant; }
 bool ScriptField::isUser() const { return type == FieldType::User; }
 bool ScriptField::isInternal() const { return type == FieldType::Internal; }
+bool ScriptField::isVolatile() const { return type == FieldType::Internal && index == ReadOnlyInternal::Random100; }
@@ -3,9 +3,7 @@
 #include <cinttypes>
 #include <vector>
 
-#define DECL_STATIC_BLOCK(class_name) static int class_name##__static__
-#define STATIC_BLOCK(class_name) int class_name :: class_name##__static__ = []() -> int {
-#define END_STATIC_BLOCK return 0; }();
+#define COMPILER_VERSION "0.1.0"
 
 #define NO_COMMANDS 27U
 #define TOKEN_OFFSET 1000U
@@ -40,6 +38,7 @@ struct ScriptField
 	bool isConstant() const;
 	bool isUser() const;
 	bool isInternal() const;
+	bool isVolatile() const;
 
 	constexpr static ScriptField invalid() { return { FieldType::Invalid, 3 }; }
 };
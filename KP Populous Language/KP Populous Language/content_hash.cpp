@@ -0,0 +1,43 @@
+#include "content_hash.h"
+
+std::string ContentHash::hex() const
+{
+	static const char digits[] = "0123456789abcdef";
+	std::string str(32, '0');
+	for (int i = 0; i < 16; ++i)
+	{
+		str[15 - i] = digits[(high >> (i * 4)) & 0xf];
+		str[31 - i] = digits[(low >> (i * 4)) & 0xf];
+	}
+	return str;
+}
+
+bool ContentHash::operator== (const ContentHash& other) const { return low == other.low && high == other.high; }
+bool ContentHash::operator!= (const ContentHash& other) const { return low != other.low || high != other.high; }
+bool ContentHash::operator< (const ContentHash& other) const { return high < other.high || (high == other.high && low < other.low); }
+
+
+
+ContentHasher::ContentHasher() :
+	_hash{ 0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL }
+{}
+
+void ContentHasher::update(const void* data, size_t size)
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		_hash.low = (_hash.low ^ bytes[i]) * 0x100000001b3ULL;
+		_hash.high = (_hash.high ^ bytes[i]) * 0x100000001b3ULL;
+		_hash.high ^= _hash.high >> 29;
+	}
+}
+
+void ContentHasher::update(const std::string& str)
+{
+	const uint64_t size = str.size();
+	update(&size, sizeof(size));
+	update(str.data(), str.size());
+}
+
+const ContentHash& ContentHasher::hash() const { return _hash; }
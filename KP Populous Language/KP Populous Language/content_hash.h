@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+
+struct ContentHash
+{
+	uint64_t low;
+	uint64_t high;
+
+	std::string hex() const;
+
+	bool operator== (const ContentHash& other) const;
+	bool operator!= (const ContentHash& other) const;
+	bool operator< (const ContentHash& other) const;
+};
+
+class ContentHasher
+{
+private:
+	ContentHash _hash;
+
+public:
+	ContentHasher();
+
+	void update(const void* data, size_t size);
+	void update(const std::string& str);
+
+	const ContentHash& hash() const;
+};
@@ -0,0 +1,374 @@
+#include "cost_analyzer.h"
+
+#include <algorithm>
+#include <numeric>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+
+#include "token_names.h"
+#include "profiler.h"
+
+namespace
+{
+	const size_t NO_BLOCK = static_cast<size_t>(-1);
+
+	class BlockTreeBuilder
+	{
+	private:
+		const Script& _script;
+		const CostTable& _table;
+		std::vector<CostBlock>& _blocks;
+
+	public:
+		BlockTreeBuilder(const Script& script, const CostTable& table, std::vector<CostBlock>& blocks) :
+			_script{ script },
+			_table{ table },
+			_blocks{ blocks }
+		{}
+
+		void build()
+		{
+			const uint16_t length = _script.length();
+			const size_t root = add({ CostBlockKind::Script, 1, length, 1, 0, 0, 0, 0, NO_BLOCK, {} });
+			body(root, 1, length);
+		}
+
+	private:
+		size_t add(const CostBlock& block)
+		{
+			_blocks.push_back(block);
+			return _blocks.size() - 1;
+		}
+
+		double cost(uint16_t begin, uint16_t end) const
+		{
+			double total = 0;
+			for (uint16_t pos = begin; pos < end; ++pos)
+				total += _table.cost(_script.codeData[pos]);
+			return total;
+		}
+
+		void body(size_t parent, uint16_t begin, uint16_t end)
+		{
+			for (uint16_t pos = begin; pos < end;)
+			{
+				const ScriptCode code = _script.codeData[pos];
+				uint16_t next = pos;
+				if ((code == InstructionToken::If && ifBlock(parent, pos, end, next)) ||
+					(code == InstructionToken::Every && everyBlock(parent, pos, end, next)))
+				{
+					pos = next;
+					continue;
+				}
+
+				_blocks[parent].own += _table.cost(code);
+				++pos;
+			}
+		}
+
+		bool ifBlock(size_t parent, uint16_t pos, uint16_t end, uint16_t& next)
+		{
+			uint16_t condition = pos + 1;
+			while (condition < end && Script::isConditionCode(_script.codeData[condition]))
+				++condition;
+
+			uint16_t elsePos = 0;
+			uint16_t endifPos = 0;
+			int depth = 0;
+			for (uint16_t idx = condition; idx < end && !endifPos; ++idx)
+			{
+				const ScriptCode code = _script.codeData[idx];
+				if (depth == 0 && code == InstructionToken::Else && !elsePos)
+					elsePos = idx;
+				else if (depth == 0 && code == InstructionToken::Endif)
+					endifPos = idx;
+				else if ((depth += Script::blockDelta(code)) < 0)
+					return false;
+			}
+			if (!endifPos)
+				return false;
+
+			next = endifPos + 1;
+			const double header = cost(pos, condition) + _table.cost(InstructionToken::Endif);
+			const size_t block = add({ CostBlockKind::If, pos, next, 0, 0, header, 0, 0, NO_BLOCK, {} });
+			_blocks[parent].children.push_back(block);
+			body(block, condition, elsePos ? elsePos : endifPos);
+
+			if (elsePos)
+			{
+				const size_t alternative = add({ CostBlockKind::Else, elsePos, endifPos, 0, 0, _table.cost(InstructionToken::Else), 0, 0, NO_BLOCK, {} });
+				_blocks[block].alternative = alternative;
+				body(alternative, elsePos + 1, endifPos);
+			}
+			return true;
+		}
+
+		bool everyBlock(size_t parent, uint16_t pos, uint16_t end, uint16_t& next)
+		{
+			uint16_t begin = pos + 1;
+			while (begin < end && _script.codeData[begin] < TOKEN_OFFSET)
+			{
+				if (_script.codeData[begin] >= MAX_FIELDS)
+					return false;
+				++begin;
+			}
+			if (begin >= end || _script.codeData[begin] != InstructionToken::Begin)
+				return false;
+
+			int depth = 0;
+			uint16_t blockEnd = begin;
+			for (; blockEnd < end; ++blockEnd)
+				if ((depth += Script::blockDelta(_script.codeData[blockEnd])) == 0)
+					break;
+			if (blockEnd >= end)
+				return false;
+
+			next = blockEnd + 1;
+			const size_t block = add({ CostBlockKind::Every, pos, next, 1, 0, cost(pos, begin), 0, 0, NO_BLOCK, {} });
+			if (begin - pos > 1)
+				_blocks[block].period = std::max<uint32_t>(operand(pos + 1), 1);
+			if (begin - pos > 2)
+				_blocks[block].offset = operand(pos + 2) % _blocks[block].period;
+
+			_blocks[parent].children.push_back(block);
+			body(block, begin, next);
+			return true;
+		}
+
+		uint32_t operand(uint16_t pos) const
+		{
+			const ScriptField& field = _script.fieldData[_script.codeData[pos]];
+			return field.isConstant() && field.value > 0 ? static_cast<uint32_t>(field.value) : 0;
+		}
+	};
+
+	class TurnEvaluator
+	{
+	private:
+		std::vector<CostBlock>& _blocks;
+		uint32_t _turn;
+
+	public:
+		TurnEvaluator(std::vector<CostBlock>& blocks, uint32_t turn) :
+			_blocks{ blocks },
+			_turn{ turn }
+		{}
+
+		double worst(size_t idx) const
+		{
+			const CostBlock& block = _blocks[idx];
+			double total = block.own;
+			for (const size_t child : block.children)
+			{
+				const CostBlock& sub = _blocks[child];
+				total += sub.header;
+				if (sub.kind == CostBlockKind::Every)
+				{
+					if (fires(sub))
+						total += worst(child);
+					continue;
+				}
+
+				const double otherwise = sub.alternative != NO_BLOCK ? _blocks[sub.alternative].header + worst(sub.alternative) : 0;
+				total += std::max(worst(child), otherwise);
+			}
+			return total;
+		}
+
+		double average(size_t idx, double reach)
+		{
+			CostBlock& block = _blocks[idx];
+			block.load += reach * block.own;
+
+			double total = block.own;
+			for (const size_t child : block.children)
+			{
+				CostBlock& sub = _blocks[child];
+				sub.load += reach * sub.header;
+				total += sub.header;
+				if (sub.kind == CostBlockKind::Every)
+				{
+					if (fires(sub))
+						total += average(child, reach);
+					continue;
+				}
+
+				double otherwise = 0;
+				if (sub.alternative != NO_BLOCK)
+				{
+					CostBlock& alternative = _blocks[sub.alternative];
+					alternative.load += reach / 2 * alternative.header;
+					otherwise = alternative.header + average(sub.alternative, reach / 2);
+				}
+				total += (average(child, reach / 2) + otherwise) / 2;
+			}
+			return total;
+		}
+
+	private:
+		bool fires(const CostBlock& block) const { return _turn % block.period == block.offset; }
+	};
+
+	uint32_t cycle_length(const std::vector<CostBlock>& blocks, uint32_t maxTurns)
+	{
+		uint64_t turns = 1;
+		for (const CostBlock& block : blocks)
+		{
+			if (block.kind != CostBlockKind::Every)
+				continue;
+			turns = std::lcm(turns, static_cast<uint64_t>(block.period));
+			if (turns >= maxTurns)
+				return maxTurns;
+		}
+		return static_cast<uint32_t>(turns);
+	}
+
+	const char* block_kind_name(CostBlockKind kind)
+	{
+		switch (kind)
+		{
+			case CostBlockKind::Script: return "Script";
+			case CostBlockKind::If: return "If";
+			case CostBlockKind::Else: return "Else";
+			case CostBlockKind::Every: return "Every";
+			default: return "";
+		}
+	}
+}
+
+CostTable::CostTable() :
+	_field{ 1 },
+	_token{ 1 },
+	_costs{}
+{}
+
+double CostTable::cost(ScriptCode code) const
+{
+	if (code < TOKEN_OFFSET)
+		return _field;
+
+	const auto& it = _costs.find(code);
+	return it != _costs.end() ? it->second : _token;
+}
+
+void CostTable::set(ScriptCode code, double cost) { _costs[code] = cost; }
+void CostTable::setFieldCost(double cost) { _field = cost; }
+void CostTable::setTokenCost(double cost) { _token = cost; }
+
+bool CostTable::read(std::istream& input)
+{
+	std::string line{};
+	while (std::getline(input, line))
+	{
+		std::istringstream ss{ line };
+		std::string name{};
+		double cost;
+		if (!(ss >> name) || name[0] == '#')
+			continue;
+		if (!(ss >> cost))
+			return false;
+
+		ScriptCode code;
+		if (name == "field")
+			_field = cost;
+		else if (name == "token")
+			_token = cost;
+		else if (find_token(name, code))
+			_costs[code] = cost;
+		else return false;
+	}
+	return true;
+}
+
+void CostTable::write(std::ostream& output) const
+{
+	output << "field " << _field << std::endl;
+	output << "token " << _token << std::endl;
+	for (const auto& entry : _costs)
+		output << token_name(entry.first) << " " << entry.second << std::endl;
+}
+
+bool CostTable::readFromFile(const std::string& file)
+{
+	std::ifstream f{ file };
+	return f && read(f);
+}
+
+bool CostTable::writeToFile(const std::string& file) const
+{
+	std::ofstream f{ file };
+	if (!f)
+		return false;
+	write(f);
+	return static_cast<bool>(f);
+}
+
+
+
+
+double CostReport::worstTurn() const { return worst.empty() ? 0 : *std::max_element(worst.begin(), worst.end()); }
+
+double CostReport::averageTurn() const
+{
+	return average.empty() ? 0 : std::accumulate(average.begin(), average.end(), 0.0) / average.size();
+}
+
+std::vector<size_t> CostReport::hottest(size_t count) const
+{
+	std::vector<size_t> order(blocks.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) { return blocks[a].load > blocks[b].load; });
+	order.resize(std::min(count, order.size()));
+	return order;
+}
+
+void CostReport::print(std::ostream& output, size_t hottestCount) const
+{
+	output << "Turns: " << worst.size() << std::endl;
+	output << "Worst turn cost: " << worstTurn() << std::endl;
+	output << "Average turn cost: " << averageTurn() << std::endl;
+
+	output << "Per turn (worst / average):" << std::endl;
+	for (size_t turn = 0; turn < worst.size(); ++turn)
+		output << std::setw(5) << turn << " " << std::setw(8) << worst[turn] << " " << std::setw(8) << average[turn] << std::endl;
+
+	output << "Hottest blocks:" << std::endl;
+	for (const size_t idx : hottest(hottestCount))
+	{
+		const CostBlock& block = blocks[idx];
+		output << std::setw(6) << block.begin << " " << std::setw(6) << block_kind_name(block.kind) << " " << block.load << std::endl;
+	}
+}
+
+
+
+
+CostAnalyzer::CostAnalyzer(const CostTable& table, uint32_t maxTurns) :
+	_table{ table },
+	_maxTurns{ std::max<uint32_t>(maxTurns, 1) }
+{}
+
+const CostTable& CostAnalyzer::table() const { return _table; }
+
+CostReport CostAnalyzer::analyze(const Script& script) const
+{
+	PROFILE_SCOPE("CostAnalyzer::analyze");
+
+	CostReport report{};
+	BlockTreeBuilder{ script, _table, report.blocks }.build();
+
+	const uint32_t turns = cycle_length(report.blocks, _maxTurns);
+	report.worst.resize(turns);
+	report.average.resize(turns);
+	for (uint32_t turn = 0; turn < turns; ++turn)
+	{
+		TurnEvaluator evaluator{ report.blocks, turn };
+		report.worst[turn] = evaluator.worst(0);
+		report.average[turn] = evaluator.average(0, 1);
+	}
+
+	for (CostBlock& block : report.blocks)
+		block.load /= turns;
+	return report;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <map>
+#include <istream>
+#include <ostream>
+
+#include "script.h"
+
+class CostTable
+{
+private:
+	double _field;
+	double _token;
+	std::map<ScriptCode, double> _costs;
+
+public:
+	CostTable();
+
+	double cost(ScriptCode code) const;
+
+	void set(ScriptCode code, double cost);
+	void setFieldCost(double cost);
+	void setTokenCost(double cost);
+
+	bool read(std::istream& input);
+	void write(std::ostream& output) const;
+
+	bool readFromFile(const std::string& file);
+	bool writeToFile(const std::string& file) const;
+};
+
+
+enum class CostBlockKind : uint8_t
+{
+	Script,
+	If,
+	Else,
+	Every
+};
+
+struct CostBlock
+{
+	CostBlockKind kind;
+	uint16_t begin;
+	uint16_t end;
+	uint32_t period;
+	uint32_t offset;
+	double header;
+	double own;
+	double load;
+	size_t alternative;
+	std::vector<size_t> children;
+};
+
+struct CostReport
+{
+	std::vector<CostBlock> blocks;
+	std::vector<double> worst;
+	std::vector<double> average;
+
+	double worstTurn() const;
+	double averageTurn() const;
+
+	std::vector<size_t> hottest(size_t count) const;
+
+	void print(std::ostream& output, size_t hottestCount = 10) const;
+};
+
+class CostAnalyzer
+{
+private:
+	CostTable _table;
+	uint32_t _maxTurns;
+
+public:
+	CostAnalyzer(const CostTable& table = {}, uint32_t maxTurns = 4096);
+
+	const CostTable& table() const;
+
+	CostReport analyze(const Script& script) const;
+};
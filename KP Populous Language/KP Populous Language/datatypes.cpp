@@ -1,69 +1,133 @@
 #include "datatypes.h"
 
 #include <algorithm>
+#include <iterator>
 
 #include "config_and_consts.h"
 
-_NativeDataType::_NativeDataType(const uint8_t id, const std::string& name) :
-	_id{ id },
-	_name{ name },
-	_integerType{ true },
-	_avByName{},
-	_avByValue{},
-	_defvalue{ 0 }
-{}
-
-_NativeDataType::_NativeDataType(
-	const uint8_t id,
-	const std::string& name,
-	const std::vector<std::pair<std::string, ScriptCode>>& availableValues,
-	const std::string& defaultName,
-	ScriptCode defaultValue) :
-	_id{ id },
-	_name{ name },
-	_integerType{ false },
-	_avByName{},
-	_avByValue{},
-	_defvalue{ defaultValue }
+namespace
 {
-	for (const auto& aval : availableValues)
-	{
-		if (!aval.first.empty())
-			_avByName[aval.first] = aval.second;
-		_avByValue[aval.second] = defaultName;
-	}
+	constexpr _NativeDataTypeValue STATE_VALUES[] = {
+		{ "on", InstructionToken::On },
+		{ "off", InstructionToken::Off }
+	};
+
+	constexpr _NativeDataTypeValue TEAM_VALUES[] = {
+		{ "Blue", CommandValueToken::Blue },
+		{ "Red", CommandValueToken::Red },
+		{ "Yellow", CommandValueToken::Yellow },
+		{ "Green", CommandValueToken::Green }
+	};
+
+	constexpr _NativeDataTypeValue SPELL_VALUES[] = {
+		{ "", ReadOnlyInternal::Burn },
+		{ "Blast", ReadOnlyInternal::Blast },
+		{ "Lightning", ReadOnlyInternal::LightningBolt },
+		{ "", ReadOnlyInternal::Whirlwind },
+		{ "Swarm", ReadOnlyInternal::InsectPlague },
+		{ "Invisibility", ReadOnlyInternal::Invisibility },
+		{ "Hypnotism", ReadOnlyInternal::Hypnotism },
+		{ "Firestorm", ReadOnlyInternal::Firestorm },
+		{ "GhostArmy", ReadOnlyInternal::GhostArmy },
+		{ "Erosion", ReadOnlyInternal::Erosion },
+		{ "Swamp", ReadOnlyInternal::Swamp },
+		{ "LandBridge", ReadOnlyInternal::LandBridge },
+		{ "AngelOfDead", ReadOnlyInternal::AngelOfDead },
+		{ "Earthquake", ReadOnlyInternal::Earthquake },
+		{ "Flatten", ReadOnlyInternal::Flatten },
+		{ "Volcano", ReadOnlyInternal::Volcano },
+		{ "Armageddon", ReadOnlyInternal::WrathOfGod },
+		{ "Shield", ReadOnlyInternal::Shield },
+		{ "Convert", ReadOnlyInternal::Convert },
+		{ "Teleport", ReadOnlyInternal::Teleport },
+		{ "Bloodlust", ReadOnlyInternal::Bloodlust },
+		{ "UndefinedSpell", ReadOnlyInternal::NoSpecificSpell }
+	};
+
+	constexpr _NativeDataTypeValue FOLLOWER_VALUES[] = {
+		{ "Brave", ReadOnlyInternal::Brave },
+		{ "Warrior", ReadOnlyInternal::Warrior },
+		{ "Religious", ReadOnlyInternal::Religious },
+		{ "Spy", ReadOnlyInternal::Spy },
+		{ "Firewarrior", ReadOnlyInternal::Firewarrior },
+		{ "Shaman", ReadOnlyInternal::Shaman },
+		{ "UndefinedFollower", ReadOnlyInternal::NoSpecificPerson }
+	};
+
+	constexpr _NativeDataTypeValue BUILDING_VALUES[] = {
+		{ "SmallHut", ReadOnlyInternal::SmallHut },
+		{ "MediumHut", ReadOnlyInternal::MediumHut },
+		{ "LargeHut", ReadOnlyInternal::LargeHut },
+		{ "DrumTower", ReadOnlyInternal::DrumTower },
+		{ "Temple", ReadOnlyInternal::Temple },
+		{ "SpyTrain", ReadOnlyInternal::SpyTrain },
+		{ "WarriorTrain", ReadOnlyInternal::WarriorTrain },
+		{ "FirewarriorTrain", ReadOnlyInternal::FirewarriorTrain },
+		{ "", ReadOnlyInternal::Reconversion },
+		{ "", ReadOnlyInternal::WallPiece },
+		{ "", ReadOnlyInternal::Gate },
+		{ "BoatHut", ReadOnlyInternal::BoatHut },
+		{ "", ReadOnlyInternal::BoatHut2 },
+		{ "AirshipHut", ReadOnlyInternal::AirshipHut },
+		{ "", ReadOnlyInternal::AirshipHut2 },
+		{ "UndefinedBuilding", ReadOnlyInternal::NoSpecificBuilding }
+	};
+
+	constexpr _NativeDataType NATIVE_TYPES[] = {
+		{ 0, "Integer" },
+		{ 1, "State", STATE_VALUES, "off", InstructionToken::Off },
+		{ 2, "Team", TEAM_VALUES, "Blue", CommandValueToken::Blue },
+		{ 3, "Spell", SPELL_VALUES, "Blast", ReadOnlyInternal::Blast },
+		{ 4, "Follower", FOLLOWER_VALUES, "Brave", ReadOnlyInternal::Brave },
+		{ 5, "Building", BUILDING_VALUES, "SmallHut", ReadOnlyInternal::SmallHut }
+	};
 }
 
-const std::string& _NativeDataType::name() const { return _name; }
+
+
+std::string _NativeDataType::name() const { return _name; }
 
 std::vector<std::string> _NativeDataType::availableValues() const
 {
-	std::vector<std::string> vec{ _avByName.size() };
-	for (const auto& v : _avByName)
-		vec.push_back(v.first);
-	return std::move(vec);
+	std::vector<std::string> vec{};
+	vec.reserve(_valueCount);
+	for (size_t i = 0; i < _valueCount; ++i)
+		if (*_values[i].name)
+			vec.push_back(_values[i].name);
+	std::sort(vec.begin(), vec.end());
+	return vec;
 }
 
 bool _NativeDataType::isValidIdentifier(const std::string& identifier) const
 {
-	return _avByName.find(identifier) != _avByName.end();
+	for (size_t i = 0; i < _valueCount; ++i)
+		if (*_values[i].name && identifier == _values[i].name)
+			return true;
+	return false;
 }
 
 bool _NativeDataType::isValidValue(ScriptCode value) const
 {
-	return _avByValue.find(value) != _avByValue.end();
+	for (size_t i = 0; i < _valueCount; ++i)
+		if (_values[i].value == value)
+			return true;
+	return false;
 }
 
 std::string _NativeDataType::getValueIdentifier(ScriptCode value) const
 {
-	const auto& it = _avByValue.find(value);
-	return it != _avByValue.end() ? it->second : "";
+	for (size_t i = 0; i < _valueCount; ++i)
+		if (_values[i].value == value)
+			return *_values[i].name ? _values[i].name : _defname;
+	return "";
 }
 
 ScriptCode _NativeDataType::getIdentifierValue(const std::string& identifier) const
 {
-	const auto& it = _avByName.find(identifier);
-	return it != _avByName.end() ? it->second : 0;
+	for (size_t i = 0; i < _valueCount; ++i)
+		if (*_values[i].name && identifier == _values[i].name)
+			return _values[i].value;
+	return 0;
 }
 
 bool _NativeDataType::operator== (const _NativeDataType& dt) const { return _id == dt._id; }
@@ -71,140 +135,46 @@ bool _NativeDataType::operator!= (const _NativeDataType& dt) const { return _id
 
 
 
-std::map<std::string, _NativeDataType> _NativeDataType::_MappedTypes{};
-std::vector<_NativeDataType*> _NativeDataType::_TypesList{};
-
-std::map<std::string, _NativeDataType*> _NativeDataType::_MappedConstantByName{};
-std::map<ScriptCode, _NativeDataType*> _NativeDataType::_MappedConstantByValue{};
-
-const _NativeDataType* _NativeDataType::registerType(const std::string& name)
-{
-	if (_MappedTypes.find(name) != _MappedTypes.end())
-		return nullptr;
-
-	const uint8_t id = static_cast<uint8_t>(_MappedTypes.size());
-	auto result = _MappedTypes.emplace(std::pair<std::string, _NativeDataType>{ name, { id, name } });
-	if (result.second)
-	{
-		_NativeDataType* type = &result.first->second;
-		_TypesList.push_back(type);
-		
-		for (auto& c : type->_avByName)
-		{
-			if (_MappedConstantByValue.find(c.second) == _MappedConstantByValue.end())
-			{
-				_MappedConstantByName[c.first] = type;
-				_MappedConstantByValue[c.second] = type;
-			}
-		}
-
-		return type;
-	}
-	else return nullptr;
-}
-const _NativeDataType* _NativeDataType::registerType(const std::string& name, const std::vector<std::pair<std::string, ScriptCode>>& availableValues, const std::string& defaultName, ScriptCode defaultValue)
+bool _NativeDataType::isValidType(const std::string& name) { return getType(name); }
+std::vector<std::string> _NativeDataType::availableTypes()
 {
-	if (_MappedTypes.find(name) != _MappedTypes.end())
-		return nullptr;
-
-	const uint8_t id = static_cast<uint8_t>(_MappedTypes.size());
-	auto result = _MappedTypes.emplace(std::pair<std::string, _NativeDataType>{ name, { id, name, availableValues, defaultName, defaultValue } });
-	if (result.second)
-	{
-		_TypesList.push_back(&result.first->second);
-		return &result.first->second;
-	}
-	else return nullptr;
+	std::vector<std::string> vec{};
+	vec.reserve(std::size(NATIVE_TYPES));
+	for (const _NativeDataType& type : NATIVE_TYPES)
+		vec.push_back(type._name);
+	return vec;
 }
-
-bool _NativeDataType::isValidType(const std::string& name) { return _MappedTypes.find(name) != _MappedTypes.end(); }
 const _NativeDataType* _NativeDataType::getType(const std::string& name)
 {
-	return &_MappedTypes.find(name)->second;
+	for (const _NativeDataType& type : NATIVE_TYPES)
+		if (name == type._name)
+			return &type;
+	return nullptr;
 }
 const _NativeDataType* _NativeDataType::findTypeFromValue(ScriptCode value)
 {
-	const auto& it = _MappedConstantByValue.find(value);
-	return it == _MappedConstantByValue.end() ? nullptr : it->second;
+	for (const _NativeDataType& type : NATIVE_TYPES)
+		for (size_t i = 0; i < type._valueCount; ++i)
+			if (*type._values[i].name && type._values[i].value == value)
+				return &type;
+	return nullptr;
 }
 const _NativeDataType* _NativeDataType::findTypeFromValueName(const std::string& value)
 {
-	const auto& it = _MappedConstantByName.find(value);
-	return it == _MappedConstantByName.end() ? nullptr : it->second;
+	for (const _NativeDataType& type : NATIVE_TYPES)
+		if (type.isValidIdentifier(value))
+			return &type;
+	return nullptr;
 }
 
 
 
-
-
-
-const _NativeDataType* const _NativeDataType::Integer{ _NativeDataType::registerType("Integer") };
-
-const _NativeDataType* const _NativeDataType::State{ _NativeDataType::registerType("State", {
-	{ "on", InstructionToken::On },
-	{ "off", InstructionToken::Off }
-}, "off", InstructionToken::Off) };
-
-const _NativeDataType* const _NativeDataType::Team{ _NativeDataType::registerType("Team", {
-	{ "Blue", CommandValueToken::Blue },
-	{ "Red", CommandValueToken::Red },
-	{ "Yellow", CommandValueToken::Yellow },
-	{ "Green", CommandValueToken::Green }
-}, "Blue", CommandValueToken::Blue) };
-
-const _NativeDataType* const _NativeDataType::Spell{ _NativeDataType::registerType("Spell", {
-	{ "", ReadOnlyInternal::Burn },
-	{ "Blast", ReadOnlyInternal::Blast },
-	{ "Lightning", ReadOnlyInternal::LightningBolt },
-	{ "", ReadOnlyInternal::Whirlwind },
-	{ "Swarm", ReadOnlyInternal::InsectPlague },
-	{ "Invisibility", ReadOnlyInternal::Invisibility },
-	{ "Hypnotism", ReadOnlyInternal::Hypnotism },
-	{ "Firestorm", ReadOnlyInternal::Firestorm },
-	{ "GhostArmy", ReadOnlyInternal::GhostArmy },
-	{ "Erosion", ReadOnlyInternal::Erosion },
-	{ "Swamp", ReadOnlyInternal::Swamp },
-	{ "LandBridge", ReadOnlyInternal::LandBridge },
-	{ "AngelOfDead", ReadOnlyInternal::AngelOfDead },
-	{ "Earthquake", ReadOnlyInternal::Earthquake },
-	{ "Flatten", ReadOnlyInternal::Flatten },
-	{ "Volcano", ReadOnlyInternal::Volcano },
-	{ "Armageddon", ReadOnlyInternal::WrathOfGod },
-	{ "Shield", ReadOnlyInternal::Shield },
-	{ "Convert", ReadOnlyInternal::Convert },
-	{ "Teleport", ReadOnlyInternal::Teleport },
-	{ "Bloodlust", ReadOnlyInternal::Bloodlust },
-	{ "UndefinedSpell", ReadOnlyInternal::NoSpecificSpell }
-}, "Blast", ReadOnlyInternal::Blast) };
-
-const _NativeDataType* const _NativeDataType::Follower{ _NativeDataType::registerType("Follower", {
-	{ "Brave", ReadOnlyInternal::Brave },
-	{ "Warrior", ReadOnlyInternal::Warrior },
-	{ "Religious", ReadOnlyInternal::Religious },
-	{ "Spy", ReadOnlyInternal::Spy },
-	{ "Firewarrior", ReadOnlyInternal::Firewarrior },
-	{ "Shaman", ReadOnlyInternal::Shaman },
-	{ "UndefinedFollower", ReadOnlyInternal::NoSpecificPerson }
-}, "Brave", ReadOnlyInternal::Brave) };
-
-const _NativeDataType* const _NativeDataType::Building{ _NativeDataType::registerType("Building", {
-	{ "SmallHut", ReadOnlyInternal::SmallHut },
-	{ "MediumHut", ReadOnlyInternal::MediumHut },
-	{ "LargeHut", ReadOnlyInternal::LargeHut },
-	{ "DrumTower", ReadOnlyInternal::DrumTower },
-	{ "Temple", ReadOnlyInternal::Temple },
-	{ "SpyTrain", ReadOnlyInternal::SpyTrain },
-	{ "WarriorTrain", ReadOnlyInternal::WarriorTrain },
-	{ "FirewarriorTrain", ReadOnlyInternal::FirewarriorTrain },
-	{ "", ReadOnlyInternal::Reconversion },
-	{ "", ReadOnlyInternal::WallPiece },
-	{ "", ReadOnlyInternal::Gate },
-	{ "BoatHut", ReadOnlyInternal::BoatHut },
-	{ "", ReadOnlyInternal::BoatHut2 },
-	{ "AirshipHut", ReadOnlyInternal::AirshipHut },
-	{ "", ReadOnlyInternal::AirshipHut2 },
-	{ "UndefinedBuilding", ReadOnlyInternal::NoSpecificBuilding }
-}, "SmallHut", ReadOnlyInternal::SmallHut) };
+const _NativeDataType* const _NativeDataType::Integer{ &NATIVE_TYPES[0] };
+const _NativeDataType* const _NativeDataType::State{ &NATIVE_TYPES[1] };
+const _NativeDataType* const _NativeDataType::Team{ &NATIVE_TYPES[2] };
+const _NativeDataType* const _NativeDataType::Spell{ &NATIVE_TYPES[3] };
+const _NativeDataType* const _NativeDataType::Follower{ &NATIVE_TYPES[4] };
+const _NativeDataType* const _NativeDataType::Building{ &NATIVE_TYPES[5] };
 
 
 
@@ -217,7 +187,7 @@ DataType::DataType(const _NativeDataType* type) :
 	_type{ type }
 {}
 
-const std::string& DataType::name() const { return _type->name(); }
+std::string DataType::name() const { return _type->name(); }
 
 bool DataType::isValid() const { return _type; }
 
@@ -237,6 +207,7 @@ DataType::operator bool() const { return _type; }
 
 
 bool DataType::isValidType(const std::string& name) { return _NativeDataType::isValidType(name); }
+std::vector<std::string> DataType::availableTypes() { return _NativeDataType::availableTypes(); }
 DataType DataType::getType(const std::string& name) { return _NativeDataType::getType(name); }
 DataType DataType::findTypeFromValue(ScriptCode value) { return _NativeDataType::findTypeFromValue(value); }
 DataType DataType::findTypeFromValueName(const std::string& value) { return _NativeDataType::findTypeFromValueName(value); }
@@ -247,3 +218,50 @@ DataType DataType::team() { return { _NativeDataType::Team }; }
 DataType DataType::spell() { return { _NativeDataType::Spell }; }
 DataType DataType::follower() { return { _NativeDataType::Follower }; }
 DataType DataType::building() { return { _NativeDataType::Building }; }
+
+
+
+
+
+
+
+
+TypeRegistry::TypeRegistry() :
+	_names{},
+	_types{},
+	_valueNames{},
+	_values{}
+{
+	for (const _NativeDataType& native : NATIVE_TYPES)
+	{
+		const DataType type{ &native };
+		_names.push_back(native.name());
+		_types.emplace(native.name(), type);
+		for (const std::string& value : native.availableValues())
+		{
+			_valueNames.emplace(value, type);
+			_values.emplace(native.getIdentifierValue(value), type);
+		}
+	}
+}
+
+bool TypeRegistry::isValidType(const std::string& name) const { return _types.find(name) != _types.end(); }
+std::vector<std::string> TypeRegistry::availableTypes() const { return _names; }
+
+DataType TypeRegistry::getType(const std::string& name) const
+{
+	const auto it = _types.find(name);
+	return it != _types.end() ? it->second : DataType{ nullptr };
+}
+
+DataType TypeRegistry::findTypeFromValue(ScriptCode value) const
+{
+	const auto it = _values.find(value);
+	return it != _values.end() ? it->second : DataType{ nullptr };
+}
+
+DataType TypeRegistry::findTypeFromValueName(const std::string& value) const
+{
+	const auto it = _valueNames.find(value);
+	return it != _valueNames.end() ? it->second : DataType{ nullptr };
+}
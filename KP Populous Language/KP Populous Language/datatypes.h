@@ -9,23 +9,48 @@
 
 namespace
 {
+	struct _NativeDataTypeValue
+	{
+		const char* name;
+		ScriptCode value;
+	};
+
 	class _NativeDataType
 	{
 	private:
 		uint8_t _id;
-		std::string _name;
+		const char* _name;
 
 		bool _integerType;
-		std::map<std::string, ScriptCode> _avByName;
-		std::map<ScriptCode, std::string> _avByValue;
+		const _NativeDataTypeValue* _values;
+		size_t _valueCount;
 
+		const char* _defname;
 		ScriptCode _defvalue;
 
-		_NativeDataType(const uint8_t id, const std::string& name);
-		_NativeDataType(const uint8_t id, const std::string& name, const std::vector<std::pair<std::string, ScriptCode>>& availableValues, const std::string& defaultName, ScriptCode defaultValue);
-
 	public:
-		const std::string& name() const;
+		constexpr _NativeDataType(const uint8_t id, const char* name) :
+			_id{ id },
+			_name{ name },
+			_integerType{ true },
+			_values{ nullptr },
+			_valueCount{ 0 },
+			_defname{ "" },
+			_defvalue{ 0 }
+		{}
+
+		template<size_t _Count>
+		constexpr _NativeDataType(const uint8_t id, const char* name, const _NativeDataTypeValue (&availableValues)[_Count], const char* defaultName, ScriptCode defaultValue) :
+			_id{ id },
+			_name{ name },
+			_integerType{ false },
+			_values{ availableValues },
+			_valueCount{ _Count },
+			_defname{ defaultName },
+			_defvalue{ defaultValue }
+		{}
+
+		std::string name() const;
 
 		std::vector<std::string> availableValues() const;
 
@@ -38,19 +63,9 @@ namespace
 		bool operator== (const _NativeDataType& dt) const;
 		bool operator!= (const _NativeDataType& dt) const;
 
-
-	private:
-		static std::map<std::string, _NativeDataType> _MappedTypes;
-		static std::vector<_NativeDataType*> _TypesList;
-
-		static std::map<std::string, _NativeDataType*> _MappedConstantByName;
-		static std::map<ScriptCode, _NativeDataType*> _MappedConstantByValue;
-
-		static const _NativeDataType* registerType(const std::string& name);
-		static const _NativeDataType* registerType(const std::string& name, const std::vector<std::pair<std::string, ScriptCode>>& availableValues, const std::string& defaultName, ScriptCode defaultValue);
-
 	public:
 		static bool isValidType(const std::string& name);
+		static std::vector<std::string> availableTypes();
 		static const _NativeDataType* getType(const std::string& name);
 		static const _NativeDataType* findTypeFromValue(ScriptCode value);
 		static const _NativeDataType* findTypeFromValueName(const std::string& value);
@@ -71,8 +86,10 @@ private:
 
 	DataType(const _NativeDataType* type);
 
+	friend class TypeRegistry;
+
 public:
-	const std::string& name() const;
+	std::string name() const;
 
 	bool isValid() const;
 
@@ -92,6 +109,7 @@ public:
 
 public:
 	static bool isValidType(const std::string& name);
+	static std::vector<std::string> availableTypes();
 	static DataType getType(const std::string& name);
 	static DataType findTypeFromValue(ScriptCode value);
 	static DataType findTypeFromValueName(const std::string& value);
@@ -103,3 +121,22 @@ public:
 	static DataType follower();
 	static DataType building();
 };
+
+
+class TypeRegistry
+{
+private:
+	std::vector<std::string> _names;
+	std::map<std::string, DataType> _types;
+	std::map<std::string, DataType> _valueNames;
+	std::map<ScriptCode, DataType> _values;
+
+public:
+	TypeRegistry();
+
+	bool isValidType(const std::string& name) const;
+	std::vector<std::string> availableTypes() const;
+	DataType getType(const std::string& name) const;
+	DataType findTypeFromValue(ScriptCode value) const;
+	DataType findTypeFromValueName(const std::string& value) const;
+};
@@ -0,0 +1,315 @@
+#include "dead_store_elimination.h"
+
+#include <bitset>
+#include <map>
+#include <cstring>
+
+#include "token_names.h"
+#include "profiler.h"
+
+namespace
+{
+	using LiveSet = std::bitset<MAX_VARS>;
+
+	const field_value_t NO_VARIABLE = static_cast<field_value_t>(MAX_VARS);
+
+	enum class FlowKind : uint8_t
+	{
+		Instruction,
+		Store,
+		If,
+		Every
+	};
+
+	struct FlowNode
+	{
+		FlowKind kind;
+		uint16_t begin;
+		uint16_t header;
+		uint16_t end;
+		std::vector<FlowNode> body;
+		std::vector<FlowNode> otherwise;
+		bool dead;
+	};
+
+	class FlowParser
+	{
+	private:
+		const Script& _script;
+
+	public:
+		FlowParser(const Script& script) : _script{ script } {}
+
+		void parse(uint16_t begin, uint16_t end, std::vector<FlowNode>& nodes) const
+		{
+			for (uint16_t pos = begin; pos < end;)
+			{
+				const ScriptCode code = _script.codeData[pos];
+				if ((code == InstructionToken::If && parseIf(pos, end, nodes)) ||
+					(code == InstructionToken::Every && parseEvery(pos, end, nodes)))
+				{
+					pos = nodes.back().end;
+					continue;
+				}
+
+				uint16_t next = pos + 1;
+				while (next < end && _script.codeData[next] < TOKEN_OFFSET)
+					++next;
+
+				const bool store = (code == InstructionToken::Set || code == InstructionToken::Increment || code == InstructionToken::Decrement) &&
+					next - pos == 3 && variable(pos + 1) != NO_VARIABLE;
+				nodes.push_back({ store ? FlowKind::Store : FlowKind::Instruction, pos, next, next, {}, {}, false });
+				pos = next;
+			}
+		}
+
+		ScriptCode code(uint16_t pos) const { return _script.codeData[pos]; }
+
+		field_value_t variable(uint16_t pos) const
+		{
+			const ScriptCode code = _script.codeData[pos];
+			if (code >= MAX_FIELDS || !_script.fieldData[code].isUser() || _script.fieldData[code].index < 0 || _script.fieldData[code].index >= NO_VARIABLE)
+				return NO_VARIABLE;
+			return _script.fieldData[code].index;
+		}
+
+	private:
+		bool parseIf(uint16_t pos, uint16_t end, std::vector<FlowNode>& nodes) const
+		{
+			uint16_t condition = pos + 1;
+			while (condition < end && Script::isConditionCode(_script.codeData[condition]))
+				++condition;
+
+			uint16_t elsePos = 0;
+			uint16_t endifPos = 0;
+			int depth = 0;
+			for (uint16_t idx = condition; idx < end && !endifPos; ++idx)
+			{
+				const ScriptCode code = _script.codeData[idx];
+				if (depth == 0 && code == InstructionToken::Else && !elsePos)
+					elsePos = idx;
+				else if (depth == 0 && code == InstructionToken::Endif)
+					endifPos = idx;
+				else if ((depth += Script::blockDelta(code)) < 0)
+					return false;
+			}
+			if (!endifPos)
+				return false;
+
+			FlowNode node{ FlowKind::If, pos, condition, static_cast<uint16_t>(endifPos + 1), {}, {}, false };
+			parse(condition, elsePos ? elsePos : endifPos, node.body);
+			if (elsePos)
+				parse(elsePos + 1, endifPos, node.otherwise);
+			nodes.push_back(std::move(node));
+			return true;
+		}
+
+		bool parseEvery(uint16_t pos, uint16_t end, std::vector<FlowNode>& nodes) const
+		{
+			uint16_t begin = pos + 1;
+			while (begin < end && _script.codeData[begin] < TOKEN_OFFSET)
+				++begin;
+			if (begin >= end || _script.codeData[begin] != InstructionToken::Begin)
+				return false;
+
+			int depth = 0;
+			uint16_t blockEnd = begin;
+			for (; blockEnd < end; ++blockEnd)
+				if ((depth += Script::blockDelta(_script.codeData[blockEnd])) == 0)
+					break;
+			if (blockEnd >= end)
+				return false;
+
+			FlowNode node{ FlowKind::Every, pos, begin, static_cast<uint16_t>(blockEnd + 1), {}, {}, false };
+			parse(begin, blockEnd + 1, node.body);
+			nodes.push_back(std::move(node));
+			return true;
+		}
+	};
+
+	class Liveness
+	{
+	private:
+		const FlowParser& _parser;
+		bool _mark;
+
+	public:
+		Liveness(const FlowParser& parser, bool mark) :
+			_parser{ parser },
+			_mark{ mark }
+		{}
+
+		LiveSet flow(std::vector<FlowNode>& nodes, LiveSet live) const
+		{
+			for (auto it = nodes.rbegin(); it != nodes.rend(); ++it)
+			{
+				FlowNode& node = *it;
+				switch (node.kind)
+				{
+					case FlowKind::Instruction:
+						live |= uses(node.begin, node.end);
+						break;
+
+					case FlowKind::Store: {
+						const field_value_t var = _parser.variable(node.begin + 1);
+						if (!live[var])
+						{
+							node.dead = _mark;
+							break;
+						}
+						if (_parser.code(node.begin) == InstructionToken::Set)
+							live.reset(var);
+						live |= uses(node.begin + 2, node.end);
+					} break;
+
+					case FlowKind::If:
+						live = uses(node.begin, node.header) | flow(node.body, live) | flow(node.otherwise, live);
+						break;
+
+					case FlowKind::Every:
+						live = uses(node.begin, node.header) | live | flow(node.body, live);
+						break;
+				}
+			}
+			return live;
+		}
+
+	private:
+		LiveSet uses(uint16_t begin, uint16_t end) const
+		{
+			LiveSet live{};
+			for (uint16_t pos = begin; pos < end; ++pos)
+			{
+				const field_value_t var = _parser.variable(pos);
+				if (var != NO_VARIABLE)
+					live.set(var);
+			}
+			return live;
+		}
+	};
+
+	void collect_dead(const std::vector<FlowNode>& nodes, std::vector<const FlowNode*>& dead)
+	{
+		for (const FlowNode& node : nodes)
+		{
+			if (node.dead)
+				dead.push_back(&node);
+			collect_dead(node.body, dead);
+			collect_dead(node.otherwise, dead);
+		}
+	}
+
+	std::vector<bool> referenced_variables(const Script& script)
+	{
+		std::vector<bool> used(MAX_VARS, false);
+		const uint16_t length = script.length();
+		for (uint16_t pos = 1; pos < length; ++pos)
+		{
+			const ScriptCode code = script.codeData[pos];
+			if (code < MAX_FIELDS && script.fieldData[code].isUser() && script.fieldData[code].index >= 0 && script.fieldData[code].index < NO_VARIABLE)
+				used[script.fieldData[code].index] = true;
+		}
+		return used;
+	}
+
+	void renumber_variables(Script& script)
+	{
+		std::map<field_value_t, field_value_t> remap{};
+		for (const ScriptField& field : script.fieldData)
+			if (field.isUser())
+				remap[field.index] = 0;
+
+		field_value_t next = 0;
+		for (auto& entry : remap)
+			entry.second = next++;
+		for (ScriptField& field : script.fieldData)
+			if (field.isUser())
+				field.index = remap[field.index];
+	}
+}
+
+DeadStoreElimination::DeadStoreElimination() :
+	_stores{},
+	_variables{}
+{}
+
+OptimizationStats DeadStoreElimination::run(Script& script)
+{
+	PROFILE_SCOPE("DeadStoreElimination::run");
+
+	_stores.clear();
+	_variables.clear();
+
+	const std::vector<bool> before = referenced_variables(script);
+	std::vector<uint16_t> origin(MAX_CODES);
+	for (uint16_t pos = 0; pos < MAX_CODES; ++pos)
+		origin[pos] = pos;
+
+	OptimizationStats stats{};
+	for (;;)
+	{
+		const uint16_t length = script.length();
+		const FlowParser parser{ script };
+		std::vector<FlowNode> nodes{};
+		parser.parse(1, length, nodes);
+
+		LiveSet exit{};
+		for (;;)
+		{
+			const LiveSet entry = Liveness{ parser, false }.flow(nodes, exit);
+			if ((entry | exit) == exit)
+				break;
+			exit |= entry;
+		}
+		Liveness{ parser, true }.flow(nodes, exit);
+
+		std::vector<const FlowNode*> dead{};
+		collect_dead(nodes, dead);
+		if (dead.empty())
+			break;
+
+		std::vector<bool> removed(length, false);
+		for (const FlowNode* node : dead)
+		{
+			_stores.push_back({ origin[node->begin], script.codeData[node->begin], parser.variable(node->begin + 1) });
+			for (uint16_t pos = node->begin; pos < node->end; ++pos)
+				removed[pos] = true;
+		}
+
+		uint16_t count = 0;
+		for (uint16_t pos = 0; pos < length; ++pos)
+		{
+			if (removed[pos])
+				continue;
+			origin[count] = origin[pos];
+			script.codeData[count++] = script.codeData[pos];
+		}
+		std::memset(script.codeData + count, 0, (MAX_CODES - count) * sizeof(ScriptCode));
+
+		stats.rewrites += static_cast<uint32_t>(dead.size());
+		stats.codesSaved += length - count;
+	}
+
+	if (!stats.rewrites)
+		return stats;
+
+	const std::vector<bool> after = referenced_variables(script);
+	for (field_value_t var = 0; var < NO_VARIABLE; ++var)
+		if (before[var] && !after[var])
+			_variables.push_back(var);
+
+	stats.fieldsSaved = compact_fields(script);
+	renumber_variables(script);
+	return stats;
+}
+
+const std::vector<DeadStore>& DeadStoreElimination::stores() const { return _stores; }
+const std::vector<field_value_t>& DeadStoreElimination::variables() const { return _variables; }
+
+void DeadStoreElimination::printReport(std::ostream& output) const
+{
+	for (const DeadStore& store : _stores)
+		output << "Removed " << token_name(store.instruction) << " of variable " << store.variable << " at offset " << store.offset << std::endl;
+	for (const field_value_t var : _variables)
+		output << "Removed unused variable " << var << std::endl;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cinttypes>
+#include <vector>
+#include <ostream>
+
+#include "script.h"
+#include "optimizer.h"
+
+struct DeadStore
+{
+	uint16_t offset;
+	ScriptCode instruction;
+	field_value_t variable;
+};
+
+class DeadStoreElimination
+{
+private:
+	std::vector<DeadStore> _stores;
+	std::vector<field_value_t> _variables;
+
+public:
+	DeadStoreElimination();
+
+	OptimizationStats run(Script& script);
+
+	const std::vector<DeadStore>& stores() const;
+	const std::vector<field_value_t>& variables() const;
+
+	void printReport(std::ostream& output) const;
+};
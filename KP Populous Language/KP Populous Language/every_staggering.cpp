@@ -0,0 +1,223 @@
+#include "every_staggering.h"
+
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <iomanip>
+
+#include "profiler.h"
+
+namespace
+{
+	const unsigned int HISTOGRAM_WIDTH = 48;
+
+	bool constant_operand(const Script& script, uint16_t pos, uint32_t& value)
+	{
+		const ScriptCode code = script.codeData[pos];
+		if (code >= MAX_FIELDS || !script.fieldData[code].isConstant() || script.fieldData[code].value < 0)
+			return false;
+		value = static_cast<uint32_t>(script.fieldData[code].value);
+		return true;
+	}
+
+	uint32_t hyperperiod(const std::vector<EveryBlock>& blocks, uint32_t maxTurns)
+	{
+		uint64_t turns = 1;
+		for (const EveryBlock& block : blocks)
+		{
+			turns = std::lcm(turns, static_cast<uint64_t>(block.period));
+			if (turns >= maxTurns)
+				return maxTurns;
+		}
+		return static_cast<uint32_t>(turns);
+	}
+
+	void add_load(std::vector<double>& costs, const EveryBlock& block)
+	{
+		for (size_t turn = block.offset; turn < costs.size(); turn += block.period)
+			costs[turn] += block.cost;
+	}
+
+	uint32_t best_offset(const std::vector<double>& costs, const EveryBlock& block)
+	{
+		uint32_t best = 0;
+		double bestPeak = 0;
+		double bestTotal = 0;
+		for (uint32_t offset = 0; offset < block.period; ++offset)
+		{
+			double peak = 0;
+			double total = 0;
+			for (size_t turn = offset; turn < costs.size(); turn += block.period)
+			{
+				peak = std::max(peak, costs[turn]);
+				total += costs[turn];
+			}
+
+			if (offset == 0 || peak < bestPeak || (peak == bestPeak && total < bestTotal))
+			{
+				best = offset;
+				bestPeak = peak;
+				bestTotal = total;
+			}
+		}
+		return best;
+	}
+}
+
+EveryStaggering::EveryStaggering(uint32_t maxTurns) :
+	_maxTurns{ std::max<uint32_t>(maxTurns, 1) },
+	_blocks{},
+	_before{},
+	_after{}
+{}
+
+OptimizationStats EveryStaggering::run(Script& script)
+{
+	PROFILE_SCOPE("EveryStaggering::run");
+
+	_blocks = collect(script);
+	if (_blocks.empty())
+	{
+		_before.clear();
+		_after.clear();
+		return {};
+	}
+
+	const uint32_t turns = hyperperiod(_blocks, _maxTurns);
+	_before = turnCosts(_blocks, turns);
+
+	std::vector<size_t> order(_blocks.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+		const EveryBlock& left = _blocks[a];
+		const EveryBlock& right = _blocks[b];
+		if (left.fixed != right.fixed)
+			return left.fixed;
+		return left.cost > right.cost;
+	});
+
+	const std::vector<EveryBlock> original = _blocks;
+	const std::vector<ScriptField> fields{ script.fieldData, script.fieldData + MAX_FIELDS };
+	_after.assign(turns, 0);
+	for (const size_t idx : order)
+	{
+		EveryBlock& block = _blocks[idx];
+		if (!block.fixed)
+			block.offset = best_offset(_after, block);
+		add_load(_after, block);
+	}
+
+	std::vector<ScriptCode> codes{};
+	codes.reserve(MAX_CODES);
+	codes.insert(codes.end(), script.codeData, script.codeData + _blocks.front().position);
+
+	OptimizationStats stats{};
+	for (size_t idx = 0; idx < _blocks.size(); ++idx)
+	{
+		const EveryBlock& block = _blocks[idx];
+		const uint16_t next = idx + 1 < _blocks.size() ? _blocks[idx + 1].position : script.length();
+		if (block.offset == original[idx].offset)
+		{
+			codes.insert(codes.end(), script.codeData + block.position, script.codeData + next);
+			continue;
+		}
+
+		const uint16_t field = script.addField({ FieldType::Constant, static_cast<field_value_t>(block.offset) });
+		if (field >= MAX_FIELDS)
+		{
+			_blocks[idx].offset = original[idx].offset;
+			codes.insert(codes.end(), script.codeData + block.position, script.codeData + next);
+			continue;
+		}
+
+		++stats.rewrites;
+		codes.push_back(InstructionToken::Every);
+		codes.push_back(script.codeData[block.position + 1]);
+		codes.push_back(field);
+		codes.insert(codes.end(), script.codeData + block.position + 2, script.codeData + next);
+	}
+
+	if (!stats.rewrites || codes.size() > MAX_CODES)
+	{
+		_blocks = original;
+		_after = _before;
+		std::copy(fields.begin(), fields.end(), script.fieldData);
+		return {};
+	}
+
+	std::memset(script.codeData, 0, MAX_CODES * sizeof(ScriptCode));
+	std::memcpy(script.codeData, codes.data(), codes.size() * sizeof(ScriptCode));
+	_after = turnCosts(_blocks, turns);
+	return stats;
+}
+
+const std::vector<EveryBlock>& EveryStaggering::blocks() const { return _blocks; }
+
+const std::vector<double>& EveryStaggering::before() const { return _before; }
+const std::vector<double>& EveryStaggering::after() const { return _after; }
+
+void EveryStaggering::printHistogram(std::ostream& output) const
+{
+	output << "Before:" << std::endl;
+	printHistogram(output, _before);
+	output << "After:" << std::endl;
+	printHistogram(output, _after);
+}
+
+std::vector<EveryBlock> EveryStaggering::collect(const Script& script)
+{
+	std::vector<EveryBlock> blocks{};
+	const uint16_t length = script.length();
+	for (uint16_t pos = 1; pos < length; ++pos)
+	{
+		if (script.codeData[pos] != InstructionToken::Every)
+			continue;
+
+		uint16_t body = pos + 1;
+		while (body < length && script.codeData[body] < TOKEN_OFFSET)
+			++body;
+
+		EveryBlock block{ pos, body, body, 0, 0, false, 0 };
+		if (body >= length || script.codeData[body] != InstructionToken::Begin || body - pos < 2 || body - pos > 3 ||
+			!constant_operand(script, pos + 1, block.period) || block.period == 0)
+			continue;
+
+		if (body - pos == 3)
+		{
+			block.fixed = true;
+			if (!constant_operand(script, pos + 2, block.offset))
+				block.offset = 0;
+			block.offset %= block.period;
+		}
+
+		int depth = 0;
+		for (block.end = body; block.end < length; ++block.end)
+			if ((depth += Script::blockDelta(script.codeData[block.end])) == 0)
+				break;
+		if (block.end >= length)
+			continue;
+
+		block.cost = block.end - body - 1;
+		blocks.push_back(block);
+		pos = block.end;
+	}
+	return blocks;
+}
+
+std::vector<double> EveryStaggering::turnCosts(const std::vector<EveryBlock>& blocks, uint32_t turns)
+{
+	std::vector<double> costs(turns, 0);
+	for (const EveryBlock& block : blocks)
+		add_load(costs, block);
+	return costs;
+}
+
+void EveryStaggering::printHistogram(std::ostream& output, const std::vector<double>& costs)
+{
+	const double peak = costs.empty() ? 0 : *std::max_element(costs.begin(), costs.end());
+	for (size_t turn = 0; turn < costs.size(); ++turn)
+	{
+		const size_t width = peak > 0 ? static_cast<size_t>(costs[turn] / peak * HISTOGRAM_WIDTH + 0.5) : 0;
+		output << std::setw(5) << turn << " " << std::setw(8) << costs[turn] << " " << std::string(width, '#') << std::endl;
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cinttypes>
+#include <vector>
+#include <ostream>
+
+#include "script.h"
+#include "optimizer.h"
+
+struct EveryBlock
+{
+	uint16_t position;
+	uint16_t body;
+	uint16_t end;
+	uint32_t period;
+	uint32_t offset;
+	bool fixed;
+	double cost;
+};
+
+class EveryStaggering
+{
+private:
+	uint32_t _maxTurns;
+	std::vector<EveryBlock> _blocks;
+	std::vector<double> _before;
+	std::vector<double> _after;
+
+public:
+	EveryStaggering(uint32_t maxTurns = 4096);
+
+	OptimizationStats run(Script& script);
+
+	const std::vector<EveryBlock>& blocks() const;
+
+	const std::vector<double>& before() const;
+	const std::vector<double>& after() const;
+
+	void printHistogram(std::ostream& output) const;
+
+public:
+	static std::vector<EveryBlock> collect(const Script& script);
+
+	static std::vector<double> turnCosts(const std::vector<EveryBlock>& blocks, uint32_t turns);
+
+	static void printHistogram(std::ostream& output, const std::vector<double>& costs);
+};
@@ -0,0 +1,245 @@
+#include "incremental.h"
+
+#include <cctype>
+
+#include "profiler.h"
+
+namespace
+{
+	size_t skip_trivia(const std::string& src, size_t pos)
+	{
+		while (pos < src.size())
+		{
+			if (std::isspace(static_cast<unsigned char>(src[pos])))
+				++pos;
+			else if (src.compare(pos, 2, "//") == 0)
+			{
+				pos = src.find('\n', pos);
+				if (pos == std::string::npos)
+					return src.size();
+			}
+			else if (src.compare(pos, 2, "/*") == 0)
+			{
+				pos = src.find("*/", pos + 2);
+				if (pos == std::string::npos)
+					return src.size();
+				pos += 2;
+			}
+			else break;
+		}
+		return pos;
+	}
+
+	bool continues_with_else(const std::string& src, size_t pos)
+	{
+		pos = skip_trivia(src, pos);
+		if (src.compare(pos, 4, "else") != 0)
+			return false;
+		pos += 4;
+		return pos >= src.size() || !(std::isalnum(static_cast<unsigned char>(src[pos])) || src[pos] == '_');
+	}
+
+	size_t scan_segment(const std::string& src, size_t pos)
+	{
+		unsigned int depth = 0;
+		while (pos < src.size())
+		{
+			const size_t next = skip_trivia(src, pos);
+			if (next != pos)
+			{
+				pos = next;
+				continue;
+			}
+
+			const char c = src[pos++];
+			switch (c)
+			{
+				case '"':
+				case '\'':
+					while (pos < src.size() && src[pos] != c)
+						pos += src[pos] == '\\' ? 2 : 1;
+					if (pos < src.size())
+						++pos;
+					break;
+
+				case '{':
+				case '(':
+				case '[':
+					++depth;
+					break;
+
+				case ')':
+				case ']':
+					if (depth > 0)
+						--depth;
+					break;
+
+				case '}':
+					if (depth > 0 && --depth == 0 && !continues_with_else(src, pos))
+						return pos;
+					break;
+
+				case ';':
+					if (depth == 0)
+						return pos;
+					break;
+			}
+		}
+		return src.size();
+	}
+}
+
+
+
+IncrementalSource::IncrementalSource() :
+	_source{},
+	_segments{}
+{}
+
+IncrementalSource::IncrementalSource(const std::string& source) :
+	IncrementalSource{}
+{
+	reset(source);
+}
+
+const std::string& IncrementalSource::source() const { return _source; }
+
+size_t IncrementalSource::size() const { return _segments.size(); }
+bool IncrementalSource::empty() const { return _segments.empty(); }
+
+const SourceSegment& IncrementalSource::operator[] (const size_t idx) const { return _segments[idx]; }
+
+std::string IncrementalSource::text(const size_t idx) const
+{
+	const SourceSegment& seg = _segments[idx];
+	return _source.substr(seg.offset, seg.length);
+}
+
+bool IncrementalSource::isDirty(const size_t idx) const { return _segments[idx].dirty; }
+
+size_t IncrementalSource::dirtyCount() const
+{
+	size_t count = 0;
+	for (const SourceSegment& seg : _segments)
+		if (seg.dirty)
+			++count;
+	return count;
+}
+
+void IncrementalSource::reset(const std::string& source)
+{
+	PROFILE_SCOPE("lex");
+
+	_source = source;
+	_segments.clear();
+	for (size_t pos = 0; pos < _source.size();)
+	{
+		const size_t end = scan_segment(_source, pos);
+		_segments.push_back({ pos, end - pos, {}, {}, true });
+		pos = end;
+	}
+}
+
+void IncrementalSource::edit(size_t offset, size_t removed, const std::string& text)
+{
+	PROFILE_SCOPE("lex");
+
+	if (offset > _source.size())
+		offset = _source.size();
+	if (removed > _source.size() - offset)
+		removed = _source.size() - offset;
+
+	_source.replace(offset, removed, text);
+	const ptrdiff_t delta = static_cast<ptrdiff_t>(text.size()) - static_cast<ptrdiff_t>(removed);
+	const size_t oldEditEnd = offset + removed;
+	const size_t newEditEnd = offset + text.size();
+
+	size_t first = 0;
+	while (first + 1 < _segments.size() && _segments[first + 1].offset < offset)
+		++first;
+
+	std::vector<SourceSegment> fresh{};
+	size_t next = first;
+	bool resync = false;
+	for (size_t pos = first < _segments.size() ? _segments[first].offset : 0; pos < _source.size();)
+	{
+		const size_t end = scan_segment(_source, pos);
+		fresh.push_back({ pos, end - pos, {}, {}, true });
+		pos = end;
+
+		if (pos < newEditEnd)
+			continue;
+
+		const size_t oldPos = static_cast<size_t>(static_cast<ptrdiff_t>(pos) - delta);
+		while (next < _segments.size() && _segments[next].offset + _segments[next].length < oldPos)
+			++next;
+		if (next < _segments.size() && _segments[next].offset + _segments[next].length == oldPos && oldPos >= oldEditEnd)
+		{
+			++next;
+			resync = true;
+			break;
+		}
+	}
+	if (!resync)
+		next = _segments.size();
+
+	if (!fresh.empty() && first < _segments.size())
+	{
+		SourceSegment& old = _segments[first];
+		if (fresh.front().offset == old.offset && fresh.front().length == old.length && old.offset + old.length <= offset)
+			fresh.front() = std::move(old);
+	}
+
+	for (size_t i = next; i < _segments.size(); ++i)
+		_segments[i].offset = static_cast<size_t>(static_cast<ptrdiff_t>(_segments[i].offset) + delta);
+
+	_segments.erase(_segments.begin() + first, _segments.begin() + next);
+	_segments.insert(_segments.begin() + first,
+		std::make_move_iterator(fresh.begin()), std::make_move_iterator(fresh.end()));
+}
+
+void IncrementalSource::store(const size_t idx, const ScriptCodeBuilder& fragment, const Script& script)
+{
+	SourceSegment& seg = _segments[idx];
+	fragment.build(seg.codes);
+	seg.fields.clear();
+
+	std::vector<ScriptCode> local(MAX_FIELDS, MAX_FIELDS);
+	for (ScriptCode& code : seg.codes)
+	{
+		if (code >= MAX_FIELDS)
+			continue;
+
+		if (local[code] >= MAX_FIELDS)
+		{
+			local[code] = static_cast<ScriptCode>(seg.fields.size());
+			seg.fields.push_back(script.field(code));
+		}
+		code = local[code];
+	}
+	seg.dirty = false;
+}
+
+void IncrementalSource::build(Script& script) const
+{
+	ScriptCodeStream stream{ script, 1 };
+	std::vector<ScriptCode> codes{};
+	std::vector<ScriptCode> remap{};
+	for (const SourceSegment& seg : _segments)
+	{
+		remap.clear();
+		for (const ScriptField& field : seg.fields)
+		{
+			const ScriptCode index = script.addField(field);
+			if (index >= MAX_FIELDS)
+				throw FullFieldData{};
+			remap.push_back(index);
+		}
+
+		codes = seg.codes;
+		for (ScriptCode& code : codes)
+			if (code < remap.size())
+				code = remap[code];
+		stream.write(codes);
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "script.h"
+
+struct SourceSegment
+{
+	size_t offset;
+	size_t length;
+	std::vector<ScriptCode> codes;
+	std::vector<ScriptField> fields;
+	bool dirty;
+};
+
+class IncrementalSource
+{
+private:
+	std::string _source;
+	std::vector<SourceSegment> _segments;
+
+public:
+	IncrementalSource();
+	IncrementalSource(const std::string& source);
+
+	const std::string& source() const;
+
+	size_t size() const;
+	bool empty() const;
+
+	const SourceSegment& operator[] (const size_t idx) const;
+
+	std::string text(const size_t idx) const;
+	bool isDirty(const size_t idx) const;
+	size_t dirtyCount() const;
+
+	void reset(const std::string& source);
+	void edit(size_t offset, size_t removed, const std::string& text);
+
+	void store(const size_t idx, const ScriptCodeBuilder& fragment, const Script& script);
+
+	void build(Script& script) const;
+};
@@ -0,0 +1,861 @@
+#include "ir.h"
+
+#include <sstream>
+#include <algorithm>
+
+#include "token_names.h"
+#include "profiler.h"
+
+namespace
+{
+	const Error UNSUPPORTED_EXPRESSION{ ErrorCode::UnsupportedIr, "Expression cannot be represented in the IR" };
+	const Error INVALID_TARGET{ ErrorCode::InvalidIdentifier, "Assignment target must be a variable" };
+	const Error NOT_LOWERABLE{ ErrorCode::UnsupportedIr, "IR value cannot be lowered to script codes" };
+
+	const Error UNDEFINED_VALUE{ ErrorCode::UndefinedIrValue, "Operand is not defined before its use" };
+	const Error RESULT_MISMATCH{ ErrorCode::InvalidIrInstruction, "Result value does not match the instruction" };
+	const Error OPERAND_COUNT{ ErrorCode::InvalidIrInstruction, "Wrong number of operands" };
+	const Error INVALID_FIELD{ ErrorCode::InvalidIrInstruction, "Field kind does not match the instruction" };
+	const Error TYPE_MISMATCH{ ErrorCode::InvalidIrInstruction, "Operand types do not match" };
+	const Error UNKNOWN_VARIABLE{ ErrorCode::InvalidIrInstruction, "Variable slot is not declared" };
+	const Error INVALID_ACTION{ ErrorCode::InvalidIrInstruction, "Action code refers to a missing operand" };
+	const Error INVALID_PERIOD{ ErrorCode::InvalidIrInstruction, "Every period must be positive and larger than its offset" };
+	const Error INVALID_REGION{ ErrorCode::InvalidIrRegion, "Region is not owned by its instruction" };
+	const Error SHARED_REGION{ ErrorCode::InvalidIrRegion, "Region is reachable more than once" };
+
+	size_t hash_combine(size_t seed, size_t value) { return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2)); }
+
+	bool binary_opcode(const Operator& op, IrOpcode& opcode)
+	{
+		if (op == Operator::Multiplication) opcode = IrOpcode::Multiply;
+		else if (op == Operator::Division) opcode = IrOpcode::Divide;
+		else if (op == Operator::Addition) opcode = IrOpcode::Add;
+		else if (op == Operator::Subtraction) opcode = IrOpcode::Subtract;
+		else if (op == Operator::GreaterThan) opcode = IrOpcode::GreaterThan;
+		else if (op == Operator::SmallerThan) opcode = IrOpcode::LessThan;
+		else if (op == Operator::GreaterEqualsThan) opcode = IrOpcode::GreaterThanEqualTo;
+		else if (op == Operator::SmallerEqualsThan) opcode = IrOpcode::LessThanEqualTo;
+		else if (op == Operator::EqualsTo) opcode = IrOpcode::EqualTo;
+		else if (op == Operator::NotEqualsTo) opcode = IrOpcode::NotEqualTo;
+		else if (op == Operator::BinaryAnd) opcode = IrOpcode::And;
+		else if (op == Operator::BinaryOr) opcode = IrOpcode::Or;
+		else return false;
+		return true;
+	}
+
+	bool assignment_opcode(const Operator& op, IrOpcode& opcode)
+	{
+		if (op == Operator::AssignmentAddition || op == Operator::SufixIncrement || op == Operator::PrefixIncrement) opcode = IrOpcode::Add;
+		else if (op == Operator::AssignmentSubtraction || op == Operator::SufixDecrement || op == Operator::PrefixDecrement) opcode = IrOpcode::Subtract;
+		else if (op == Operator::AssignmentMultiplication) opcode = IrOpcode::Multiply;
+		else if (op == Operator::AssignmentDivision) opcode = IrOpcode::Divide;
+		else return false;
+		return true;
+	}
+
+	ScriptCode opcode_token(IrOpcode opcode)
+	{
+		switch (opcode)
+		{
+			case IrOpcode::Multiply: return InstructionToken::Multiply;
+			case IrOpcode::Divide: return InstructionToken::Divide;
+			case IrOpcode::GreaterThan: return InstructionToken::GreaterThan;
+			case IrOpcode::LessThan: return InstructionToken::LessThan;
+			case IrOpcode::GreaterThanEqualTo: return InstructionToken::GreaterThanEqualTo;
+			case IrOpcode::LessThanEqualTo: return InstructionToken::LessThanEqualTo;
+			case IrOpcode::EqualTo: return InstructionToken::Equalto;
+			case IrOpcode::NotEqualTo: return InstructionToken::NotEqualTo;
+			case IrOpcode::And: return InstructionToken::And;
+			case IrOpcode::Or: return InstructionToken::Or;
+			default: return InstructionToken::ScriptEnd;
+		}
+	}
+
+	size_t expected_operands(IrOpcode opcode)
+	{
+		switch (opcode)
+		{
+			case IrOpcode::Constant:
+			case IrOpcode::Internal:
+			case IrOpcode::Load:
+			case IrOpcode::Every:
+				return 0;
+			case IrOpcode::Store:
+			case IrOpcode::If:
+				return 1;
+			default:
+				return 2;
+		}
+	}
+
+	FieldType expected_field(IrOpcode opcode)
+	{
+		switch (opcode)
+		{
+			case IrOpcode::Constant: return FieldType::Constant;
+			case IrOpcode::Internal: return FieldType::Internal;
+			case IrOpcode::Load: return FieldType::User;
+			default: return FieldType::Invalid;
+		}
+	}
+
+	size_t expected_regions(IrOpcode opcode)
+	{
+		return opcode == IrOpcode::If ? 2 : opcode == IrOpcode::Every ? 1 : 0;
+	}
+
+	bool compatible_types(const DataType& left, const DataType& right)
+	{
+		return left == right || left == DataType::integer() || right == DataType::integer();
+	}
+
+	std::string value_name(IrValue value) { return "%" + std::to_string(value); }
+
+	std::string code_name(ScriptCode code)
+	{
+		const char* const name = token_name(code);
+		return name ? name : std::to_string(code);
+	}
+
+
+	class IrLowering
+	{
+	private:
+		CompilerContext& _context;
+		const IrFunction& _function;
+		ScriptCodeBuilder& _out;
+
+	public:
+		IrLowering(CompilerContext& context, const IrFunction& function, ScriptCodeBuilder& out) :
+			_context{ context },
+			_function{ function },
+			_out{ out }
+		{}
+
+		Result<void> region(uint32_t index)
+		{
+			for (const uint32_t instruction : _function.region(index).instructions)
+			{
+				const Result<void> result = lower(_function.instruction(instruction));
+				if (!result)
+					return result;
+			}
+			return {};
+		}
+
+	private:
+		Result<void> lower(const IrInstruction& instruction)
+		{
+			Result<void> result{};
+			switch (instruction.opcode)
+			{
+				case IrOpcode::Store:
+					return store(instruction);
+
+				case IrOpcode::Action:
+					for (const ScriptCode code : instruction.codes)
+					{
+						if (!(result = code >= TOKEN_OFFSET ? push(code) : field(instruction.operands[code])))
+							return result;
+					}
+					return result;
+
+				case IrOpcode::If:
+					if (!(result = push(InstructionToken::If)) || !(result = expression(instruction.operands[0])) ||
+						!(result = push(InstructionToken::Begin)) || !(result = region(instruction.regions[0])) ||
+						!(result = push(InstructionToken::End)))
+						return result;
+					if (!_function.region(instruction.regions[1]).instructions.empty() &&
+						(!(result = push(InstructionToken::Else)) || !(result = push(InstructionToken::Begin)) ||
+						!(result = region(instruction.regions[1])) || !(result = push(InstructionToken::End))))
+						return result;
+					return push(InstructionToken::Endif);
+
+				case IrOpcode::Every:
+					if (!(result = push(InstructionToken::Every)) || !(result = constant(instruction.immediate)) ||
+						(instruction.offset != 0 && !(result = constant(instruction.offset))) ||
+						!(result = push(InstructionToken::Begin)) || !(result = region(instruction.regions[0])))
+						return result;
+					return push(InstructionToken::End);
+
+				default:
+					return result;
+			}
+		}
+
+		Result<void> store(const IrInstruction& instruction)
+		{
+			const Result<uint16_t> variable = _context.tryVariableField(_function.variableName(instruction.immediate));
+			if (!variable)
+				return variable.error();
+
+			const IrInstruction& value = _function.definition(instruction.operands[0]);
+			if (isLeaf(value))
+				return assign(InstructionToken::Set, variable.value(), instruction.operands[0]);
+			if (value.opcode != IrOpcode::Add && value.opcode != IrOpcode::Subtract)
+				return NOT_LOWERABLE;
+
+			const ScriptCode update = value.opcode == IrOpcode::Add ? InstructionToken::Increment : InstructionToken::Decrement;
+			const IrValue left = value.operands[0];
+			const IrValue right = value.operands[1];
+			if (isVariable(left, instruction.immediate))
+				return assign(update, variable.value(), right);
+			if (value.opcode == IrOpcode::Add && isVariable(right, instruction.immediate))
+				return assign(update, variable.value(), left);
+			if (isVariable(right, instruction.immediate))
+				return NOT_LOWERABLE;
+
+			const Result<void> result = assign(InstructionToken::Set, variable.value(), left);
+			return result ? assign(update, variable.value(), right) : result;
+		}
+
+		Result<void> assign(ScriptCode token, uint16_t variable, IrValue value)
+		{
+			Result<void> result{};
+			if (!(result = push(token)) || !(result = push(variable)))
+				return result;
+			return field(value);
+		}
+
+		Result<void> expression(IrValue value)
+		{
+			const IrInstruction& instruction = _function.definition(value);
+			if (!IrFunction::isLogical(instruction.opcode))
+				return comparison(value);
+
+			Result<void> result{};
+			if (!(result = expression(instruction.operands[0])) || !(result = push(opcode_token(instruction.opcode))))
+				return result;
+			return comparison(instruction.operands[1]);
+		}
+
+		Result<void> comparison(IrValue value)
+		{
+			const IrInstruction& instruction = _function.definition(value);
+			if (!IrFunction::isComparison(instruction.opcode))
+				return product(value);
+
+			Result<void> result{};
+			if (!(result = product(instruction.operands[0])) || !(result = push(opcode_token(instruction.opcode))))
+				return result;
+			return product(instruction.operands[1]);
+		}
+
+		Result<void> product(IrValue value)
+		{
+			const IrInstruction& instruction = _function.definition(value);
+			if (instruction.opcode != IrOpcode::Multiply && instruction.opcode != IrOpcode::Divide)
+				return factor(value);
+
+			Result<void> result{};
+			if (!(result = product(instruction.operands[0])) || !(result = push(opcode_token(instruction.opcode))))
+				return result;
+			return factor(instruction.operands[1]);
+		}
+
+		Result<void> factor(IrValue value)
+		{
+			const IrInstruction& instruction = _function.definition(value);
+			if (isLeaf(instruction))
+				return field(value);
+			if (instruction.opcode == IrOpcode::Add || instruction.opcode == IrOpcode::Subtract)
+				return NOT_LOWERABLE;
+
+			Result<void> result{};
+			if (!(result = push(InstructionToken::ExpStart)) || !(result = expression(value)))
+				return result;
+			return push(InstructionToken::ExpEnd);
+		}
+
+		Result<void> field(IrValue value)
+		{
+			const IrInstruction& instruction = _function.definition(value);
+			Result<uint16_t> index = NOT_LOWERABLE;
+			switch (instruction.opcode)
+			{
+				case IrOpcode::Constant: index = _context.tryConstantField(instruction.immediate); break;
+				case IrOpcode::Internal: index = _context.tryInternalField(static_cast<ScriptCode>(instruction.immediate)); break;
+				case IrOpcode::Load: index = _context.tryVariableField(_function.variableName(instruction.immediate)); break;
+				default: break;
+			}
+			return index ? push(index.value()) : Result<void>{ index.error() };
+		}
+
+		Result<void> constant(field_value_t value)
+		{
+			const Result<uint16_t> index = _context.tryConstantField(value);
+			return index ? push(index.value()) : Result<void>{ index.error() };
+		}
+
+		Result<void> push(ScriptCode code)
+		{
+			const Result<CodeLocation> result = _out.try_push_back(code);
+			return result ? Result<void>{} : Result<void>{ result.error() };
+		}
+
+		bool isVariable(IrValue value, field_value_t slot) const
+		{
+			const IrInstruction& instruction = _function.definition(value);
+			return instruction.opcode == IrOpcode::Load && instruction.immediate == slot;
+		}
+
+		static bool isLeaf(const IrInstruction& instruction)
+		{
+			return instruction.opcode == IrOpcode::Constant || instruction.opcode == IrOpcode::Internal || instruction.opcode == IrOpcode::Load;
+		}
+	};
+}
+
+IrFunction::IrFunction() :
+	_instructions{},
+	_regions{ { IR_NO_REGION, IR_NO_REGION, {} } },
+	_values{},
+	_variables{}
+{}
+
+uint32_t IrFunction::instructionCount() const { return static_cast<uint32_t>(_instructions.size()); }
+uint32_t IrFunction::regionCount() const { return static_cast<uint32_t>(_regions.size()); }
+uint32_t IrFunction::valueCount() const { return static_cast<uint32_t>(_values.size()); }
+uint32_t IrFunction::variableCount() const { return static_cast<uint32_t>(_variables.size()); }
+
+IrInstruction& IrFunction::instruction(uint32_t index) { return _instructions[index]; }
+const IrInstruction& IrFunction::instruction(uint32_t index) const { return _instructions[index]; }
+
+IrRegion& IrFunction::region(uint32_t index) { return _regions[index]; }
+const IrRegion& IrFunction::region(uint32_t index) const { return _regions[index]; }
+
+uint32_t IrFunction::definingInstruction(IrValue value) const { return _values[value]; }
+const IrInstruction& IrFunction::definition(IrValue value) const { return _instructions[_values[value]]; }
+
+field_value_t IrFunction::variable(const std::string& name)
+{
+	const auto it = std::find(_variables.begin(), _variables.end(), name);
+	if (it != _variables.end())
+		return static_cast<field_value_t>(it - _variables.begin());
+
+	_variables.push_back(name);
+	return static_cast<field_value_t>(_variables.size() - 1);
+}
+
+const std::string& IrFunction::variableName(field_value_t slot) const { return _variables[slot]; }
+
+uint32_t IrFunction::append(uint32_t region, const IrInstruction& instruction)
+{
+	const uint32_t index = static_cast<uint32_t>(_instructions.size());
+	_instructions.push_back(instruction);
+
+	IrInstruction& added = _instructions.back();
+	added.region = region;
+	if (producesValue(added.opcode))
+	{
+		added.result = static_cast<IrValue>(_values.size());
+		_values.push_back(index);
+	}
+	else added.result = IR_NO_VALUE;
+
+	_regions[region].instructions.push_back(index);
+	return index;
+}
+
+uint32_t IrFunction::addRegion(uint32_t parent, uint32_t owner)
+{
+	_regions.push_back({ parent, owner, {} });
+	return static_cast<uint32_t>(_regions.size() - 1);
+}
+
+void IrFunction::remove(uint32_t index)
+{
+	IrInstruction& instruction = _instructions[index];
+	if (instruction.region == IR_NO_REGION)
+		return;
+
+	std::vector<uint32_t>& instructions = _regions[instruction.region].instructions;
+	instructions.erase(std::remove(instructions.begin(), instructions.end(), index), instructions.end());
+	instruction.region = IR_NO_REGION;
+
+	for (const uint32_t child : instruction.regions)
+	{
+		const std::vector<uint32_t> nested = _regions[child].instructions;
+		for (const uint32_t inner : nested)
+			remove(inner);
+	}
+}
+
+void IrFunction::inlineRegion(uint32_t index, uint32_t region)
+{
+	const uint32_t parent = _instructions[index].region;
+	if (parent == IR_NO_REGION)
+		return;
+
+	std::vector<uint32_t> moved{};
+	moved.swap(_regions[region].instructions);
+	for (const uint32_t inner : moved)
+	{
+		_instructions[inner].region = parent;
+		for (const uint32_t child : _instructions[inner].regions)
+			_regions[child].parent = parent;
+	}
+
+	std::vector<uint32_t>& siblings = _regions[parent].instructions;
+	siblings.insert(std::find(siblings.begin(), siblings.end(), index), moved.begin(), moved.end());
+	remove(index);
+}
+
+void IrFunction::replaceUses(IrValue from, IrValue to)
+{
+	for (IrInstruction& instruction : _instructions)
+		std::replace(instruction.operands.begin(), instruction.operands.end(), from, to);
+}
+
+uint32_t IrFunction::uses(IrValue value) const
+{
+	uint32_t count = 0;
+	for (const IrInstruction& instruction : _instructions)
+	{
+		if (instruction.region != IR_NO_REGION)
+			count += static_cast<uint32_t>(std::count(instruction.operands.begin(), instruction.operands.end(), value));
+	}
+	return count;
+}
+
+size_t IrFunction::hash() const
+{
+	size_t seed = hash_combine(_variables.size(), _values.size());
+	for (const std::string& variable : _variables)
+		seed = hash_combine(seed, std::hash<std::string>{}(variable));
+
+	std::vector<uint32_t> pending{ IR_ROOT_REGION };
+	while (!pending.empty())
+	{
+		const uint32_t region = pending.back();
+		pending.pop_back();
+
+		seed = hash_combine(seed, region);
+		for (const uint32_t index : _regions[region].instructions)
+		{
+			const IrInstruction& instruction = _instructions[index];
+			seed = hash_combine(seed, static_cast<size_t>(instruction.opcode));
+			seed = hash_combine(seed, instruction.result);
+			seed = hash_combine(seed, std::hash<std::string>{}(instruction.type.name()));
+			seed = hash_combine(seed, static_cast<size_t>(instruction.immediate));
+			seed = hash_combine(seed, static_cast<size_t>(instruction.offset));
+			for (const IrValue operand : instruction.operands)
+				seed = hash_combine(seed, operand);
+			for (const ScriptCode code : instruction.codes)
+				seed = hash_combine(seed, code);
+			pending.insert(pending.end(), instruction.regions.rbegin(), instruction.regions.rend());
+		}
+	}
+	return seed;
+}
+
+std::string IrFunction::toString() const
+{
+	std::stringstream ss{};
+	print(ss, IR_ROOT_REGION, 0);
+	return ss.str();
+}
+
+void IrFunction::print(std::ostream& output, uint32_t region, unsigned int depth) const
+{
+	for (const uint32_t index : _regions[region].instructions)
+	{
+		const IrInstruction& instruction = _instructions[index];
+		const std::string indent(depth, '\t');
+
+		output << indent;
+		if (instruction.result != IR_NO_VALUE)
+			output << value_name(instruction.result) << " = ";
+		output << opcodeName(instruction.opcode);
+
+		switch (instruction.opcode)
+		{
+			case IrOpcode::Constant:
+				output << " " << instruction.immediate;
+				break;
+			case IrOpcode::Internal:
+				output << " " << instruction.immediate;
+				break;
+			case IrOpcode::Load:
+			case IrOpcode::Store:
+				output << " " << _variables[instruction.immediate];
+				break;
+			case IrOpcode::Every:
+				output << " " << instruction.immediate << " " << instruction.offset;
+				break;
+			case IrOpcode::Action:
+				for (const ScriptCode code : instruction.codes)
+					output << " " << (code >= TOKEN_OFFSET ? code_name(code) : value_name(instruction.operands[code]));
+				break;
+			default:
+				break;
+		}
+
+		if (instruction.opcode != IrOpcode::Action)
+		{
+			for (const IrValue operand : instruction.operands)
+				output << " " << value_name(operand);
+		}
+		if (instruction.result != IR_NO_VALUE)
+			output << " : " << instruction.type.name();
+		output << std::endl;
+
+		for (size_t i = 0; i < instruction.regions.size(); ++i)
+		{
+			if (i > 0)
+				output << indent << "else" << std::endl;
+			print(output, instruction.regions[i], depth + 1);
+		}
+		if (!instruction.regions.empty())
+			output << indent << "end" << std::endl;
+	}
+}
+
+bool IrFunction::producesValue(IrOpcode opcode)
+{
+	return opcode != IrOpcode::Store && opcode != IrOpcode::Action && opcode != IrOpcode::If && opcode != IrOpcode::Every;
+}
+
+bool IrFunction::isComparison(IrOpcode opcode)
+{
+	return opcode >= IrOpcode::GreaterThan && opcode <= IrOpcode::NotEqualTo;
+}
+
+bool IrFunction::isArithmetic(IrOpcode opcode)
+{
+	return opcode >= IrOpcode::Add && opcode <= IrOpcode::Divide;
+}
+
+bool IrFunction::isLogical(IrOpcode opcode)
+{
+	return opcode == IrOpcode::And || opcode == IrOpcode::Or;
+}
+
+const char* IrFunction::opcodeName(IrOpcode opcode)
+{
+	switch (opcode)
+	{
+		case IrOpcode::Constant: return "constant";
+		case IrOpcode::Internal: return "internal";
+		case IrOpcode::Load: return "load";
+		case IrOpcode::Store: return "store";
+		case IrOpcode::Add: return "add";
+		case IrOpcode::Subtract: return "sub";
+		case IrOpcode::Multiply: return "mul";
+		case IrOpcode::Divide: return "div";
+		case IrOpcode::GreaterThan: return "gt";
+		case IrOpcode::LessThan: return "lt";
+		case IrOpcode::GreaterThanEqualTo: return "ge";
+		case IrOpcode::LessThanEqualTo: return "le";
+		case IrOpcode::EqualTo: return "eq";
+		case IrOpcode::NotEqualTo: return "ne";
+		case IrOpcode::And: return "and";
+		case IrOpcode::Or: return "or";
+		case IrOpcode::Action: return "action";
+		case IrOpcode::If: return "if";
+		case IrOpcode::Every: return "every";
+		default: return "unknown";
+	}
+}
+
+
+
+
+IrBuilder::IrBuilder(IrFunction& function) :
+	_function{ function },
+	_region{ IR_ROOT_REGION }
+{}
+
+IrFunction& IrBuilder::function() { return _function; }
+
+uint32_t IrBuilder::region() const { return _region; }
+void IrBuilder::setRegion(uint32_t region) { _region = region; }
+
+IrValue IrBuilder::constant(field_value_t value, const DataType& type)
+{
+	IrInstruction instruction = make(IrOpcode::Constant, type, FieldType::Constant);
+	instruction.immediate = value;
+	return _function.instruction(_function.append(_region, instruction)).result;
+}
+
+IrValue IrBuilder::internal(ScriptCode code, const DataType& type)
+{
+	IrInstruction instruction = make(IrOpcode::Internal, type, FieldType::Internal);
+	instruction.immediate = code;
+	return _function.instruction(_function.append(_region, instruction)).result;
+}
+
+IrValue IrBuilder::load(const std::string& variable)
+{
+	IrInstruction instruction = make(IrOpcode::Load, DataType::integer(), FieldType::User);
+	instruction.immediate = _function.variable(variable);
+	return _function.instruction(_function.append(_region, instruction)).result;
+}
+
+void IrBuilder::store(const std::string& variable, IrValue value)
+{
+	IrInstruction instruction = make(IrOpcode::Store);
+	instruction.immediate = _function.variable(variable);
+	instruction.operands = { value };
+	_function.append(_region, instruction);
+}
+
+IrValue IrBuilder::binary(IrOpcode opcode, IrValue left, IrValue right)
+{
+	IrInstruction instruction = make(opcode);
+	instruction.operands = { left, right };
+	return _function.instruction(_function.append(_region, instruction)).result;
+}
+
+void IrBuilder::action(const std::vector<ScriptCode>& codes, const std::vector<IrValue>& operands)
+{
+	IrInstruction instruction = make(IrOpcode::Action);
+	instruction.codes = codes;
+	instruction.operands = operands;
+	_function.append(_region, instruction);
+}
+
+uint32_t IrBuilder::beginIf(IrValue condition)
+{
+	IrInstruction instruction = make(IrOpcode::If);
+	instruction.operands = { condition };
+	const uint32_t index = _function.append(_region, instruction);
+
+	const uint32_t then = _function.addRegion(_region, index);
+	const uint32_t otherwise = _function.addRegion(_region, index);
+	_function.instruction(index).regions = { then, otherwise };
+	_region = then;
+	return index;
+}
+
+void IrBuilder::beginElse(uint32_t ifInstruction) { _region = _function.instruction(ifInstruction).regions[1]; }
+void IrBuilder::endIf(uint32_t ifInstruction) { _region = _function.instruction(ifInstruction).region; }
+
+uint32_t IrBuilder::beginEvery(field_value_t period, field_value_t offset)
+{
+	IrInstruction instruction = make(IrOpcode::Every);
+	instruction.immediate = period;
+	instruction.offset = offset;
+	const uint32_t index = _function.append(_region, instruction);
+
+	const uint32_t body = _function.addRegion(_region, index);
+	_function.instruction(index).regions = { body };
+	_region = body;
+	return index;
+}
+
+void IrBuilder::endEvery(uint32_t everyInstruction) { _region = _function.instruction(everyInstruction).region; }
+
+Result<IrValue> IrBuilder::expression(const Statement& statement)
+{
+	switch (statement.getCodeFragmentType())
+	{
+		case CodeFragmentType::LiteralInteger:
+			return constant(dynamic_cast<const LiteralInteger&>(statement).getValue());
+
+		case CodeFragmentType::TypeConstant: {
+			const TypeConstant& value = dynamic_cast<const TypeConstant&>(statement);
+			return constant(value.getValue(), value.getType());
+		}
+
+		case CodeFragmentType::Identifier:
+			return load(statement.toString());
+
+		case CodeFragmentType::Operation: {
+			const Operation& op = dynamic_cast<const Operation&>(statement);
+			if (op.isUnary() && op.getOperator() == Operator::UnaryMinus)
+			{
+				const Result<IrValue> operand = expression(op.getOperand(0));
+				if (!operand)
+					return operand;
+				const IrValue zero = constant(0);
+				return binary(IrOpcode::Subtract, zero, operand.value());
+			}
+
+			IrOpcode opcode{};
+			if (!op.isBinary() || !binary_opcode(op.getOperator(), opcode))
+				return UNSUPPORTED_EXPRESSION;
+
+			const Result<IrValue> left = expression(op.getOperand(0));
+			if (!left)
+				return left;
+			const Result<IrValue> right = expression(op.getOperand(1));
+			if (!right)
+				return right;
+			return binary(opcode, left.value(), right.value());
+		}
+
+		default:
+			return UNSUPPORTED_EXPRESSION;
+	}
+}
+
+Result<void> IrBuilder::statement(const Statement& statement)
+{
+	if (statement.getCodeFragmentType() != CodeFragmentType::Operation)
+		return UNSUPPORTED_EXPRESSION;
+
+	const Operation& op = dynamic_cast<const Operation&>(statement);
+	const Operator& oper = op.getOperator();
+	IrOpcode opcode{};
+	const bool update = assignment_opcode(oper, opcode);
+	if (oper != Operator::Assignment && !update)
+		return UNSUPPORTED_EXPRESSION;
+	if (op.getOperand(0).getCodeFragmentType() != CodeFragmentType::Identifier)
+		return INVALID_TARGET;
+
+	const std::string target = op.getOperand(0).toString();
+	Result<IrValue> value = op.getOperandCount() > 1 ? expression(op.getOperand(1)) : Result<IrValue>{ constant(1) };
+	if (!value)
+		return value.error();
+
+	if (update)
+	{
+		const IrValue current = load(target);
+		value = binary(opcode, current, value.value());
+	}
+	store(target, value.value());
+	return {};
+}
+
+IrInstruction IrBuilder::make(IrOpcode opcode, const DataType& type, FieldType field) const
+{
+	return { opcode, IR_NO_VALUE, type, field, 0, 0, IR_NO_REGION, {}, {}, {} };
+}
+
+
+
+
+IrVerifier::IrVerifier() :
+	_diagnostics{}
+{}
+
+bool IrVerifier::verify(const IrFunction& function)
+{
+	_diagnostics.clear();
+
+	const IrRegion& root = function.region(IR_ROOT_REGION);
+	if (root.parent != IR_NO_REGION || root.owner != IR_NO_REGION)
+		_diagnostics.report(INVALID_REGION, "region 0");
+
+	std::vector<bool> visible(function.valueCount(), false);
+	std::vector<bool> visited(function.regionCount(), false);
+	verifyRegion(function, IR_ROOT_REGION, visible, visited);
+	return _diagnostics.empty();
+}
+
+const Diagnostics& IrVerifier::diagnostics() const { return _diagnostics; }
+
+void IrVerifier::verifyRegion(const IrFunction& function, uint32_t region, std::vector<bool>& visible, std::vector<bool>& visited)
+{
+	const std::string context = "region " + std::to_string(region);
+	if (region >= function.regionCount())
+	{
+		_diagnostics.report(INVALID_REGION, context);
+		return;
+	}
+	if (visited[region])
+	{
+		_diagnostics.report(SHARED_REGION, context);
+		return;
+	}
+	visited[region] = true;
+
+	for (const uint32_t index : function.region(region).instructions)
+	{
+		if (index >= function.instructionCount() || function.instruction(index).region != region)
+		{
+			_diagnostics.report(INVALID_REGION, context);
+			continue;
+		}
+
+		verifyInstruction(function, index, visible);
+
+		const IrInstruction& instruction = function.instruction(index);
+		for (const uint32_t child : instruction.regions)
+		{
+			if (child >= function.regionCount() || function.region(child).parent != region || function.region(child).owner != index)
+			{
+				_diagnostics.report(INVALID_REGION, "region " + std::to_string(child));
+				continue;
+			}
+
+			std::vector<bool> nested = visible;
+			verifyRegion(function, child, nested, visited);
+		}
+
+		if (instruction.result < function.valueCount())
+			visible[instruction.result] = true;
+	}
+}
+
+void IrVerifier::verifyInstruction(const IrFunction& function, uint32_t index, const std::vector<bool>& visible)
+{
+	const IrInstruction& instruction = function.instruction(index);
+	const std::string context = "instruction " + std::to_string(index) + " (" + IrFunction::opcodeName(instruction.opcode) + ")";
+
+	if (IrFunction::producesValue(instruction.opcode) ?
+		instruction.result >= function.valueCount() || function.definingInstruction(instruction.result) != index :
+		instruction.result != IR_NO_VALUE)
+		_diagnostics.report(RESULT_MISMATCH, context);
+
+	if (instruction.field != expected_field(instruction.opcode))
+		_diagnostics.report(INVALID_FIELD, context);
+
+	if (instruction.regions.size() != expected_regions(instruction.opcode))
+		_diagnostics.report(INVALID_REGION, context);
+
+	if (instruction.opcode == IrOpcode::Action)
+	{
+		for (const ScriptCode code : instruction.codes)
+		{
+			if (code < TOKEN_OFFSET && code >= instruction.operands.size())
+				_diagnostics.report(INVALID_ACTION, context);
+		}
+	}
+	else if (instruction.operands.size() != expected_operands(instruction.opcode))
+	{
+		_diagnostics.report(OPERAND_COUNT, context);
+		return;
+	}
+
+	for (const IrValue operand : instruction.operands)
+	{
+		if (operand >= function.valueCount() || !visible[operand])
+		{
+			_diagnostics.report(UNDEFINED_VALUE, context + " " + value_name(operand));
+			return;
+		}
+	}
+
+	if ((instruction.opcode == IrOpcode::Load || instruction.opcode == IrOpcode::Store) &&
+		(instruction.immediate < 0 || static_cast<uint32_t>(instruction.immediate) >= function.variableCount()))
+		_diagnostics.report(UNKNOWN_VARIABLE, context);
+
+	if (instruction.opcode == IrOpcode::Every &&
+		(instruction.immediate <= 0 || instruction.offset < 0 || instruction.offset >= instruction.immediate))
+		_diagnostics.report(INVALID_PERIOD, context);
+
+	if (IrFunction::isArithmetic(instruction.opcode) || IrFunction::isComparison(instruction.opcode) || IrFunction::isLogical(instruction.opcode))
+	{
+		const DataType& left = function.definition(instruction.operands[0]).type;
+		const DataType& right = function.definition(instruction.operands[1]).type;
+		if (instruction.type != DataType::integer() ||
+			(IrFunction::isArithmetic(instruction.opcode) && (left != DataType::integer() || right != DataType::integer())) ||
+			(IrFunction::isComparison(instruction.opcode) && !compatible_types(left, right)))
+			_diagnostics.report(TYPE_MISMATCH, context);
+	}
+}
+
+
+
+
+IrEmitter::IrEmitter(CompilerContext& context) :
+	_context{ context }
+{}
+
+Result<void> IrEmitter::emit(const IrFunction& function, ScriptCodeBuilder& output) const
+{
+	PROFILE_SCOPE("IrEmitter::emit");
+	return IrLowering{ _context, function, output }.region(IR_ROOT_REGION);
+}
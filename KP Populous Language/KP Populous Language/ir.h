@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "script.h"
+#include "datatypes.h"
+#include "parser_elements.h"
+#include "compiler_context.h"
+#include "result.h"
+
+typedef uint32_t IrValue;
+
+#define IR_NO_VALUE 0xFFFFFFFFU
+#define IR_NO_REGION 0xFFFFFFFFU
+#define IR_ROOT_REGION 0U
+
+enum class IrOpcode : uint8_t
+{
+	Constant,
+	Internal,
+	Load,
+	Store,
+	Add,
+	Subtract,
+	Multiply,
+	Divide,
+	GreaterThan,
+	LessThan,
+	GreaterThanEqualTo,
+	LessThanEqualTo,
+	EqualTo,
+	NotEqualTo,
+	And,
+	Or,
+	Action,
+	If,
+	Every
+};
+
+struct IrInstruction
+{
+	IrOpcode opcode;
+	IrValue result;
+	DataType type;
+	FieldType field;
+	field_value_t immediate;
+	field_value_t offset;
+	uint32_t region;
+	std::vector<IrValue> operands;
+	std::vector<ScriptCode> codes;
+	std::vector<uint32_t> regions;
+};
+
+struct IrRegion
+{
+	uint32_t parent;
+	uint32_t owner;
+	std::vector<uint32_t> instructions;
+};
+
+class IrFunction
+{
+private:
+	std::vector<IrInstruction> _instructions;
+	std::vector<IrRegion> _regions;
+	std::vector<uint32_t> _values;
+	std::vector<std::string> _variables;
+
+public:
+	IrFunction();
+
+	uint32_t instructionCount() const;
+	uint32_t regionCount() const;
+	uint32_t valueCount() const;
+	uint32_t variableCount() const;
+
+	IrInstruction& instruction(uint32_t index);
+	const IrInstruction& instruction(uint32_t index) const;
+
+	IrRegion& region(uint32_t index);
+	const IrRegion& region(uint32_t index) const;
+
+	uint32_t definingInstruction(IrValue value) const;
+	const IrInstruction& definition(IrValue value) const;
+
+	field_value_t variable(const std::string& name);
+	const std::string& variableName(field_value_t slot) const;
+
+	uint32_t append(uint32_t region, const IrInstruction& instruction);
+	uint32_t addRegion(uint32_t parent, uint32_t owner);
+
+	void remove(uint32_t index);
+	void inlineRegion(uint32_t index, uint32_t region);
+	void replaceUses(IrValue from, IrValue to);
+	uint32_t uses(IrValue value) const;
+
+	size_t hash() const;
+
+	std::string toString() const;
+
+private:
+	void print(std::ostream& output, uint32_t region, unsigned int depth) const;
+
+public:
+	static bool producesValue(IrOpcode opcode);
+	static bool isComparison(IrOpcode opcode);
+	static bool isArithmetic(IrOpcode opcode);
+	static bool isLogical(IrOpcode opcode);
+
+	static const char* opcodeName(IrOpcode opcode);
+};
+
+class IrBuilder
+{
+private:
+	IrFunction& _function;
+	uint32_t _region;
+
+public:
+	IrBuilder(IrFunction& function);
+
+	IrFunction& function();
+
+	uint32_t region() const;
+	void setRegion(uint32_t region);
+
+	IrValue constant(field_value_t value, const DataType& type = DataType::integer());
+	IrValue internal(ScriptCode code, const DataType& type = DataType::integer());
+	IrValue load(const std::string& variable);
+
+	void store(const std::string& variable, IrValue value);
+
+	IrValue binary(IrOpcode opcode, IrValue left, IrValue right);
+
+	void action(const std::vector<ScriptCode>& codes, const std::vector<IrValue>& operands);
+
+	uint32_t beginIf(IrValue condition);
+	void beginElse(uint32_t ifInstruction);
+	void endIf(uint32_t ifInstruction);
+
+	uint32_t beginEvery(field_value_t period, field_value_t offset = 0);
+	void endEvery(uint32_t everyInstruction);
+
+	Result<IrValue> expression(const Statement& statement);
+	Result<void> statement(const Statement& statement);
+
+private:
+	IrInstruction make(IrOpcode opcode, const DataType& type = DataType::integer(), FieldType field = FieldType::Invalid) const;
+};
+
+class IrVerifier
+{
+private:
+	Diagnostics _diagnostics;
+
+public:
+	IrVerifier();
+
+	bool verify(const IrFunction& function);
+
+	const Diagnostics& diagnostics() const;
+
+private:
+	void verifyRegion(const IrFunction& function, uint32_t region, std::vector<bool>& visible, std::vector<bool>& visited);
+	void verifyInstruction(const IrFunction& function, uint32_t index, const std::vector<bool>& visible);
+};
+
+class IrEmitter
+{
+private:
+	CompilerContext& _context;
+
+public:
+	IrEmitter(CompilerContext& context);
+
+	Result<void> emit(const IrFunction& function, ScriptCodeBuilder& output) const;
+};
@@ -0,0 +1,214 @@
+#include "ir_passes.h"
+
+#include <iomanip>
+#include <limits>
+
+#include "profiler.h"
+
+namespace
+{
+	const Error INVALID_PASS_OUTPUT{ ErrorCode::InvalidIrInstruction, "IR pass produced an invalid function" };
+
+	bool fold(IrOpcode opcode, int64_t left, int64_t right, int64_t& value)
+	{
+		switch (opcode)
+		{
+			case IrOpcode::Add: value = left + right; break;
+			case IrOpcode::Subtract: value = left - right; break;
+			case IrOpcode::Multiply: value = left * right; break;
+			case IrOpcode::Divide:
+				if (right == 0)
+					return false;
+				value = left / right;
+				break;
+			case IrOpcode::GreaterThan: value = left > right; break;
+			case IrOpcode::LessThan: value = left < right; break;
+			case IrOpcode::GreaterThanEqualTo: value = left >= right; break;
+			case IrOpcode::LessThanEqualTo: value = left <= right; break;
+			case IrOpcode::EqualTo: value = left == right; break;
+			case IrOpcode::NotEqualTo: value = left != right; break;
+			case IrOpcode::And: value = left != 0 && right != 0; break;
+			case IrOpcode::Or: value = left != 0 || right != 0; break;
+			default: return false;
+		}
+		return value >= std::numeric_limits<field_value_t>::min() && value <= std::numeric_limits<field_value_t>::max();
+	}
+
+	bool is_constant(const IrFunction& function, IrValue value)
+	{
+		return function.definition(value).opcode == IrOpcode::Constant;
+	}
+}
+
+IrPass::~IrPass() {}
+
+
+
+
+IrPassManager::IrPassManager(bool verify, size_t cacheLimit) :
+	_passes{},
+	_timings{},
+	_cache{},
+	_cacheLimit{ cacheLimit },
+	_verify{ verify },
+	_diagnostics{}
+{}
+
+size_t IrPassManager::size() const { return _passes.size(); }
+
+Result<bool> IrPassManager::run(IrFunction& function)
+{
+	PROFILE_SCOPE("IrPassManager::run");
+	_diagnostics.clear();
+
+	bool changed = false;
+	size_t hash = _cacheLimit > 0 ? function.hash() : 0;
+	for (size_t i = 0; i < _passes.size(); ++i)
+	{
+		IrPassTiming& timing = _timings[i];
+		const uint64_t start = Profiler::now();
+
+		const std::pair<size_t, size_t> key{ i, hash };
+		bool passChanged = false;
+
+		std::string input{};
+		const auto it = _cacheLimit > 0 ? _cache.find(key) : _cache.end();
+		if (it != _cache.end() && (input = function.toString()) == it->second.input)
+		{
+			passChanged = it->second.changed;
+			if (passChanged)
+				function = it->second.output;
+			++timing.cacheHits;
+		}
+		else if (_cacheLimit > 0)
+		{
+			if (it == _cache.end())
+				input = function.toString();
+			passChanged = _passes[i]->run(function);
+			if (it == _cache.end() && _cache.size() >= _cacheLimit)
+				_cache.clear();
+
+			CacheEntry& entry = _cache[key];
+			entry.input = std::move(input);
+			entry.output = passChanged ? function : IrFunction{};
+			entry.changed = passChanged;
+		}
+		else passChanged = _passes[i]->run(function);
+
+		if (passChanged && _cacheLimit > 0)
+			hash = function.hash();
+
+		const uint64_t end = Profiler::now();
+		++timing.runs;
+		timing.changes += passChanged ? 1 : 0;
+		timing.elapsed += end - start;
+		if (Profiler::isEnabled())
+			Profiler::record(timing.name, start, end);
+
+		if (passChanged && _verify)
+		{
+			IrVerifier verifier{};
+			if (!verifier.verify(function))
+			{
+				_diagnostics = verifier.diagnostics();
+				_diagnostics.report(INVALID_PASS_OUTPUT, timing.name);
+				return INVALID_PASS_OUTPUT;
+			}
+		}
+		changed = changed || passChanged;
+	}
+	return changed;
+}
+
+const std::vector<IrPassTiming>& IrPassManager::timings() const { return _timings; }
+const Diagnostics& IrPassManager::diagnostics() const { return _diagnostics; }
+
+size_t IrPassManager::cacheSize() const { return _cache.size(); }
+void IrPassManager::clearCache() { _cache.clear(); }
+
+void IrPassManager::printTimings(std::ostream& output) const
+{
+	output << std::left << std::setw(32) << "pass" << std::right << std::setw(8) << "runs" << std::setw(8) << "cached"
+		<< std::setw(9) << "changed" << std::setw(14) << "total (us)" << std::endl;
+	for (const IrPassTiming& timing : _timings)
+	{
+		output << std::left << std::setw(32) << timing.name << std::right << std::setw(8) << timing.runs << std::setw(8) << timing.cacheHits
+			<< std::setw(9) << timing.changes << std::setw(14) << timing.elapsed << std::endl;
+	}
+}
+
+
+
+
+const char* IrConstantFolding::name() const { return "IrConstantFolding"; }
+
+bool IrConstantFolding::run(IrFunction& function)
+{
+	PROFILE_SCOPE("IrConstantFolding::run");
+
+	bool changed = false;
+	for (uint32_t i = 0; i < function.instructionCount(); ++i)
+	{
+		IrInstruction& instruction = function.instruction(i);
+		if (instruction.region == IR_NO_REGION)
+			continue;
+
+		if (instruction.opcode == IrOpcode::If && is_constant(function, instruction.operands[0]))
+		{
+			const bool taken = function.definition(instruction.operands[0]).immediate != 0;
+			function.inlineRegion(i, instruction.regions[taken ? 0 : 1]);
+			changed = true;
+			continue;
+		}
+
+		if (instruction.operands.size() != 2 || !IrFunction::producesValue(instruction.opcode) ||
+			!is_constant(function, instruction.operands[0]) || !is_constant(function, instruction.operands[1]))
+			continue;
+
+		int64_t value = 0;
+		if (!fold(instruction.opcode, function.definition(instruction.operands[0]).immediate,
+			function.definition(instruction.operands[1]).immediate, value))
+			continue;
+
+		instruction.opcode = IrOpcode::Constant;
+		instruction.field = FieldType::Constant;
+		instruction.immediate = static_cast<field_value_t>(value);
+		instruction.operands.clear();
+		changed = true;
+	}
+	return changed;
+}
+
+
+
+
+const char* IrDeadValueElimination::name() const { return "IrDeadValueElimination"; }
+
+bool IrDeadValueElimination::run(IrFunction& function)
+{
+	PROFILE_SCOPE("IrDeadValueElimination::run");
+
+	std::vector<uint32_t> uses(function.valueCount(), 0);
+	for (uint32_t i = 0; i < function.instructionCount(); ++i)
+	{
+		if (function.instruction(i).region != IR_NO_REGION)
+		{
+			for (const IrValue operand : function.instruction(i).operands)
+				++uses[operand];
+		}
+	}
+
+	bool changed = false;
+	for (uint32_t i = function.instructionCount(); i-- > 0;)
+	{
+		const IrInstruction& instruction = function.instruction(i);
+		if (instruction.region == IR_NO_REGION || instruction.result == IR_NO_VALUE || uses[instruction.result] > 0)
+			continue;
+
+		for (const IrValue operand : instruction.operands)
+			--uses[operand];
+		function.remove(i);
+		changed = true;
+	}
+	return changed;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <utility>
+#include <ostream>
+
+#include "ir.h"
+#include "result.h"
+
+class IrPass
+{
+public:
+	virtual ~IrPass();
+
+	virtual const char* name() const = 0;
+
+	virtual bool run(IrFunction& function) = 0;
+};
+
+struct IrPassTiming
+{
+	const char* name;
+	uint32_t runs;
+	uint32_t cacheHits;
+	uint32_t changes;
+	uint64_t elapsed;
+};
+
+class IrPassManager
+{
+private:
+	struct CacheEntry
+	{
+		std::string input;
+		IrFunction output;
+		bool changed;
+	};
+
+	std::vector<std::unique_ptr<IrPass>> _passes;
+	std::vector<IrPassTiming> _timings;
+	std::map<std::pair<size_t, size_t>, CacheEntry> _cache;
+	size_t _cacheLimit;
+	bool _verify;
+	Diagnostics _diagnostics;
+
+public:
+	IrPassManager(bool verify = true, size_t cacheLimit = 256);
+
+	template<class _PassTy, class... _ArgsTy>
+	_PassTy& add(_ArgsTy&&... args)
+	{
+		_PassTy* const pass = new _PassTy{ std::forward<_ArgsTy>(args)... };
+		_passes.emplace_back(pass);
+		_timings.push_back({ pass->name(), 0, 0, 0, 0 });
+		return *pass;
+	}
+
+	size_t size() const;
+
+	Result<bool> run(IrFunction& function);
+
+	const std::vector<IrPassTiming>& timings() const;
+	const Diagnostics& diagnostics() const;
+
+	size_t cacheSize() const;
+	void clearCache();
+
+	void printTimings(std::ostream& output) const;
+};
+
+class IrConstantFolding : public IrPass
+{
+public:
+	const char* name() const override;
+
+	bool run(IrFunction& function) override;
+};
+
+class IrDeadValueElimination : public IrPass
+{
+public:
+	const char* name() const override;
+
+	bool run(IrFunction& function) override;
+};
@@ -1,10 +1,80 @@
+#include <iostream>
+#include <cstring>
+
 #include "script.h"
 #include "parser_elements.h"
 #include "datatypes.h"
+#include "server.h"
+#include "profiler.h"
+#include "superoptimizer.h"
 
 
 int main(int argc, char** argv)
 {
+	bool server = false;
+	bool stats = false;
+	const char* traceFile = nullptr;
+	const char* rewriteTableFile = nullptr;
+	const char* applyTableFile = nullptr;
+	const char* applyScriptFile = nullptr;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--server") == 0)
+			server = true;
+		else if (std::strcmp(argv[i], "--stats") == 0)
+			stats = true;
+		else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			traceFile = argv[++i];
+		else if (std::strcmp(argv[i], "--superoptimize") == 0 && i + 1 < argc)
+			rewriteTableFile = argv[++i];
+		else if (std::strcmp(argv[i], "--apply-rewrites") == 0 && i + 2 < argc)
+		{
+			applyTableFile = argv[++i];
+			applyScriptFile = argv[++i];
+		}
+	}
+
+	Profiler::setEnabled(stats || traceFile);
+
+	if (rewriteTableFile)
+	{
+		Superoptimizer superoptimizer{};
+		const RewriteTable table = superoptimizer.build();
+		if (!table.writeToFile(rewriteTableFile))
+			std::cerr << "Cannot write rewrite table " << rewriteTableFile << std::endl;
+		else std::cerr << table.size() << " rewrites from " << superoptimizer.validCandidates() << " of "
+			<< superoptimizer.candidates() << " candidate sequences" << std::endl;
+	}
+
+	if (applyTableFile)
+	{
+		RewriteTable table{};
+		Script script{};
+		if (!table.readFromFile(applyTableFile))
+			std::cerr << "Cannot read rewrite table " << applyTableFile << std::endl;
+		else if (!script.readFromFile(applyScriptFile))
+			std::cerr << "Cannot read script " << applyScriptFile << std::endl;
+		else
+		{
+			const OptimizationStats rewrites = table.apply(script);
+			if (rewrites.rewrites)
+				script.writeToFile(applyScriptFile);
+			std::cerr << rewrites.rewrites << " rewrites, " << rewrites.codesSaved << " codes and "
+				<< rewrites.fieldsSaved << " fields saved" << std::endl;
+		}
+	}
+
+	if (server)
+	{
+		CompileServer server{};
+		server.run(std::cin, std::cout);
+	}
+
+	if (traceFile && !Profiler::writeTraceToFile(traceFile))
+		std::cerr << "Cannot write trace file " << traceFile << std::endl;
+	if (stats)
+		std::cerr << Profiler::stats();
 
 	return 0;
 }
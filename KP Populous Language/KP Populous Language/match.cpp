@@ -0,0 +1,253 @@
+#include "match.h"
+
+#include <algorithm>
+
+namespace
+{
+	const Error DUPLICATE_CASE{ ErrorCode::DuplicateMatchCase, "Duplicate match case" };
+	const Error INVALID_CASE{ ErrorCode::InvalidMatchCase, "Match case is not a value of the matched type" };
+	const Error NON_EXHAUSTIVE{ ErrorCode::NonExhaustiveMatch, "Match does not cover every value of its type" };
+
+	class MatchLowering
+	{
+	private:
+		CompilerContext& _context;
+		const uint16_t _subject;
+		const std::vector<MatchRange>& _ranges;
+		const std::vector<std::vector<ScriptCode>>& _bodies;
+		const std::vector<field_value_t>& _domain;
+		const std::vector<ScriptCode>* _default;
+		ScriptCodeBuilder& _out;
+
+	public:
+		MatchLowering(CompilerContext& context, uint16_t subject, const std::vector<MatchRange>& ranges,
+			const std::vector<std::vector<ScriptCode>>& bodies, const std::vector<field_value_t>& domain,
+			const std::vector<ScriptCode>* defaultBody, ScriptCodeBuilder& out) :
+			_context{ context },
+			_subject{ subject },
+			_ranges{ ranges },
+			_bodies{ bodies },
+			_domain{ domain },
+			_default{ defaultBody },
+			_out{ out }
+		{}
+
+		Result<void> lower(size_t first, size_t last, int64_t min, int64_t max)
+		{
+			if (first == last)
+				return _default ? emit(*_default) : Result<void>{};
+
+			if (last - first == 1)
+				return leaf(_ranges[first], min, max);
+
+			const size_t middle = first + (last - first) / 2;
+			const field_value_t pivot = _ranges[middle].min;
+
+			Result<void> result{};
+			if (!(result = open(InstructionToken::LessThan, pivot)) ||
+				!(result = then()) ||
+				!(result = lower(first, middle, min, static_cast<int64_t>(pivot) - 1)) ||
+				!(result = orElse()) ||
+				!(result = lower(middle, last, pivot, max)))
+				return result;
+			return close();
+		}
+
+	private:
+		Result<void> leaf(const MatchRange& range, int64_t min, int64_t max)
+		{
+			const bool checkMin = !covered(min, range.min - static_cast<int64_t>(1));
+			const bool checkMax = !covered(range.max + static_cast<int64_t>(1), max);
+			if (!checkMin && !checkMax)
+				return emit(_bodies[range.body]);
+
+			Result<void> result{};
+			if (range.min == range.max)
+				result = open(InstructionToken::Equalto, range.min);
+			else if (checkMin && checkMax)
+			{
+				if ((result = open(InstructionToken::GreaterThanEqualTo, range.min)))
+					result = comparison(InstructionToken::And, InstructionToken::LessThanEqualTo, range.max);
+			}
+			else result = checkMin ? open(InstructionToken::GreaterThanEqualTo, range.min) : open(InstructionToken::LessThanEqualTo, range.max);
+
+			if (!result || !(result = then()) || !(result = emit(_bodies[range.body])))
+				return result;
+			if (_default && (!(result = orElse()) || !(result = emit(*_default))))
+				return result;
+			return close();
+		}
+
+		bool covered(int64_t min, int64_t max) const
+		{
+			if (min > max)
+				return true;
+			if (_domain.empty())
+				return false;
+			const auto it = std::lower_bound(_domain.begin(), _domain.end(), min);
+			return it == _domain.end() || *it > max;
+		}
+
+		Result<void> push(ScriptCode code)
+		{
+			const Result<CodeLocation> result = _out.try_push_back(code);
+			return result ? Result<void>{} : Result<void>{ result.error() };
+		}
+
+		Result<void> open(ScriptCode op, field_value_t value)
+		{
+			Result<void> result = push(InstructionToken::If);
+			return result ? comparison(InstructionToken::ScriptEnd, op, value) : result;
+		}
+
+		Result<void> then() { return push(InstructionToken::Begin); }
+
+		Result<void> comparison(ScriptCode logical, ScriptCode op, field_value_t value)
+		{
+			const Result<uint16_t> field = _context.tryConstantField(value);
+			if (!field)
+				return field.error();
+
+			Result<void> result{};
+			if (logical != InstructionToken::ScriptEnd && !(result = push(logical)))
+				return result;
+			if (!(result = push(_subject)) || !(result = push(op)))
+				return result;
+			return push(field.value());
+		}
+
+		Result<void> orElse()
+		{
+			Result<void> result = push(InstructionToken::End);
+			if (result && (result = push(InstructionToken::Else)))
+				result = push(InstructionToken::Begin);
+			return result;
+		}
+
+		Result<void> close()
+		{
+			Result<void> result = push(InstructionToken::End);
+			return result ? push(InstructionToken::Endif) : result;
+		}
+
+		Result<void> emit(const std::vector<ScriptCode>& body)
+		{
+			for (const ScriptCode code : body)
+			{
+				const Result<void> result = push(code);
+				if (!result)
+					return result;
+			}
+			return {};
+		}
+	};
+}
+
+Match::Match(const DataType& type) :
+	_type{ type },
+	_cases{},
+	_bodies{ 1 },
+	_hasDefault{ false }
+{}
+
+const DataType& Match::type() const { return _type; }
+
+Result<void> Match::addCase(field_value_t value, const std::vector<ScriptCode>& body)
+{
+	return addCases({ value }, body);
+}
+
+Result<void> Match::addCase(const std::string& identifier, const std::vector<ScriptCode>& body)
+{
+	if (!_type.isValidIdentifier(identifier))
+		return INVALID_CASE;
+	return addCases({ _type.getIdentifierValue(identifier) }, body);
+}
+
+Result<void> Match::addCases(const std::vector<field_value_t>& values, const std::vector<ScriptCode>& body)
+{
+	const bool integer = _type == DataType::integer();
+	for (size_t i = 0; i < values.size(); ++i)
+	{
+		if (!integer && (values[i] < 0 || !_type.isValidValue(static_cast<ScriptCode>(values[i]))))
+			return INVALID_CASE;
+		if (_cases.find(values[i]) != _cases.end() || std::find(values.begin(), values.begin() + i, values[i]) != values.begin() + i)
+			return DUPLICATE_CASE;
+	}
+
+	const size_t index = _bodies.size();
+	_bodies.push_back(body);
+	for (const field_value_t value : values)
+		_cases[value] = index;
+	return {};
+}
+
+void Match::setDefault(const std::vector<ScriptCode>& body)
+{
+	_bodies.front() = body;
+	_hasDefault = true;
+}
+
+bool Match::hasDefault() const { return _hasDefault; }
+
+size_t Match::size() const { return _cases.size(); }
+
+bool Match::isExhaustive() const { return _hasDefault || (_type != DataType::integer() && missingCases().empty()); }
+
+std::vector<std::string> Match::missingCases() const
+{
+	std::vector<std::string> missing{};
+	if (_type == DataType::integer())
+		return missing;
+
+	for (const std::string& name : _type.availableValues())
+		if (_cases.find(_type.getIdentifierValue(name)) == _cases.end())
+			missing.push_back(name);
+	return missing;
+}
+
+std::vector<MatchRange> Match::ranges() const
+{
+	const std::vector<field_value_t> values = domain();
+	std::vector<MatchRange> ranges{};
+	for (const auto& entry : _cases)
+	{
+		if (!ranges.empty() && ranges.back().body == entry.second)
+		{
+			const field_value_t last = ranges.back().max;
+			const bool adjacent = values.empty()
+				? static_cast<int64_t>(last) + 1 == entry.first
+				: std::upper_bound(values.begin(), values.end(), last) == std::lower_bound(values.begin(), values.end(), entry.first);
+			if (adjacent)
+			{
+				ranges.back().max = entry.first;
+				continue;
+			}
+		}
+		ranges.push_back({ entry.first, entry.first, entry.second });
+	}
+	return ranges;
+}
+
+Result<void> Match::lower(CompilerContext& context, uint16_t subject, ScriptCodeBuilder& out) const
+{
+	if (_type != DataType::integer() && !isExhaustive())
+		return NON_EXHAUSTIVE;
+
+	const std::vector<field_value_t> values = domain();
+	const std::vector<MatchRange> cases = ranges();
+	MatchLowering lowering{ context, subject, cases, _bodies, values, _hasDefault ? &_bodies.front() : nullptr, out };
+	return lowering.lower(0, cases.size(), INT32_MIN, INT32_MAX);
+}
+
+std::vector<field_value_t> Match::domain() const
+{
+	std::vector<field_value_t> values{};
+	if (_type == DataType::integer())
+		return values;
+
+	for (const std::string& name : _type.availableValues())
+		values.push_back(_type.getIdentifierValue(name));
+	std::sort(values.begin(), values.end());
+	return values;
+}
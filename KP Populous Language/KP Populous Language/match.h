@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "script.h"
+#include "datatypes.h"
+#include "result.h"
+#include "compiler_context.h"
+
+struct MatchRange
+{
+	field_value_t min;
+	field_value_t max;
+	size_t body;
+};
+
+class Match
+{
+private:
+	DataType _type;
+	std::map<field_value_t, size_t> _cases;
+	std::vector<std::vector<ScriptCode>> _bodies;
+	bool _hasDefault;
+
+public:
+	Match(const DataType& type);
+
+	const DataType& type() const;
+
+	Result<void> addCase(field_value_t value, const std::vector<ScriptCode>& body);
+	Result<void> addCase(const std::string& identifier, const std::vector<ScriptCode>& body);
+	Result<void> addCases(const std::vector<field_value_t>& values, const std::vector<ScriptCode>& body);
+
+	void setDefault(const std::vector<ScriptCode>& body);
+	bool hasDefault() const;
+
+	size_t size() const;
+
+	bool isExhaustive() const;
+	std::vector<std::string> missingCases() const;
+
+	std::vector<MatchRange> ranges() const;
+
+	Result<void> lower(CompilerContext& context, uint16_t subject, ScriptCodeBuilder& out) const;
+
+private:
+	std::vector<field_value_t> domain() const;
+};
@@ -0,0 +1,1366 @@
+#include "optimizer.h"
+
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <iomanip>
+
+#include "value_range.h"
+#include "profiler.h"
+
+namespace
+{
+	const ScriptCode NO_OPERATOR = 0;
+
+	enum class Truth : uint8_t
+	{
+		False,
+		True,
+		Unknown
+	};
+
+	Truth truth_of(const ValueRange& value)
+	{
+		return value.alwaysTrue() ? Truth::True : value.alwaysFalse() ? Truth::False : Truth::Unknown;
+	}
+
+	bool is_logical(ScriptCode code) { return code == InstructionToken::And || code == InstructionToken::Or; }
+	bool is_comparison(ScriptCode code) { return code >= InstructionToken::GreaterThan && code <= InstructionToken::LessThanEqualTo; }
+	bool is_attribute(ScriptCode internal) { return internal >= AttributeInternal::Expansion && internal <= AttributeInternal::Spare6_; }
+
+	ValueRange logical(const ValueRange& left, bool isAnd, const ValueRange& right)
+	{
+		const Truth a = truth_of(left), b = truth_of(right);
+		if (isAnd)
+		{
+			if (a == Truth::False || b == Truth::False)
+				return ValueRange::constant(0);
+			return a == Truth::True && b == Truth::True ? ValueRange::constant(1) : ValueRange::boolean();
+		}
+		if (a == Truth::True || b == Truth::True)
+			return ValueRange::constant(1);
+		return a == Truth::False && b == Truth::False ? ValueRange::constant(0) : ValueRange::boolean();
+	}
+
+
+	double code_cost(const Script& script, ScriptCode code)
+	{
+		if (code < MAX_FIELDS)
+		{
+			const ScriptField& field = script.fieldData[code];
+			if (field.isInternal())
+				return is_attribute(static_cast<ScriptCode>(field.index)) ? 3 : 4;
+			return field.isUser() ? 2 : 1;
+		}
+
+		switch (code)
+		{
+			case InstructionToken::Multiply:
+			case InstructionToken::Divide:
+				return 2;
+
+			case InstructionToken::ExpStart:
+			case InstructionToken::ExpEnd:
+				return 0;
+
+			default:
+				return 1;
+		}
+	}
+
+	double selectivity(const ValueRange& left, ScriptCode op, const ValueRange& right)
+	{
+		const Truth truth = truth_of(ValueRange::compare(left, op, right));
+		if (truth != Truth::Unknown)
+			return truth == Truth::True ? 1 : 0;
+
+		if (right.isConstant() && left != ValueRange::full())
+		{
+			const ValueRange taken = ValueRange::narrow(left, op, right);
+			const double size = static_cast<double>(left.max - left.min + 1);
+			const double count = taken.empty() ? 0 : static_cast<double>(taken.max - taken.min + 1);
+			return op == InstructionToken::NotEqualTo ? (size - 1) / size : count / size;
+		}
+
+		switch (op)
+		{
+			case InstructionToken::Equalto: return 0.1;
+			case InstructionToken::NotEqualTo: return 0.9;
+			default: return 0.5;
+		}
+	}
+
+
+	class RangeEnvironment
+	{
+	private:
+		bool _enabled;
+		std::map<uint64_t, ValueRange> _ranges;
+
+	public:
+		RangeEnvironment(bool enabled) :
+			_enabled{ enabled },
+			_ranges{}
+		{}
+
+		ValueRange get(const ScriptField& field) const
+		{
+			if (field.isConstant())
+				return ValueRange::constant(field.value);
+			if (!_enabled)
+				return ValueRange::full();
+
+			const auto& it = _ranges.find(key(field));
+			return it != _ranges.end() ? it->second : initial(key(field));
+		}
+
+		void set(const ScriptField& field, const ValueRange& range)
+		{
+			if (_enabled && (field.isInternal() || field.isUser()) && !field.isVolatile())
+				_ranges[key(field)] = range;
+		}
+
+		void forget(const ScriptField& field) { _ranges.erase(key(field)); }
+
+		void forgetInternals()
+		{
+			for (auto it = _ranges.begin(); it != _ranges.end();)
+			{
+				if ((it->first >> 32) == FieldType::Internal)
+					it = _ranges.erase(it);
+				else ++it;
+			}
+		}
+
+		void clear() { _ranges.clear(); }
+
+		void join(const RangeEnvironment& other)
+		{
+			std::map<uint64_t, ValueRange> joined{};
+			for (const auto& entry : _ranges)
+				joined[entry.first] = entry.second.join(other.lookup(entry.first));
+			for (const auto& entry : other._ranges)
+				joined[entry.first] = entry.second.join(lookup(entry.first));
+			_ranges = std::move(joined);
+		}
+
+	private:
+		ValueRange lookup(uint64_t key) const
+		{
+			const auto& it = _ranges.find(key);
+			return it != _ranges.end() ? it->second : initial(key);
+		}
+
+		static uint64_t key(const ScriptField& field) { return (static_cast<uint64_t>(field.type) << 32) | static_cast<uint32_t>(field.index); }
+
+		static ValueRange initial(uint64_t key)
+		{
+			if ((key >> 32) == FieldType::Internal)
+				return ValueRange::ofInternal(static_cast<ScriptCode>(key & 0xffffffff));
+			return ValueRange::full();
+		}
+	};
+
+
+	struct ConditionTerm
+	{
+		ScriptCode op;
+		uint16_t begin;
+		uint16_t end;
+		ValueRange value;
+		ScriptCode comparison;
+		uint16_t left;
+		uint16_t right;
+		ValueRange leftValue;
+		ValueRange rightValue;
+		double cost;
+		double selectivity;
+	};
+
+	struct Condition
+	{
+		std::vector<ConditionTerm> terms;
+		uint16_t end;
+
+		std::vector<size_t> kept;
+		ValueRange value;
+
+		size_t run;
+		ScriptCode runOp;
+
+		bool isChain(ScriptCode op) const
+		{
+			for (size_t i = 1; i < kept.size(); ++i)
+				if (terms[kept[i]].op != op)
+					return false;
+			return true;
+		}
+
+		double expectedCost() const
+		{
+			double cost = 0;
+			double reach = 1;
+			for (size_t i = 0; i < kept.size(); ++i)
+			{
+				const ConditionTerm& term = terms[kept[i]];
+				const ScriptCode op = i + 1 < kept.size() ? operatorAt(i + 1) : NO_OPERATOR;
+				cost += reach * term.cost;
+				if (op == InstructionToken::And)
+					reach *= term.selectivity;
+				else if (op == InstructionToken::Or)
+					reach *= 1 - term.selectivity;
+			}
+			return cost;
+		}
+
+		ScriptCode operatorAt(size_t idx) const { return idx < run ? runOp : terms[kept[idx]].op; }
+	};
+
+	class ConditionParser
+	{
+	private:
+		const Script& _script;
+		const RangeEnvironment& _env;
+		uint16_t _pos;
+		const uint16_t _end;
+		bool _failed;
+
+	public:
+		ConditionParser(const Script& script, const RangeEnvironment& env, uint16_t begin, uint16_t end) :
+			_script{ script },
+			_env{ env },
+			_pos{ begin },
+			_end{ end },
+			_failed{ false }
+		{}
+
+		bool parse(Condition& condition)
+		{
+			ScriptCode op = NO_OPERATOR;
+			for (;;)
+			{
+				ConditionTerm term{ op, _pos, _pos, ValueRange::boolean(), NO_OPERATOR, MAX_FIELDS, MAX_FIELDS, ValueRange::full(), ValueRange::full(), 0, 0.5 };
+				comparison(term);
+				term.end = _pos;
+				for (uint16_t pos = term.begin; pos < term.end; ++pos)
+					term.cost += code_cost(_script, _script.codeData[pos]);
+				if (term.comparison)
+					term.selectivity = selectivity(term.leftValue, term.comparison, term.rightValue);
+				else if (truth_of(term.value) != Truth::Unknown)
+					term.selectivity = term.value.alwaysTrue() ? 1 : 0;
+				condition.terms.push_back(term);
+				if (_failed || !is_logical(peek()))
+					break;
+				op = _script.codeData[_pos++];
+			}
+			condition.end = _pos;
+			return !_failed && _pos > condition.terms.front().begin;
+		}
+
+	private:
+		ScriptCode peek() const { return _pos < _end ? _script.codeData[_pos] : static_cast<ScriptCode>(InstructionToken::ScriptEnd); }
+
+		ValueRange expression()
+		{
+			ConditionTerm term{};
+			ValueRange value = comparison(term);
+			while (!_failed && is_logical(peek()))
+			{
+				const bool isAnd = _script.codeData[_pos++] == InstructionToken::And;
+				value = logical(value, isAnd, comparison(term));
+			}
+			return value;
+		}
+
+		ValueRange comparison(ConditionTerm& term)
+		{
+			const uint16_t leftBegin = _pos;
+			term.leftValue = product();
+			term.left = _pos == leftBegin + 1 ? _script.codeData[leftBegin] : MAX_FIELDS;
+			if (_failed || !is_comparison(peek()))
+				return term.value = term.leftValue;
+
+			term.comparison = _script.codeData[_pos++];
+			const uint16_t rightBegin = _pos;
+			term.rightValue = product();
+			term.right = _pos == rightBegin + 1 ? _script.codeData[rightBegin] : MAX_FIELDS;
+			return term.value = ValueRange::compare(term.leftValue, term.comparison, term.rightValue);
+		}
+
+		ValueRange product()
+		{
+			ValueRange value = factor();
+			while (!_failed && (peek() == InstructionToken::Multiply || peek() == InstructionToken::Divide))
+			{
+				const bool isMultiply = _script.codeData[_pos++] == InstructionToken::Multiply;
+				const ValueRange right = factor();
+				value = isMultiply ? value * right : value / right;
+			}
+			return value;
+		}
+
+		ValueRange factor()
+		{
+			const ScriptCode code = peek();
+			if (code == InstructionToken::ExpStart)
+			{
+				++_pos;
+				const ValueRange value = expression();
+				if (peek() != InstructionToken::ExpEnd)
+					_failed = true;
+				++_pos;
+				return value;
+			}
+
+			if (code >= MAX_FIELDS || _script.fieldData[code].isInvalid())
+			{
+				_failed = true;
+				return ValueRange::full();
+			}
+			++_pos;
+			return _env.get(_script.fieldData[code]);
+		}
+	};
+
+
+	struct RewriteOptions
+	{
+		bool ranges;
+		bool schedule;
+		std::vector<ConditionCost>* costs;
+	};
+
+	class ConditionRewriter
+	{
+	private:
+		const Script& _script;
+		const RewriteOptions& _options;
+		uint32_t _rewrites;
+
+	public:
+		ConditionRewriter(const Script& script, const RewriteOptions& options) :
+			_script{ script },
+			_options{ options },
+			_rewrites{ 0 }
+		{}
+
+		uint32_t rewrites() const { return _rewrites; }
+
+		void rewrite(uint16_t begin, uint16_t end, RangeEnvironment& env, std::vector<ScriptCode>& out)
+		{
+			std::vector<FallbackBlock> blocks{};
+			bool operands = false;
+			for (uint16_t pos = begin; pos < end;)
+			{
+				const ScriptCode code = _script.codeData[pos];
+				uint16_t next = pos;
+				if (code < TOKEN_OFFSET)
+				{
+					if (operands && code < MAX_FIELDS && _script.fieldData[code].isUser())
+						env.forget(_script.fieldData[code]);
+					out.push_back(_script.codeData[pos++]);
+					continue;
+				}
+
+				operands = false;
+				if ((code == InstructionToken::If && rewriteIf(pos, end, next, env, out)) ||
+					(code == InstructionToken::Every && rewriteEvery(pos, end, next, env, out)) ||
+					assignment(pos, end, next, env, out))
+				{
+					pos = next;
+					continue;
+				}
+
+				if (!fallback(code, blocks, env))
+				{
+					if (code == InstructionToken::Do)
+						env.forgetInternals();
+					operands = true;
+				}
+				out.push_back(_script.codeData[pos++]);
+			}
+			if (!blocks.empty())
+				env.clear();
+		}
+
+	private:
+		struct FallbackBlock
+		{
+			ScriptCode code;
+			RangeEnvironment entry;
+			RangeEnvironment taken;
+			bool open;
+		};
+
+		static bool fallback(ScriptCode code, std::vector<FallbackBlock>& blocks, RangeEnvironment& env)
+		{
+			switch (code)
+			{
+				case InstructionToken::If:
+				case InstructionToken::Every:
+					blocks.push_back({ code, env, env, false });
+					return true;
+
+				case InstructionToken::Begin:
+					if (!blocks.empty() && blocks.back().code == InstructionToken::Every && !blocks.back().open)
+						blocks.back().open = true;
+					else blocks.push_back({ code, env, env, true });
+					return true;
+
+				case InstructionToken::Else:
+					if (blocks.empty() || blocks.back().code != InstructionToken::If || blocks.back().open)
+						break;
+					blocks.back().taken = env;
+					blocks.back().open = true;
+					env = blocks.back().entry;
+					return true;
+
+				case InstructionToken::Endif:
+				case InstructionToken::End:
+					if (blocks.empty() || (code == InstructionToken::Endif) != (blocks.back().code == InstructionToken::If))
+						break;
+					if (blocks.back().code == InstructionToken::If)
+						env.join(blocks.back().open ? blocks.back().taken : blocks.back().entry);
+					else if (blocks.back().code == InstructionToken::Every)
+						env.join(blocks.back().entry);
+					blocks.pop_back();
+					return true;
+
+				default:
+					return false;
+			}
+
+			blocks.clear();
+			env.clear();
+			return true;
+		}
+
+		bool isField(uint16_t pos, uint16_t end) const
+		{
+			return pos < end && _script.codeData[pos] < MAX_FIELDS && !_script.fieldData[_script.codeData[pos]].isInvalid();
+		}
+
+		bool assignment(uint16_t pos, uint16_t end, uint16_t& next, RangeEnvironment& env, std::vector<ScriptCode>& out) const
+		{
+			const ScriptCode code = _script.codeData[pos];
+			if ((code != InstructionToken::Set && code != InstructionToken::Increment && code != InstructionToken::Decrement) ||
+				!isField(pos + 1, end) || !isField(pos + 2, end))
+				return false;
+
+			const ScriptField& dest = _script.fieldData[_script.codeData[pos + 1]];
+			const ValueRange value = env.get(_script.fieldData[_script.codeData[pos + 2]]);
+			if (code == InstructionToken::Set)
+				env.set(dest, value);
+			else env.set(dest, code == InstructionToken::Increment ? env.get(dest) + value : env.get(dest) - value);
+
+			out.insert(out.end(), _script.codeData + pos, _script.codeData + pos + 3);
+			next = pos + 3;
+			return true;
+		}
+
+		bool findBlockEnd(uint16_t begin, uint16_t end, uint16_t& blockEnd) const
+		{
+			int depth = 1;
+			for (uint16_t pos = begin; pos < end; ++pos)
+			{
+				depth += Script::blockDelta(_script.codeData[pos]);
+				if (depth == 0)
+					return blockEnd = pos, true;
+			}
+			return false;
+		}
+
+		void simplify(Condition& condition) const
+		{
+			Truth acc = Truth::Unknown;
+			for (size_t i = 0; i < condition.terms.size(); ++i)
+			{
+				const ConditionTerm& term = condition.terms[i];
+				const Truth value = truth_of(term.value);
+				if (i == 0)
+				{
+					acc = value;
+					if (value == Truth::Unknown)
+						condition.kept.push_back(i);
+					continue;
+				}
+
+				const Truth absorbing = term.op == InstructionToken::And ? Truth::False : Truth::True;
+				const Truth neutral = term.op == InstructionToken::And ? Truth::True : Truth::False;
+				if (acc == absorbing || value == neutral)
+					continue;
+				if (value == absorbing)
+				{
+					acc = absorbing;
+					condition.kept.clear();
+				}
+				else if (acc == neutral)
+				{
+					acc = Truth::Unknown;
+					condition.kept.assign(1, i);
+				}
+				else condition.kept.push_back(i);
+			}
+
+			condition.value = acc == Truth::True ? ValueRange::constant(1) : acc == Truth::False ? ValueRange::constant(0) : ValueRange::boolean();
+		}
+
+		void narrow(const Condition& condition, bool taken, RangeEnvironment& env) const
+		{
+			if (truth_of(condition.value) != Truth::Unknown || !condition.isChain(taken ? InstructionToken::And : InstructionToken::Or))
+				return;
+
+			for (const size_t idx : condition.kept)
+			{
+				const ConditionTerm& term = condition.terms[idx];
+				if (!term.comparison)
+					continue;
+
+				const ScriptCode op = taken ? term.comparison : ValueRange::negate(term.comparison);
+				if (term.left < MAX_FIELDS)
+					env.set(_script.fieldData[term.left], ValueRange::narrow(term.leftValue, op, term.rightValue));
+				if (term.right < MAX_FIELDS)
+					env.set(_script.fieldData[term.right], ValueRange::narrow(term.rightValue, ValueRange::swap(op), term.leftValue));
+			}
+		}
+
+		bool schedule(Condition& condition) const
+		{
+			size_t run = 1;
+			while (run < condition.kept.size() && condition.terms[condition.kept[run]].op == condition.terms[condition.kept[1]].op)
+				++run;
+			if (run < 2)
+				return false;
+
+			condition.run = run;
+			condition.runOp = condition.terms[condition.kept[1]].op;
+			const bool isAnd = condition.runOp == InstructionToken::And;
+			const auto rank = [&condition, isAnd](size_t idx) {
+				const ConditionTerm& term = condition.terms[idx];
+				const double stop = isAnd ? 1 - term.selectivity : term.selectivity;
+				return stop > 0 ? term.cost / stop : std::numeric_limits<double>::infinity();
+			};
+
+			std::vector<size_t> order{ condition.kept.begin(), condition.kept.begin() + run };
+			std::stable_sort(order.begin(), order.end(), [&rank](size_t a, size_t b) { return rank(a) < rank(b); });
+			if (std::equal(order.begin(), order.end(), condition.kept.begin()))
+				return false;
+
+			std::copy(order.begin(), order.end(), condition.kept.begin());
+			return true;
+		}
+
+		bool rewriteIf(uint16_t pos, uint16_t end, uint16_t& next, RangeEnvironment& env, std::vector<ScriptCode>& out)
+		{
+			Condition condition{};
+			if (!ConditionParser{ _script, env, static_cast<uint16_t>(pos + 1), end }.parse(condition))
+				return false;
+
+			uint16_t elsePos = 0;
+			uint16_t endifPos = 0;
+			int depth = 0;
+			for (uint16_t idx = condition.end; idx < end && !endifPos; ++idx)
+			{
+				const ScriptCode code = _script.codeData[idx];
+				if (depth == 0 && code == InstructionToken::Else && !elsePos)
+					elsePos = idx;
+				else if (depth == 0 && code == InstructionToken::Endif)
+					endifPos = idx;
+				else if ((depth += Script::blockDelta(code)) < 0)
+					return false;
+			}
+			if (!endifPos)
+				return false;
+
+			simplify(condition);
+			const uint16_t thenEnd = elsePos ? elsePos : endifPos;
+			next = endifPos + 1;
+
+			const Truth truth = truth_of(condition.value);
+			if (truth != Truth::Unknown)
+			{
+				++_rewrites;
+				std::vector<ScriptCode> body{};
+				if (truth == Truth::True)
+					rewrite(condition.end, thenEnd, env, body);
+				else if (elsePos)
+					rewrite(elsePos + 1, endifPos, env, body);
+				appendInlined(body, out);
+				return true;
+			}
+
+			RangeEnvironment elseEnv{ env };
+			narrow(condition, true, env);
+			narrow(condition, false, elseEnv);
+
+			std::vector<ScriptCode> thenBody{};
+			std::vector<ScriptCode> elseBody{};
+			rewrite(condition.end, thenEnd, env, thenBody);
+			if (elsePos)
+				rewrite(elsePos + 1, endifPos, elseEnv, elseBody);
+			env.join(elseEnv);
+
+			const bool emptyThen = isEmptyBody(thenBody);
+			const bool emptyElse = isEmptyBody(elseBody);
+			if (emptyThen && emptyElse)
+			{
+				++_rewrites;
+				return true;
+			}
+
+			if (condition.kept.size() != condition.terms.size())
+				++_rewrites;
+			if (_options.schedule)
+			{
+				const double before = condition.expectedCost();
+				if (schedule(condition))
+					++_rewrites;
+				if (_options.costs && condition.kept.size() > 1)
+					_options.costs->push_back({ pos, before, condition.expectedCost() });
+			}
+
+			out.push_back(InstructionToken::If);
+			for (size_t i = 0; i < condition.kept.size(); ++i)
+			{
+				const ConditionTerm& term = condition.terms[condition.kept[i]];
+				if (i > 0)
+					out.push_back(condition.operatorAt(i));
+				out.insert(out.end(), _script.codeData + term.begin, _script.codeData + term.end);
+			}
+
+			out.insert(out.end(), thenBody.begin(), thenBody.end());
+			if (elsePos && !emptyElse)
+			{
+				out.push_back(InstructionToken::Else);
+				out.insert(out.end(), elseBody.begin(), elseBody.end());
+			}
+			else if (elsePos)
+				++_rewrites;
+			out.push_back(InstructionToken::Endif);
+			return true;
+		}
+
+		bool rewriteEvery(uint16_t pos, uint16_t end, uint16_t& next, RangeEnvironment& env, std::vector<ScriptCode>& out)
+		{
+			uint16_t begin = pos + 1;
+			while (begin < end && _script.codeData[begin] < TOKEN_OFFSET)
+				++begin;
+
+			uint16_t blockEnd;
+			if (begin >= end || _script.codeData[begin] != InstructionToken::Begin || !findBlockEnd(begin + 1, end, blockEnd))
+				return false;
+
+			RangeEnvironment bodyEnv{ env };
+			std::vector<ScriptCode> body{};
+			rewrite(begin + 1, blockEnd, bodyEnv, body);
+			env.join(bodyEnv);
+			next = blockEnd + 1;
+
+			if (body.empty())
+			{
+				++_rewrites;
+				return true;
+			}
+
+			out.insert(out.end(), _script.codeData + pos, _script.codeData + begin + 1);
+			out.insert(out.end(), body.begin(), body.end());
+			out.push_back(InstructionToken::End);
+			return true;
+		}
+
+		static bool isWrapped(const std::vector<ScriptCode>& body)
+		{
+			if (body.size() < 2 || body.front() != InstructionToken::Begin || body.back() != InstructionToken::End)
+				return false;
+
+			int depth = 0;
+			for (size_t i = 0; i < body.size(); ++i)
+				if ((depth += Script::blockDelta(body[i])) == 0)
+					return i == body.size() - 1;
+			return false;
+		}
+
+		static bool isEmptyBody(const std::vector<ScriptCode>& body)
+		{
+			return body.empty() || (body.size() == 2 && isWrapped(body));
+		}
+
+		static void appendInlined(const std::vector<ScriptCode>& body, std::vector<ScriptCode>& out)
+		{
+			if (isWrapped(body))
+				out.insert(out.end(), body.begin() + 1, body.end() - 1);
+			else out.insert(out.end(), body.begin(), body.end());
+		}
+	};
+
+	OptimizationStats rewrite_conditions(Script& script, const RewriteOptions& options)
+	{
+		const uint16_t length = script.length();
+		if (length < 2 || script.codeData[length - 1] != InstructionToken::ScriptEnd)
+			return {};
+
+		ConditionRewriter rewriter{ script, options };
+		RangeEnvironment env{ options.ranges };
+		std::vector<ScriptCode> codes{};
+		codes.reserve(length);
+		rewriter.rewrite(1, length - 1, env, codes);
+		codes.push_back(InstructionToken::ScriptEnd);
+
+		OptimizationStats stats{ rewriter.rewrites(), 0, 0 };
+		if (!stats.rewrites)
+			return stats;
+
+		stats.codesSaved = length - 1 - static_cast<uint32_t>(codes.size());
+		std::memset(script.codeData + 1, 0, (MAX_CODES - 1) * sizeof(ScriptCode));
+		std::memcpy(script.codeData + 1, codes.data(), codes.size() * sizeof(ScriptCode));
+		stats.fieldsSaved = compact_fields(script);
+		return stats;
+	}
+
+
+	bool has_side_effects(const Statement& statement)
+	{
+		switch (statement.getCodeFragmentType())
+		{
+			case CodeFragmentType::FunctionCall:
+				return true;
+
+			case CodeFragmentType::Operation: {
+				const Operation& op = dynamic_cast<const Operation&>(statement);
+				const Operator& oper = op.getOperator();
+				if (oper.isAssignment() || oper == Operator::SufixIncrement || oper == Operator::SufixDecrement ||
+					oper == Operator::PrefixIncrement || oper == Operator::PrefixDecrement)
+					return true;
+				for (unsigned int i = 0; i < op.getOperandCount(); ++i)
+					if (has_side_effects(op.getOperand(i)))
+						return true;
+				return false;
+			}
+
+			default:
+				return false;
+		}
+	}
+
+	std::optional<field_value_t> literal_value(const Statement& statement)
+	{
+		if (statement.getCodeFragmentType() != CodeFragmentType::LiteralInteger)
+			return {};
+		return dynamic_cast<const LiteralInteger&>(statement).getValue();
+	}
+
+
+	struct Occurrence
+	{
+		size_t statement;
+		const Statement* node;
+		size_t hash;
+		size_t size;
+		std::vector<uint32_t> versions;
+	};
+
+	bool is_increment(const Operator& oper)
+	{
+		return oper == Operator::SufixIncrement || oper == Operator::SufixDecrement ||
+			oper == Operator::PrefixIncrement || oper == Operator::PrefixDecrement;
+	}
+
+	class OccurrenceCollector
+	{
+	private:
+		std::map<std::string, uint32_t> _versions;
+		std::vector<Occurrence>& _occurrences;
+		std::vector<bool>& _effects;
+		size_t _statement;
+		uint32_t _barrier;
+
+	public:
+		OccurrenceCollector(std::vector<Occurrence>& occurrences, std::vector<bool>& effects) :
+			_versions{},
+			_occurrences{ occurrences },
+			_effects{ effects },
+			_statement{ 0 },
+			_barrier{ 0 }
+		{}
+
+		void collect(const std::vector<Statement*>& statements)
+		{
+			_effects.assign(statements.size(), false);
+			for (_statement = 0; _statement < statements.size(); ++_statement)
+			{
+				const Statement& statement = *statements[_statement];
+				if (statement.getCodeFragmentType() == CodeFragmentType::Operation && dynamic_cast<const Operation&>(statement).isAssignment())
+				{
+					const Operation& op = dynamic_cast<const Operation&>(statement);
+					visit(op.getOperand(1));
+					++_versions[op.getOperand(0).toString()];
+				}
+				else visit(statement);
+			}
+		}
+
+	private:
+		bool visit(const Statement& statement)
+		{
+			switch (statement.getCodeFragmentType())
+			{
+				case CodeFragmentType::Identifier:
+				case CodeFragmentType::LiteralInteger:
+				case CodeFragmentType::TypeConstant:
+					return true;
+
+				case CodeFragmentType::Operation:
+					break;
+
+				default:
+					++_barrier;
+					_effects[_statement] = true;
+					return false;
+			}
+
+			const Operation& op = dynamic_cast<const Operation&>(statement);
+			if (op.isAssignment() || is_increment(op.getOperator()))
+			{
+				if (op.isAssignment())
+					visit(op.getOperand(1));
+				++_versions[op.getOperand(0).toString()];
+				_effects[_statement] = true;
+				return false;
+			}
+
+			bool pure = true;
+			for (unsigned int i = 0; i < op.getOperandCount(); ++i)
+				pure = visit(op.getOperand(i)) && pure;
+			if (!pure)
+				return false;
+
+			Occurrence occurrence{ _statement, &statement, statement.hash(), 0, { _barrier } };
+			measure(statement, occurrence);
+			_occurrences.push_back(std::move(occurrence));
+			return true;
+		}
+
+		void measure(const Statement& statement, Occurrence& occurrence)
+		{
+			++occurrence.size;
+			if (statement.getCodeFragmentType() == CodeFragmentType::Identifier)
+				occurrence.versions.push_back(_versions[statement.toString()]);
+			else if (statement.getCodeFragmentType() == CodeFragmentType::Operation)
+			{
+				const Operation& op = dynamic_cast<const Operation&>(statement);
+				for (unsigned int i = 0; i < op.getOperandCount(); ++i)
+					measure(op.getOperand(i), occurrence);
+			}
+		}
+	};
+
+	bool same_value(const Occurrence& left, const Occurrence& right)
+	{
+		return left.hash == right.hash && left.versions == right.versions && *left.node == *right.node;
+	}
+
+	Statement* substitute(const Statement& statement, const std::vector<const Statement*>& nodes, const std::string& name)
+	{
+		if (std::find(nodes.begin(), nodes.end(), &statement) != nodes.end())
+			return new Identifier{ name };
+		if (statement.getCodeFragmentType() != CodeFragmentType::Operation)
+			return statement.clone();
+
+		const Operation& op = dynamic_cast<const Operation&>(statement);
+		Statement* operands[3] = { nullptr, nullptr, nullptr };
+		for (unsigned int i = 0; i < op.getOperandCount() && i < 3; ++i)
+			operands[i] = substitute(op.getOperand(i), nodes, name);
+		return new Operation{ Operation::make(op.getOperator(), operands[0], operands[1], operands[2]) };
+	}
+
+	std::optional<field_value_t> narrow_value(int64_t value)
+	{
+		if (value < INT32_MIN || value > INT32_MAX)
+			return {};
+		return static_cast<field_value_t>(value);
+	}
+
+	int64_t floor_div(int64_t a, int64_t b) { return a / b - (a % b != 0 && (a < 0) != (b < 0)); }
+	int64_t ceil_div(int64_t a, int64_t b) { return a / b + (a % b != 0 && (a < 0) == (b < 0)); }
+
+	bool is_comparison(const Operator& oper)
+	{
+		return oper == Operator::GreaterThan || oper == Operator::SmallerThan || oper == Operator::GreaterEqualsThan ||
+			oper == Operator::SmallerEqualsThan || oper == Operator::EqualsTo || oper == Operator::NotEqualsTo;
+	}
+
+	const Operator& mirror(const Operator& oper)
+	{
+		if (oper == Operator::GreaterThan) return Operator::SmallerThan;
+		if (oper == Operator::SmallerThan) return Operator::GreaterThan;
+		if (oper == Operator::GreaterEqualsThan) return Operator::SmallerEqualsThan;
+		if (oper == Operator::SmallerEqualsThan) return Operator::GreaterEqualsThan;
+		return oper;
+	}
+
+	Operation make_binary(const Operator& oper, const Statement& left, const Statement& right)
+	{
+		return Operation::make(oper, left.clone(), right.clone());
+	}
+
+	const Operation* scaled_operand(const Statement& statement, const Operator& oper, field_value_t& factor)
+	{
+		if (statement.getCodeFragmentType() != CodeFragmentType::Operation)
+			return nullptr;
+
+		const Operation& op = dynamic_cast<const Operation&>(statement);
+		const std::optional<field_value_t> value = op.isBinary() ? literal_value(op.getOperand(1)) : std::nullopt;
+		if (op.getOperator() != oper || !value || *value <= 0)
+			return nullptr;
+		factor = *value;
+		return &op;
+	}
+
+	ValueRange expression_range(const Statement& statement)
+	{
+		if (const std::optional<field_value_t> value = literal_value(statement))
+			return ValueRange::constant(*value);
+		if (statement.getCodeFragmentType() != CodeFragmentType::Operation)
+			return ValueRange::full();
+
+		const Operation& op = dynamic_cast<const Operation&>(statement);
+		if (!op.isBinary())
+			return ValueRange::full();
+		if (is_comparison(op.getOperator()))
+			return ValueRange::boolean();
+		if (op.getOperator() == Operator::Multiplication)
+			return expression_range(op.getOperand(0)) * expression_range(op.getOperand(1));
+		if (op.getOperator() == Operator::Division)
+			return expression_range(op.getOperand(0)) / expression_range(op.getOperand(1));
+		return ValueRange::full();
+	}
+
+	bool scale_fits(const Statement& statement, field_value_t factor)
+	{
+		const ValueRange range = expression_range(statement);
+		return ValueRange::full().contains(range.min * factor) && ValueRange::full().contains(range.max * factor);
+	}
+
+	void collect_identifiers(const Statement& statement, std::vector<std::string>& names)
+	{
+		if (statement.getCodeFragmentType() == CodeFragmentType::Identifier)
+			names.push_back(statement.toString());
+		else if (statement.getCodeFragmentType() == CodeFragmentType::Operation)
+		{
+			const Operation& op = dynamic_cast<const Operation&>(statement);
+			for (unsigned int i = 0; i < op.getOperandCount(); ++i)
+				collect_identifiers(op.getOperand(i), names);
+		}
+	}
+}
+
+OptimizationStats& OptimizationStats::operator+= (const OptimizationStats& other)
+{
+	rewrites += other.rewrites;
+	codesSaved += other.codesSaved;
+	fieldsSaved += other.fieldsSaved;
+	return *this;
+}
+
+
+
+
+ConstantEvaluator::ConstantEvaluator() :
+	_constants{}
+{}
+
+void ConstantEvaluator::define(const std::string& name, field_value_t value) { _constants[name] = value; }
+bool ConstantEvaluator::isDefined(const std::string& name) const { return _constants.find(name) != _constants.end(); }
+
+std::optional<field_value_t> ConstantEvaluator::evaluate(const Statement& statement) const
+{
+	switch (statement.getCodeFragmentType())
+	{
+		case CodeFragmentType::LiteralInteger:
+			return dynamic_cast<const LiteralInteger&>(statement).getValue();
+
+		case CodeFragmentType::TypeConstant:
+			return static_cast<field_value_t>(dynamic_cast<const TypeConstant&>(statement).getValue());
+
+		case CodeFragmentType::Identifier: {
+			const auto& it = _constants.find(statement.toString());
+			if (it == _constants.end())
+				return {};
+			return it->second;
+		}
+
+		case CodeFragmentType::Operation:
+			break;
+
+		default:
+			return {};
+	}
+
+	const Operation& op = dynamic_cast<const Operation&>(statement);
+	const Operator& oper = op.getOperator();
+	if (oper.isAssignment())
+		return {};
+
+	const std::optional<field_value_t> first = evaluate(op.getOperand(0));
+	if (oper.isTernary())
+	{
+		if (!first)
+			return {};
+		return evaluate(op.getOperand(*first ? 1 : 2));
+	}
+
+	if (oper.isUnary())
+	{
+		if (!first)
+			return {};
+		if (oper == Operator::UnaryMinus)
+			return static_cast<field_value_t>(0U - static_cast<uint32_t>(*first));
+		if (oper == Operator::BinaryNot)
+			return !*first;
+		return {};
+	}
+
+	if (oper == Operator::BinaryAnd && first && !*first)
+		return 0;
+	if (oper == Operator::BinaryOr && first && *first)
+		return 1;
+
+	const std::optional<field_value_t> second = evaluate(op.getOperand(1));
+	if (!first || !second)
+		return {};
+
+	const int64_t a = *first, b = *second;
+	if (oper == Operator::Addition) return static_cast<field_value_t>(a + b);
+	if (oper == Operator::Subtraction) return static_cast<field_value_t>(a - b);
+	if (oper == Operator::Multiplication) return static_cast<field_value_t>(a * b);
+	if (oper == Operator::Division) return b == 0 ? std::optional<field_value_t>{} : static_cast<field_value_t>(a / b);
+	if (oper == Operator::GreaterThan) return a > b;
+	if (oper == Operator::SmallerThan) return a < b;
+	if (oper == Operator::GreaterEqualsThan) return a >= b;
+	if (oper == Operator::SmallerEqualsThan) return a <= b;
+	if (oper == Operator::EqualsTo) return a == b;
+	if (oper == Operator::NotEqualsTo) return a != b;
+	if (oper == Operator::BinaryAnd) return a && b;
+	if (oper == Operator::BinaryOr) return a || b;
+	return {};
+}
+
+Statement* ConstantEvaluator::fold(const Statement& statement) const
+{
+	if (statement.getCodeFragmentType() != CodeFragmentType::Operation)
+	{
+		const std::optional<field_value_t> value = statement.getCodeFragmentType() == CodeFragmentType::Identifier ? evaluate(statement) : std::nullopt;
+		return value ? new LiteralInteger{ *value } : statement.clone();
+	}
+
+	if (!has_side_effects(statement))
+	{
+		const std::optional<field_value_t> value = evaluate(statement);
+		if (value)
+			return new LiteralInteger{ *value };
+	}
+
+	const Operation& op = dynamic_cast<const Operation&>(statement);
+	const Operator& oper = op.getOperator();
+
+	Statement* operands[3] = { nullptr, nullptr, nullptr };
+	for (unsigned int i = 0; i < op.getOperandCount() && i < 3; ++i)
+		operands[i] = oper.isAssignment() && i == 0 ? op.getOperand(i).clone() : fold(op.getOperand(i));
+
+	const std::optional<field_value_t> condition = literal_value(*operands[0]);
+	if (oper.isTernary() && condition)
+	{
+		Statement* const chosen = operands[*condition ? 1 : 2];
+		delete operands[0];
+		delete operands[*condition ? 2 : 1];
+		return chosen;
+	}
+
+	return new Operation{ Operation::make(oper, operands[0], operands[1], operands[2]) };
+}
+
+
+
+
+OptimizationStats DeadCodeElimination::run(Script& script) const
+{
+	PROFILE_SCOPE("DeadCodeElimination::run");
+	return rewrite_conditions(script, { false, false, nullptr });
+}
+
+OptimizationStats RangeAnalysis::run(Script& script) const
+{
+	PROFILE_SCOPE("RangeAnalysis::run");
+	return rewrite_conditions(script, { true, false, nullptr });
+}
+
+
+
+
+ConditionScheduling::ConditionScheduling(bool report) :
+	_report{ report },
+	_costs{}
+{}
+
+OptimizationStats ConditionScheduling::run(Script& script)
+{
+	PROFILE_SCOPE("ConditionScheduling::run");
+	_costs.clear();
+	return rewrite_conditions(script, { true, true, _report ? &_costs : nullptr });
+}
+
+const std::vector<ConditionCost>& ConditionScheduling::costs() const { return _costs; }
+
+void ConditionScheduling::printReport(std::ostream& output) const
+{
+	double before = 0;
+	double after = 0;
+	output << std::setw(8) << "offset" << std::setw(12) << "before" << std::setw(12) << "after" << std::setw(10) << "saved" << std::endl;
+	for (const ConditionCost& cost : _costs)
+	{
+		output << std::setw(8) << cost.offset << std::setw(12) << cost.before << std::setw(12) << cost.after
+			<< std::setw(9) << (cost.before > 0 ? (cost.before - cost.after) / cost.before * 100 : 0) << "%" << std::endl;
+		before += cost.before;
+		after += cost.after;
+	}
+	output << std::setw(8) << "total" << std::setw(12) << before << std::setw(12) << after
+		<< std::setw(9) << (before > 0 ? (before - after) / before * 100 : 0) << "%" << std::endl;
+}
+
+
+
+
+Statement* AlgebraicSimplifier::simplify(const Statement& statement) const
+{
+	PROFILE_SCOPE("AlgebraicSimplifier::simplify");
+	return rewrite(statement);
+}
+
+Statement* AlgebraicSimplifier::rewrite(const Statement& statement) const
+{
+	if (statement.getCodeFragmentType() != CodeFragmentType::Operation)
+		return statement.clone();
+
+	const Operation& op = dynamic_cast<const Operation&>(statement);
+	Statement* operands[3] = { nullptr, nullptr, nullptr };
+	for (unsigned int i = 0; i < op.getOperandCount() && i < 3; ++i)
+		operands[i] = op.isAssignment() && i == 0 ? op.getOperand(i).clone() : rewrite(op.getOperand(i));
+
+	Operation* const result = new Operation{ Operation::make(op.getOperator(), operands[0], operands[1], operands[2]) };
+	Statement* const reduced = reduce(*result);
+	if (!reduced)
+		return result;
+
+	delete result;
+	return reduced;
+}
+
+Statement* AlgebraicSimplifier::reduce(const Operation& op) const
+{
+	if (!op.isBinary())
+		return nullptr;
+
+	const Operator& oper = op.getOperator();
+	const Statement& left = op.getOperand(0);
+	const Statement& right = op.getOperand(1);
+	const std::optional<field_value_t> lv = literal_value(left);
+	const std::optional<field_value_t> rv = literal_value(right);
+
+	if (lv && rv && (oper == Operator::Multiplication || oper == Operator::Division || is_comparison(oper)))
+	{
+		const std::optional<field_value_t> value = ConstantEvaluator{}.evaluate(op);
+		return value ? new LiteralInteger{ *value } : nullptr;
+	}
+
+	if (lv && (oper == Operator::Multiplication || is_comparison(oper)))
+		return rewrite(make_binary(mirror(oper), right, left));
+	if (!rv)
+		return nullptr;
+
+	const int64_t k = *rv;
+	field_value_t factor;
+	if (oper == Operator::Multiplication)
+	{
+		if (k == 1)
+			return left.clone();
+		if (k == 0 && !has_side_effects(left))
+			return new LiteralInteger{ 0 };
+
+		const Operation* const inner = scaled_operand(left, Operator::Multiplication, factor);
+		const std::optional<field_value_t> product = inner ? narrow_value(factor * k) : std::nullopt;
+		if (product)
+			return rewrite(make_binary(Operator::Multiplication, inner->getOperand(0), LiteralInteger{ *product }));
+		return nullptr;
+	}
+
+	if (oper == Operator::Division)
+	{
+		if (k == 1)
+			return left.clone();
+		if (k <= 0)
+			return nullptr;
+
+		const Operation* inner = scaled_operand(left, Operator::Division, factor);
+		const std::optional<field_value_t> product = inner ? narrow_value(factor * k) : std::nullopt;
+		if (product)
+			return rewrite(make_binary(Operator::Division, inner->getOperand(0), LiteralInteger{ *product }));
+
+		inner = scaled_operand(left, Operator::Multiplication, factor);
+		if (inner && !scale_fits(inner->getOperand(0), factor))
+			return nullptr;
+		if (inner && factor % k == 0)
+			return rewrite(make_binary(Operator::Multiplication, inner->getOperand(0), LiteralInteger{ static_cast<field_value_t>(factor / k) }));
+		if (inner && k % factor == 0)
+			return rewrite(make_binary(Operator::Division, inner->getOperand(0), LiteralInteger{ static_cast<field_value_t>(k / factor) }));
+		return nullptr;
+	}
+
+	if (!is_comparison(oper))
+		return nullptr;
+
+	if (const Operation* const inner = scaled_operand(left, Operator::Multiplication, factor))
+	{
+		if (!scale_fits(inner->getOperand(0), factor))
+			return nullptr;
+
+		const Statement& x = inner->getOperand(0);
+		std::optional<field_value_t> bound{};
+		if (oper == Operator::GreaterThan || oper == Operator::SmallerEqualsThan)
+			bound = narrow_value(floor_div(k, factor));
+		else if (oper == Operator::GreaterEqualsThan || oper == Operator::SmallerThan)
+			bound = narrow_value(ceil_div(k, factor));
+		else if (k % factor == 0)
+			bound = static_cast<field_value_t>(k / factor);
+		else if (!has_side_effects(x))
+			return new LiteralInteger{ oper == Operator::NotEqualsTo };
+
+		return bound ? rewrite(make_binary(oper, x, LiteralInteger{ *bound })) : nullptr;
+	}
+
+	const Operation* const inner = scaled_operand(left, Operator::Division, factor);
+	if (!inner || oper == Operator::EqualsTo || oper == Operator::NotEqualsTo)
+		return nullptr;
+
+	const Statement& x = inner->getOperand(0);
+	const bool lower = oper == Operator::GreaterThan || oper == Operator::GreaterEqualsThan;
+	const int64_t m = oper == Operator::GreaterThan ? k + 1 : oper == Operator::SmallerThan ? k - 1 : k;
+	const std::optional<field_value_t> bound = lower
+		? narrow_value(m > 0 ? m * factor : m * factor - factor + 1)
+		: narrow_value(m >= 0 ? m * factor + factor - 1 : m * factor);
+	if (!bound)
+		return nullptr;
+	return rewrite(make_binary(lower ? Operator::GreaterEqualsThan : Operator::SmallerEqualsThan, x, LiteralInteger{ *bound }));
+}
+
+
+
+
+CommonSubexpressionElimination::CommonSubexpressionElimination(const std::string& prefix, unsigned int minUses) :
+	_prefix{ prefix },
+	_minUses{ std::max(minUses, 2U) }
+{}
+
+OptimizationStats CommonSubexpressionElimination::run(std::vector<Statement*>& statements) const
+{
+	PROFILE_SCOPE("CommonSubexpressionElimination::run");
+
+	std::vector<std::string> names{};
+	for (const Statement* statement : statements)
+		collect_identifiers(*statement, names);
+
+	OptimizationStats stats{};
+	unsigned int temporary = 0;
+	for (;;)
+	{
+		std::vector<Occurrence> occurrences{};
+		std::vector<bool> effects{};
+		OccurrenceCollector{ occurrences, effects }.collect(statements);
+
+		std::vector<const Statement*> best{};
+		size_t bestFirst = 0;
+		size_t bestSaving = 0;
+		std::vector<bool> grouped(occurrences.size(), false);
+		for (size_t i = 0; i < occurrences.size(); ++i)
+		{
+			if (grouped[i] || occurrences[i].size < 3)
+				continue;
+
+			std::vector<const Statement*> group{ occurrences[i].node };
+			size_t first = occurrences[i].statement;
+			for (size_t j = i + 1; j < occurrences.size(); ++j)
+			{
+				if (!grouped[j] && same_value(occurrences[i], occurrences[j]))
+				{
+					grouped[j] = true;
+					group.push_back(occurrences[j].node);
+					first = std::min(first, occurrences[j].statement);
+				}
+			}
+
+			const size_t saving = (group.size() - 1) * occurrences[i].size;
+			if (group.size() >= _minUses && !effects[first] && saving > group.size() + 2 && saving > bestSaving)
+			{
+				best = std::move(group);
+				bestFirst = first;
+				bestSaving = saving;
+			}
+		}
+
+		if (best.empty())
+			return stats;
+
+		std::string name{};
+		do name = _prefix + std::to_string(temporary++);
+		while (std::find(names.begin(), names.end(), name) != names.end());
+		names.push_back(name);
+
+		Statement* const value = best.front()->clone();
+		for (Statement*& statement : statements)
+		{
+			Statement* const replaced = substitute(*statement, best, name);
+			delete statement;
+			statement = replaced;
+		}
+		statements.insert(statements.begin() + bestFirst, new Operation{ Operation::make(Operator::Assignment, new Identifier{ name }, value) });
+
+		++stats.rewrites;
+		stats.codesSaved += static_cast<uint32_t>(bestSaving - best.size() - 2);
+	}
+}
+
+
+
+
+uint32_t compact_fields(Script& script)
+{
+	const uint16_t length = script.length();
+	bool used[MAX_FIELDS] = {};
+	for (uint16_t pos = 1; pos < length; ++pos)
+		if (script.codeData[pos] < MAX_FIELDS)
+			used[script.codeData[pos]] = true;
+
+	uint32_t removed = 0;
+	for (uint16_t idx = 0; idx < MAX_FIELDS; ++idx)
+		if (!used[idx] && !script.fieldData[idx].isInvalid())
+			++removed;
+	if (!removed)
+		return 0;
+
+	uint16_t remap[MAX_FIELDS];
+	uint16_t count = 0;
+	for (uint16_t idx = 0; idx < MAX_FIELDS; ++idx)
+	{
+		if (!used[idx])
+			continue;
+		remap[idx] = count;
+		script.fieldData[count++] = script.fieldData[idx];
+	}
+	for (uint16_t idx = count; idx < MAX_FIELDS; ++idx)
+		script.fieldData[idx] = ScriptField::invalid();
+
+	for (uint16_t pos = 1; pos < length; ++pos)
+		if (script.codeData[pos] < MAX_FIELDS)
+			script.codeData[pos] = remap[script.codeData[pos]];
+	return removed;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+#include <map>
+#include <vector>
+#include <optional>
+#include <ostream>
+
+#include "script.h"
+#include "parser_elements.h"
+
+struct OptimizationStats
+{
+	uint32_t rewrites;
+	uint32_t codesSaved;
+	uint32_t fieldsSaved;
+
+	OptimizationStats& operator+= (const OptimizationStats& other);
+};
+
+class ConstantEvaluator
+{
+private:
+	std::map<std::string, field_value_t> _constants;
+
+public:
+	ConstantEvaluator();
+
+	void define(const std::string& name, field_value_t value);
+	bool isDefined(const std::string& name) const;
+
+	std::optional<field_value_t> evaluate(const Statement& statement) const;
+
+	Statement* fold(const Statement& statement) const;
+};
+
+class DeadCodeElimination
+{
+public:
+	OptimizationStats run(Script& script) const;
+};
+
+class RangeAnalysis
+{
+public:
+	OptimizationStats run(Script& script) const;
+};
+
+struct ConditionCost
+{
+	uint16_t offset;
+	double before;
+	double after;
+};
+
+class ConditionScheduling
+{
+private:
+	bool _report;
+	std::vector<ConditionCost> _costs;
+
+public:
+	ConditionScheduling(bool report = false);
+
+	OptimizationStats run(Script& script);
+
+	const std::vector<ConditionCost>& costs() const;
+
+	void printReport(std::ostream& output) const;
+};
+
+class AlgebraicSimplifier
+{
+public:
+	Statement* simplify(const Statement& statement) const;
+
+private:
+	Statement* rewrite(const Statement& statement) const;
+	Statement* reduce(const Operation& op) const;
+};
+
+class CommonSubexpressionElimination
+{
+private:
+	std::string _prefix;
+	unsigned int _minUses;
+
+public:
+	CommonSubexpressionElimination(const std::string& prefix = "_cse", unsigned int minUses = 2);
+
+	OptimizationStats run(std::vector<Statement*>& statements) const;
+};
+
+uint32_t compact_fields(Script& script);
@@ -1,6 +1,14 @@
 #include "parser_elements.h"
 
 #include <sstream>
+#include <cctype>
+
+#include "profiler.h"
+
+namespace
+{
+	size_t hash_combine(size_t seed, size_t value) { return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2)); }
+}
 
 CodeFragment::~CodeFragment() {}
 
@@ -20,6 +28,16 @@ bool CodeFragment::is(const CodeFragmentType type1, const CodeFragmentType type2
 
 
 
+Statement::Statement() :
+	CodeFragment{}
+{
+	PROFILE_COUNT(ProfileCounter::AstNodes, 1);
+}
+
+Statement::Statement(const Statement&) :
+	Statement{}
+{}
+
 Statement::~Statement() {}
 
 bool Statement::isStatement() const { return true; }
@@ -34,28 +52,40 @@ Identifier::Identifier(const std::string& identifier) :
 		throw InvalidIdentifier{};
 }
 
+Result<Identifier> Identifier::make(const std::string& identifier)
+{
+	if (!isValid(identifier))
+		return Error{ ErrorCode::InvalidIdentifier, "Invalid identifier" };
+	return Identifier{ identifier };
+}
+
 CodeFragmentType Identifier::getCodeFragmentType() const { return CodeFragmentType::Identifier; }
 
+Statement* Identifier::clone() const { return new Identifier{ *this }; }
+
+size_t Identifier::hash() const { return hash_combine(static_cast<size_t>(getCodeFragmentType()), std::hash<std::string>{}(_identifier)); }
+
 std::string Identifier::toString() const { return _identifier; }
 
 bool Identifier::operator== (const CodeFragment& cf) const
 {
-	try
-	{
-		const Identifier& other = dynamic_cast<const Identifier&>(cf);
-		return *this == other;
-	}
-	catch (...) { return false; }
+	const Identifier* const other = dynamic_cast<const Identifier*>(&cf);
+	return other && *this == *other;
 }
 
 bool Identifier::operator== (const Identifier& cf) const { return _identifier == cf._identifier; }
 bool Identifier::operator!= (const Identifier& cf) const { return _identifier != cf._identifier; }
 
 
-const std::regex Identifier::PATTERN{"[_a-zA-Z][_a-zA-Z0-9]*"};
-
-
-bool Identifier::isValid(const std::string& identifier) { return std::regex_search(identifier, PATTERN); }
+bool Identifier::isValid(const std::string& identifier)
+{
+	if (identifier.empty() || !(std::isalpha(static_cast<unsigned char>(identifier[0])) || identifier[0] == '_'))
+		return false;
+	for (const char c : identifier)
+		if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_')
+			return false;
+	return true;
+}
 
 
 LiteralInteger::LiteralInteger(const field_value_t value) :
@@ -67,16 +97,16 @@ field_value_t LiteralInteger::getValue() const { return _value; }
 
 CodeFragmentType LiteralInteger::getCodeFragmentType() const { return CodeFragmentType::LiteralInteger; }
 
+Statement* LiteralInteger::clone() const { return new LiteralInteger{ *this }; }
+
+size_t LiteralInteger::hash() const { return hash_combine(static_cast<size_t>(getCodeFragmentType()), static_cast<size_t>(_value)); }
+
 std::string LiteralInteger::toString() const { return std::to_string(_value); }
 
 bool LiteralInteger::operator== (const CodeFragment& cf) const
 {
-	try
-	{
-		const LiteralInteger& other = dynamic_cast<const LiteralInteger&>(cf);
-		return *this == other;
-	}
-	catch (...) { return false; }
+	const LiteralInteger* const other = dynamic_cast<const LiteralInteger*>(&cf);
+	return other && *this == *other;
 }
 
 bool LiteralInteger::operator== (const LiteralInteger& other) const { return _value == other._value; }
@@ -97,9 +127,20 @@ LiteralInteger LiteralInteger::parse(const std::string& str)
 	return std::stol(str, nullptr, find_integer_base(str));
 }
 
-bool LiteralInteger::isValid(const std::string& str) { return std::regex_search(str, PATTERN); }
+bool LiteralInteger::isValid(const std::string& str)
+{
+	if (str.empty())
+		return false;
+
+	const bool hex = find_integer_base(str) == IntegerBase::Hexadecimal;
+	if (hex && str.size() <= 2)
+		return false;
 
-const std::regex LiteralInteger::PATTERN{ "(0|0[xX])?[0-9]+" };
+	for (size_t i = hex ? 2 : 0; i < str.size(); ++i)
+		if (!(hex ? std::isxdigit(static_cast<unsigned char>(str[i])) : std::isdigit(static_cast<unsigned char>(str[i]))))
+			return false;
+	return true;
+}
 
 
 
@@ -114,16 +155,16 @@ ScriptCode TypeConstant::getValue() const { return _value; }
 
 CodeFragmentType TypeConstant::getCodeFragmentType() const { return CodeFragmentType::TypeConstant; }
 
+Statement* TypeConstant::clone() const { return new TypeConstant{ *this }; }
+
+size_t TypeConstant::hash() const { return hash_combine(static_cast<size_t>(getCodeFragmentType()), _value); }
+
 std::string TypeConstant::toString() const { return _type ? _type.getValueIdentifier(_value) : std::to_string(_value); }
 
 bool TypeConstant::operator== (const CodeFragment& cf) const
 {
-	try
-	{
-		const TypeConstant& other = dynamic_cast<const TypeConstant&>(cf);
-		return *this == other;
-	}
-	catch (...) { return false; }
+	const TypeConstant* const other = dynamic_cast<const TypeConstant*>(&cf);
+	return other && *this == *other;
 }
 bool TypeConstant::operator== (const TypeConstant& other) const { return _value == other._value; }
 bool TypeConstant::operator!= (const TypeConstant& other) const { return _value != other._value; }
@@ -133,11 +174,6 @@ bool TypeConstant::isValid(ScriptCode code) { return DataType::findTypeFromValue
 
 
 
-Stopchar::Stopchar(const char symbol) :
-	CodeFragment{},
-	_symbol{ symbol }
-{}
-
 bool Stopchar::isStatement() const { return false; }
 
 CodeFragmentType Stopchar::getCodeFragmentType() const { return CodeFragmentType::Stopchar; }
@@ -146,12 +182,8 @@ std::string Stopchar::toString() const { return std::string{ _symbol }; }
 
 bool Stopchar::operator== (const CodeFragment& cf) const
 {
-	try
-	{
-		const Stopchar& other = dynamic_cast<const Stopchar&>(cf);
-		return *this == other;
-	}
-	catch (...) { return false; }
+	const Stopchar* const other = dynamic_cast<const Stopchar*>(&cf);
+	return other && *this == *other;
 }
 bool Stopchar::operator== (const Stopchar& other) const { return _symbol == other._symbol; }
 bool Stopchar::operator!= (const Stopchar& other) const { return _symbol != other._symbol; }
@@ -166,11 +198,30 @@ _ArgumentsList::_ArgumentsList() :
 	_args{}
 {}
 
+_ArgumentsList::_ArgumentsList(const _ArgumentsList& other) :
+	_args{}
+{
+	_args.reserve(other._args.size());
+	for (const Statement* const arg : other._args)
+		_args.push_back(arg->clone());
+}
+
 _ArgumentsList::~_ArgumentsList()
 {
 	free_ptr_vector(_args);
 }
 
+_ArgumentsList& _ArgumentsList::operator= (const _ArgumentsList& other)
+{
+	if (this != &other)
+	{
+		free_ptr_vector(_args);
+		for (const Statement* const arg : other._args)
+			_args.push_back(arg->clone());
+	}
+	return *this;
+}
+
 bool _ArgumentsList::empty() const { return _args.empty(); }
 size_t _ArgumentsList::size() const { return _args.size(); }
 
@@ -195,8 +246,24 @@ std::string _ArgumentsList::toString() const
 	return ss.str();
 }
 
-bool _ArgumentsList::operator== (const _ArgumentsList& other) const { return _args == other._args; }
-bool _ArgumentsList::operator!= (const _ArgumentsList& other) const { return _args != other._args; }
+bool _ArgumentsList::operator== (const _ArgumentsList& other) const
+{
+	if (_args.size() != other._args.size())
+		return false;
+	for (size_t i = 0; i < _args.size(); ++i)
+		if (*_args[i] != *other._args[i])
+			return false;
+	return true;
+}
+bool _ArgumentsList::operator!= (const _ArgumentsList& other) const { return !operator==(other); }
+
+size_t _ArgumentsList::hash() const
+{
+	size_t seed = _args.size();
+	for (const Statement* arg : _args)
+		seed = hash_combine(seed, arg->hash());
+	return seed;
+}
 
 
 
@@ -208,16 +275,16 @@ Arguments::Arguments() :
 
 CodeFragmentType Arguments::getCodeFragmentType() const { return CodeFragmentType::Arguments; }
 
+Statement* Arguments::clone() const { return new Arguments{ *this }; }
+
+size_t Arguments::hash() const { return hash_combine(static_cast<size_t>(getCodeFragmentType()), _ArgumentsList::hash()); }
+
 std::string Arguments::toString() const { return _ArgumentsList::toString(); }
 
 bool Arguments::operator== (const CodeFragment& cf) const
 {
-	try
-	{
-		const Arguments& other = dynamic_cast<const Arguments&>(cf);
-		return *this == other;
-	}
-	catch (...) { return false; }
+	const Arguments* const other = dynamic_cast<const Arguments*>(&cf);
+	return other && *this == *other;
 }
 bool Arguments::operator== (const Arguments& other) const { return _ArgumentsList::operator==(other); }
 bool Arguments::operator!= (const Arguments& other) const { return _ArgumentsList::operator!=(other); }
@@ -225,19 +292,6 @@ bool Arguments::operator!= (const Arguments& other) const { return _ArgumentsLis
 
 
 
-Operator::Operator(const std::string& symbol, const OperatorType type, unsigned int priority, bool rightToLeft, bool conditional) :
-	_id{},
-	_symbol{ symbol },
-	_type{ type },
-	_priority{ priority },
-	_rightToLeft{ rightToLeft },
-	_conditional{ conditional }
-{
-	static uint8_t id_gen = 0;
-	_id = id_gen++;
-}
-
-
 unsigned int Operator::getPriority() const { return _priority; }
 bool Operator::hasRightToLeft() const { return _rightToLeft; }
 bool Operator::isConditional() const { return _conditional; }
@@ -254,6 +308,8 @@ int Operator::comparePriority(const Operator& other) const
 	return _priority < other._priority ? 1 : -1;
 }
 
+size_t Operator::hash() const { return _id; }
+
 bool Operator::isStatement() const { return false; }
 
 CodeFragmentType Operator::getCodeFragmentType() const { return CodeFragmentType::Operator; }
@@ -262,49 +318,45 @@ std::string Operator::toString() const { return _symbol; }
 
 bool Operator::operator== (const CodeFragment& cf) const
 {
-	try
-	{
-		const Operator& other = dynamic_cast<const Operator&>(cf);
-		return *this == other;
-	}
-	catch (...) { return false; }
+	const Operator* const other = dynamic_cast<const Operator*>(&cf);
+	return other && *this == *other;
 }
 bool Operator::operator== (const Operator& other) const { return _id == other._id; }
 bool Operator::operator!= (const Operator& other) const { return _id != other._id; }
 
 
-const Operator Operator::SufixIncrement{ "++", OperatorType::Unary, 0, false, false };
-const Operator Operator::SufixDecrement{ "--", OperatorType::Unary, 0, false, false };
+const Operator Operator::SufixIncrement{ 0, "++", OperatorType::Unary, 0, false, false };
+const Operator Operator::SufixDecrement{ 1, "--", OperatorType::Unary, 0, false, false };
 
-const Operator Operator::PrefixIncrement{ "++", OperatorType::Unary, 1, true, false };
-const Operator Operator::PrefixDecrement{ "--", OperatorType::Unary, 1, true, false };
-const Operator Operator::UnaryMinus{ "-", OperatorType::Unary, 1, true, false };
-const Operator Operator::BinaryNot{ "!", OperatorType::Unary, 1, true, false };
+const Operator Operator::PrefixIncrement{ 2, "++", OperatorType::Unary, 1, true, false };
+const Operator Operator::PrefixDecrement{ 3, "--", OperatorType::Unary, 1, true, false };
+const Operator Operator::UnaryMinus{ 4, "-", OperatorType::Unary, 1, true, false };
+const Operator Operator::BinaryNot{ 5, "!", OperatorType::Unary, 1, true, false };
 
-const Operator Operator::Multiplication{ "*", OperatorType::Binary, 2, false, false };
-const Operator Operator::Division{ "/", OperatorType::Binary, 2, false, false };
+const Operator Operator::Multiplication{ 6, "*", OperatorType::Binary, 2, false, false };
+const Operator Operator::Division{ 7, "/", OperatorType::Binary, 2, false, false };
 
-const Operator Operator::Addition{ "+", OperatorType::Binary, 3, false, false };
-const Operator Operator::Subtraction{ "-", OperatorType::Binary, 3, false, false };
+const Operator Operator::Addition{ 8, "+", OperatorType::Binary, 3, false, false };
+const Operator Operator::Subtraction{ 9, "-", OperatorType::Binary, 3, false, false };
 
-const Operator Operator::GreaterThan{ ">", OperatorType::Binary, 4, false, true };
-const Operator Operator::SmallerThan{ "<", OperatorType::Binary, 4, false, true };
-const Operator Operator::GreaterEqualsThan{ ">=", OperatorType::Binary, 4, false, true };
-const Operator Operator::SmallerEqualsThan{ "<=", OperatorType::Binary, 4, false, true };
+const Operator Operator::GreaterThan{ 10, ">", OperatorType::Binary, 4, false, true };
+const Operator Operator::SmallerThan{ 11, "<", OperatorType::Binary, 4, false, true };
+const Operator Operator::GreaterEqualsThan{ 12, ">=", OperatorType::Binary, 4, false, true };
+const Operator Operator::SmallerEqualsThan{ 13, "<=", OperatorType::Binary, 4, false, true };
 
-const Operator Operator::EqualsTo{ "==", OperatorType::Binary, 5, false, true };
-const Operator Operator::NotEqualsTo{ "!=", OperatorType::Binary, 5, false, true };
+const Operator Operator::EqualsTo{ 14, "==", OperatorType::Binary, 5, false, true };
+const Operator Operator::NotEqualsTo{ 15, "!=", OperatorType::Binary, 5, false, true };
 
-const Operator Operator::BinaryAnd{ "&&", OperatorType::Binary, 6, false, false };
-const Operator Operator::BinaryOr{ "||", OperatorType::Binary, 6, false, false };
+const Operator Operator::BinaryAnd{ 16, "&&", OperatorType::Binary, 6, false, false };
+const Operator Operator::BinaryOr{ 17, "||", OperatorType::Binary, 6, false, false };
 
-const Operator Operator::TernaryConditional{ "?=", OperatorType::Ternary, 7, false, false };
+const Operator Operator::TernaryConditional{ 18, "?=", OperatorType::Ternary, 7, false, false };
 
-const Operator Operator::Assignment{ "=", OperatorType::Assignment, 8, true, false };
-const Operator Operator::AssignmentAddition{ "+=", OperatorType::Assignment, 8, true, false };
-const Operator Operator::AssignmentSubtraction{ "-=", OperatorType::Assignment, 8, true, false };
-const Operator Operator::AssignmentMultiplication{ "*=", OperatorType::Assignment, 8, true, false };
-const Operator Operator::AssignmentDivision{ "/=", OperatorType::Assignment, 8, true, false };
+const Operator Operator::Assignment{ 19, "=", OperatorType::Assignment, 8, true, false };
+const Operator Operator::AssignmentAddition{ 20, "+=", OperatorType::Assignment, 8, true, false };
+const Operator Operator::AssignmentSubtraction{ 21, "-=", OperatorType::Assignment, 8, true, false };
+const Operator Operator::AssignmentMultiplication{ 22, "*=", OperatorType::Assignment, 8, true, false };
+const Operator Operator::AssignmentDivision{ 23, "/=", OperatorType::Assignment, 8, true, false };
 
 
 
@@ -321,14 +373,41 @@ Operation::Operation(const Operator& op, Statement* const op1, Statement* const
 	if (op3) _operands.push_back(op3);
 }
 
+Operation::Operation(const Operation& other) :
+	Statement{ other },
+	_operator{ other._operator },
+	_operands{}
+{
+	_operands.reserve(other._operands.size());
+	for (const Statement* const operand : other._operands)
+		_operands.push_back(operand->clone());
+}
+
 Operation::~Operation() { free_ptr_vector(_operands); }
 
+Operation& Operation::operator= (const Operation& other)
+{
+	if (this != &other)
+	{
+		free_ptr_vector(_operands);
+		_operator = other._operator;
+		for (const Statement* const operand : other._operands)
+			_operands.push_back(operand->clone());
+	}
+	return *this;
+}
+
 unsigned int Operation::getOperandCount() const { return _operands.size(); }
 
 const Operator& Operation::getOperator() const { return _operator; }
 
 const Statement& Operation::getOperand(const size_t idx) const { return *_operands[idx]; }
 
+Operation Operation::make(const Operator& op, Statement* const op1, Statement* const op2, Statement* const op3)
+{
+	return Operation{ op, op1, op2, op3 };
+}
+
 bool Operation::isUnary() const { return _operator.isUnary(); }
 bool Operation::isBinary() const { return _operator.isBinary(); }
 bool Operation::isTernary() const { return _operator.isTernary(); }
@@ -336,6 +415,16 @@ bool Operation::isAssignment() const { return _operator.isAssignment(); }
 
 CodeFragmentType Operation::getCodeFragmentType() const { return CodeFragmentType::Operation; }
 
+Statement* Operation::clone() const { return new Operation{ *this }; }
+
+size_t Operation::hash() const
+{
+	size_t seed = hash_combine(static_cast<size_t>(getCodeFragmentType()), _operator.hash());
+	for (const Statement* operand : _operands)
+		seed = hash_combine(seed, operand->hash());
+	return seed;
+}
+
 std::string Operation::toString() const
 {
 	if (_operator.isUnary())
@@ -352,15 +441,19 @@ std::string Operation::toString() const
 
 bool Operation::operator== (const CodeFragment& cf) const
 {
-	try
-	{
-		const Operation& other = dynamic_cast<const Operation&>(cf);
-		return *this == other;
-	}
-	catch (...) { return false; }
+	const Operation* const other = dynamic_cast<const Operation*>(&cf);
+	return other && *this == *other;
+}
+bool Operation::operator== (const Operation& other) const
+{
+	if (_operator != other._operator || _operands.size() != other._operands.size())
+		return false;
+	for (size_t i = 0; i < _operands.size(); ++i)
+		if (*_operands[i] != *other._operands[i])
+			return false;
+	return true;
 }
-bool Operation::operator== (const Operation& other) const { return _operator == other._operator && _operands == other._operands; }
-bool Operation::operator!= (const Operation& other) const { return _operator != other._operator || _operands != other._operands; }
+bool Operation::operator!= (const Operation& other) const { return !operator==(other); }
 
 
 
@@ -376,6 +469,14 @@ const Arguments& FunctionCall::getArguments() const { return _args; }
 
 CodeFragmentType FunctionCall::getCodeFragmentType() const { return CodeFragmentType::FunctionCall; }
 
+Statement* FunctionCall::clone() const { return new FunctionCall{ *this }; }
+
+size_t FunctionCall::hash() const
+{
+	const size_t seed = hash_combine(static_cast<size_t>(getCodeFragmentType()), std::hash<std::string>{}(_function->name()));
+	return hash_combine(seed, _args.hash());
+}
+
 std::string FunctionCall::toString() const
 {
 	return _function->name() + _args.toString();
@@ -383,12 +484,8 @@ std::string FunctionCall::toString() const
 
 bool FunctionCall::operator== (const CodeFragment& cf) const
 {
-	try
-	{
-		const FunctionCall& other = dynamic_cast<const FunctionCall&>(cf);
-		return *this == other;
-	}
-	catch (...) { return false; }
+	const FunctionCall* const other = dynamic_cast<const FunctionCall*>(&cf);
+	return other && *this == *other;
 }
 bool FunctionCall::operator== (const FunctionCall& other) const { return _function == other._function && _args == other._args; }
 bool FunctionCall::operator!= (const FunctionCall& other) const { return _function != other._function || _args != other._args; }
@@ -396,14 +493,6 @@ bool FunctionCall::operator!= (const FunctionCall& other) const { return _functi
 
 
 
-Command::Command(const std::string& name) :
-	_id{},
-	_name{ name }
-{
-	static uint8_t ids = 0;
-	_id = ids++;
-}
-
 bool Command::isStatement() const { return false; }
 
 CodeFragmentType Command::getCodeFragmentType() const { return CodeFragmentType::Command; }
@@ -412,23 +501,22 @@ std::string Command::toString() const { return _name; }
 
 bool Command::operator== (const CodeFragment& cf) const
 {
-	try
-	{
-		const Command& other = dynamic_cast<const Command&>(cf);
-		return *this == other;
-	}
-	catch (...) { return false; }
+	const Command* const other = dynamic_cast<const Command*>(&cf);
+	return other && *this == *other;
 }
 bool Command::operator== (const Command& other) const { return _id == other._id; }
 bool Command::operator!= (const Command& other) const { return _id != other._id; }
 
 
-const Command Command::Var{ "var" };
-const Command Command::Const{ "const" };
-const Command Command::Import{ "import" };
-const Command Command::If{ "var" };
-const Command Command::Else{ "var" };
-const Command Command::Every{ "var" };
+const Command Command::Var{ 0, "var" };
+const Command Command::Const{ 1, "const" };
+const Command Command::Define{ 2, "define" };
+const Command Command::Import{ 3, "import" };
+const Command Command::If{ 4, "if" };
+const Command Command::Else{ 5, "else" };
+const Command Command::Every{ 6, "every" };
+const Command Command::Match{ 7, "match" };
+const Command Command::Case{ 8, "case" };
 
 
 
@@ -447,12 +535,8 @@ std::string CommandArguments::toString() const { return _ArgumentsList::toString
 
 bool CommandArguments::operator== (const CodeFragment& cf) const
 {
-	try
-	{
-		const CommandArguments& other = dynamic_cast<const CommandArguments&>(cf);
-		return *this == other;
-	}
-	catch (...) { return false; }
+	const CommandArguments* const other = dynamic_cast<const CommandArguments*>(&cf);
+	return other && *this == *other;
 }
 bool CommandArguments::operator== (const CommandArguments& other) const { return _ArgumentsList::operator==(other); }
 bool CommandArguments::operator!= (const CommandArguments& other) const { return _ArgumentsList::operator!=(other); }
@@ -466,6 +550,15 @@ Scope::Scope() :
 	_instructions{}
 {}
 
+Scope::Scope(const Scope& other) :
+	Statement{ other },
+	_instructions{}
+{
+	_instructions.reserve(other._instructions.size());
+	for (const Instruction* const inst : other._instructions)
+		_instructions.push_back(static_cast<Instruction*>(inst->clone()));
+}
+
 Scope::~Scope()
 {
 	free_ptr_vector(_instructions);
@@ -484,16 +577,16 @@ Scope::const_iterator Scope::end() const { return _instructions.end(); }
 
 CodeFragmentType Scope::getCodeFragmentType() const { return CodeFragmentType::Scope; }
 
+Statement* Scope::clone() const { return new Scope{ *this }; }
+
+size_t Scope::hash() const { return hash_combine(static_cast<size_t>(getCodeFragmentType()), _instructions.size()); }
+
 std::string Scope::toString() const override;
 
 bool Scope::operator== (const CodeFragment& cf) const
 {
-	try
-	{
-		const Scope& other = dynamic_cast<const Scope&>(cf);
-		return *this == other;
-	}
-	catch (...) { return false; }
+	const Scope* const other = dynamic_cast<const Scope*>(&cf);
+	return other && *this == *other;
 }
 bool Scope::operator== (const Scope& other) const { return _instructions == other._instructions; }
 bool Scope::operator!= (const Scope& other) const { return _instructions == other._instructions; }
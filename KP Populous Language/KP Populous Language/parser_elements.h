@@ -1,11 +1,11 @@
 #pragma once
 
 #include <string>
-#include <regex>
 #include <exception>
 
 #include "datatypes.h"
 #include "functions.h"
+#include "result.h"
 
 enum class CodeFragmentType
 {
@@ -44,9 +44,15 @@ public:
 class Statement : public CodeFragment
 {
 public:
+	Statement();
+	Statement(const Statement&);
 	virtual ~Statement();
 
 	bool isStatement() const override;
+
+	virtual Statement* clone() const = 0;
+
+	virtual size_t hash() const = 0;
 };
 
 
@@ -63,6 +69,10 @@ public:
 
 	CodeFragmentType getCodeFragmentType() const override;
 
+	Statement* clone() const override;
+
+	size_t hash() const override;
+
 	std::string toString() const override;
 
 	bool operator== (const CodeFragment& cf) const override;
@@ -70,9 +80,8 @@ public:
 	bool operator!= (const Identifier& cf) const;
 
 public:
-	static const std::regex PATTERN;
+	static Result<Identifier> make(const std::string& identifier);
 
-public:
 	static bool isValid(const std::string& identifier);
 };
 
@@ -89,6 +98,10 @@ public:
 
 	CodeFragmentType getCodeFragmentType() const override;
 
+	Statement* clone() const override;
+
+	size_t hash() const override;
+
 	std::string toString() const override;
 
 	bool operator== (const CodeFragment& cf) const override;
@@ -97,8 +110,6 @@ public:
 
 	static LiteralInteger parse(const std::string& str);
 	static bool isValid(const std::string& str);
-
-	static const std::regex PATTERN;
 };
 
 
@@ -116,6 +127,10 @@ public:
 
 	CodeFragmentType getCodeFragmentType() const override;
 
+	Statement* clone() const override;
+
+	size_t hash() const override;
+
 	std::string toString() const override;
 
 	bool operator== (const CodeFragment& cf) const override;
@@ -145,7 +160,10 @@ public:
 	bool operator!= (const Stopchar& other) const;
 
 private:
-	Stopchar(const char symbol);
+	constexpr Stopchar(const char symbol) :
+		CodeFragment{},
+		_symbol{ symbol }
+	{}
 
 public:
 	static const Stopchar Semicolon;
@@ -162,8 +180,11 @@ private:
 
 public:
 	_ArgumentsList();
+	_ArgumentsList(const _ArgumentsList& other);
 	virtual ~_ArgumentsList();
 
+	_ArgumentsList& operator= (const _ArgumentsList& other);
+
 	bool empty() const;
 	size_t size() const;
 
@@ -178,6 +199,8 @@ public:
 
 	std::string toString() const;
 
+	size_t hash() const;
+
 	bool operator== (const _ArgumentsList& other) const;
 	bool operator!= (const _ArgumentsList& other) const;
 };
@@ -191,6 +214,10 @@ public:
 
 	CodeFragmentType getCodeFragmentType() const override;
 
+	Statement* clone() const override;
+
+	size_t hash() const override;
+
 	std::string toString() const override;
 
 	bool operator== (const CodeFragment& cf) const override;
@@ -212,13 +239,21 @@ class Operator : public CodeFragment
 {
 private:
 	uint8_t _id;
-	std::string _symbol;
+	const char* _symbol;
 	OperatorType _type;
 	unsigned int _priority;
 	bool _rightToLeft;
 	bool _conditional;
 
-	Operator(const std::string& symbol, const OperatorType type, unsigned int priority, bool rightToLeft, bool conditional);
+	constexpr Operator(const uint8_t id, const char* symbol, const OperatorType type, unsigned int priority, bool rightToLeft, bool conditional) :
+		CodeFragment{},
+		_id{ id },
+		_symbol{ symbol },
+		_type{ type },
+		_priority{ priority },
+		_rightToLeft{ rightToLeft },
+		_conditional{ conditional }
+	{}
 
 public:
 	unsigned int getPriority() const;
@@ -232,6 +267,8 @@ public:
 
 	int comparePriority(const Operator& other) const;
 
+	size_t hash() const;
+
 	bool isStatement() const override;
 
 	CodeFragmentType getCodeFragmentType() const override;
@@ -289,8 +326,11 @@ private:
 	std::vector<Statement*> _operands;
 
 public:
+	Operation(const Operation& other);
 	~Operation();
 
+	Operation& operator= (const Operation& other);
+
 	unsigned int getOperandCount() const;
 
 	const Operator& getOperator() const;
@@ -307,6 +347,10 @@ public:
 
 	CodeFragmentType getCodeFragmentType() const override;
 
+	Statement* clone() const override;
+
+	size_t hash() const override;
+
 	std::string toString() const override;
 
 	bool operator== (const CodeFragment& cf) const override;
@@ -317,6 +361,8 @@ private:
 	Operation(const Operator& op, Statement* const op1, Statement* const op2 = nullptr, Statement* const op3 = nullptr);
 
 public:
+	static Operation make(const Operator& op, Statement* const op1, Statement* const op2 = nullptr, Statement* const op3 = nullptr);
+
 	template<class _OpTy>
 	static Operation unary(const Operator& op, const _OpTy& operand)
 	{
@@ -370,6 +416,10 @@ public:
 
 	CodeFragmentType getCodeFragmentType() const override;
 
+	Statement* clone() const override;
+
+	size_t hash() const override;
+
 	std::string toString() const override;
 
 	bool operator== (const CodeFragment& cf) const override;
@@ -383,7 +433,7 @@ class Command : public CodeFragment
 {
 private:
 	uint8_t _id;
-	std::string _name;
+	const char* _name;
 
 public:
 	bool isStatement() const override;
@@ -397,7 +447,11 @@ public:
 	bool operator!= (const Command& other) const;
 
 private:
-	Command(const std::string& name);
+	constexpr Command(const uint8_t id, const char* name) :
+		CodeFragment{},
+		_id{ id },
+		_name{ name }
+	{}
 
 public:
 	static const Command Var;
@@ -407,6 +461,8 @@ public:
 	static const Command If;
 	static const Command Else;
 	static const Command Every;
+	static const Command Match;
+	static const Command Case;
 };
 
 
@@ -430,7 +486,7 @@ public:
 
 
 
-class Instruction;
+class Instruction : public Statement {};
 
 class Scope : public Statement
 {
@@ -442,15 +498,18 @@ private:
 
 public:
 	Scope();
+	Scope(const Scope& other);
 	~Scope();
 
+	Scope& operator= (const Scope&) = delete;
+
 	bool empty() const;
 	size_t size() const;
 
 	template<class _InstTy>
 	void add(const _InstTy& inst)
 	{
-		Instruction* ptr = new _InstTy{ arg };
+		Instruction* ptr = new _InstTy{ inst };
 		_instructions.push_back(ptr);
 	}
 
@@ -464,6 +523,10 @@ public:
 
 	CodeFragmentType getCodeFragmentType() const override;
 
+	Statement* clone() const override;
+
+	size_t hash() const override;
+
 	std::string toString() const override;
 
 	bool operator== (const CodeFragment& cf) const override;
@@ -0,0 +1,184 @@
+#include "profiler.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <map>
+#include <memory>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+namespace
+{
+	struct TraceEvent
+	{
+		const char* name;
+		uint64_t start;
+		uint64_t duration;
+	};
+
+	struct ThreadTrace
+	{
+		uint32_t tid;
+		std::mutex mutex;
+		std::vector<TraceEvent> events;
+	};
+
+	const char* const COUNTER_NAMES[] = { "allocations", "ast_nodes", "codes", "fields" };
+
+	std::atomic<bool> enabled{ false };
+	std::atomic<uint64_t> counters[static_cast<size_t>(ProfileCounter::Count)]{};
+
+	std::mutex tracesMutex{};
+	std::vector<std::unique_ptr<ThreadTrace>> traces{};
+
+	const std::chrono::steady_clock::time_point epoch{ std::chrono::steady_clock::now() };
+
+	ThreadTrace& thread_trace()
+	{
+		thread_local ThreadTrace* trace = nullptr;
+		if (!trace)
+		{
+			std::lock_guard<std::mutex> lock{ tracesMutex };
+			traces.emplace_back(new ThreadTrace{});
+			trace = traces.back().get();
+			trace->tid = static_cast<uint32_t>(traces.size());
+		}
+		return *trace;
+	}
+
+	void write_json_string(std::ostream& output, const char* str)
+	{
+		output << '"';
+		for (; *str; ++str)
+		{
+			if (*str == '"' || *str == '\\')
+				output << '\\';
+			output << *str;
+		}
+		output << '"';
+	}
+}
+
+
+bool Profiler::isEnabled() { return enabled.load(std::memory_order_relaxed); }
+void Profiler::setEnabled(bool enable) { enabled.store(enable, std::memory_order_relaxed); }
+
+uint64_t Profiler::now()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - epoch).count());
+}
+
+void Profiler::record(const char* name, uint64_t start, uint64_t end)
+{
+	ThreadTrace& trace = thread_trace();
+	std::lock_guard<std::mutex> lock{ trace.mutex };
+	trace.events.push_back({ name, start, end - start });
+}
+
+void Profiler::count(ProfileCounter counter, uint64_t amount)
+{
+	counters[static_cast<size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+}
+
+uint64_t Profiler::counter(ProfileCounter counter) { return counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed); }
+
+void Profiler::writeTrace(std::ostream& output)
+{
+	std::lock_guard<std::mutex> lock{ tracesMutex };
+
+	output << "{\"traceEvents\":[";
+	bool first = true;
+	for (const auto& trace : traces)
+	{
+		std::lock_guard<std::mutex> traceLock{ trace->mutex };
+		output << (first ? "" : ",") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << trace->tid
+			<< ",\"args\":{\"name\":\"worker " << trace->tid << "\"}}";
+		first = false;
+
+		for (const TraceEvent& event : trace->events)
+		{
+			output << ",{\"name\":";
+			write_json_string(output, event.name);
+			output << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << trace->tid
+				<< ",\"ts\":" << event.start << ",\"dur\":" << event.duration << "}";
+		}
+	}
+
+	output << (first ? "" : ",") << "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"ts\":" << now() << ",\"args\":{";
+	for (size_t i = 0; i < static_cast<size_t>(ProfileCounter::Count); ++i)
+		output << (i > 0 ? "," : "") << "\"" << COUNTER_NAMES[i] << "\":" << counters[i].load(std::memory_order_relaxed);
+	output << "}}]}" << std::endl;
+}
+
+bool Profiler::writeTraceToFile(const std::string& file)
+{
+	std::ofstream f{ file, std::ios::out | std::ios::trunc };
+	if (!f)
+		return false;
+	writeTrace(f);
+	return static_cast<bool>(f);
+}
+
+std::string Profiler::stats()
+{
+	struct Total
+	{
+		uint64_t calls;
+		uint64_t duration;
+	};
+
+	std::map<std::string, Total> totals{};
+	{
+		std::lock_guard<std::mutex> lock{ tracesMutex };
+		for (const auto& trace : traces)
+		{
+			std::lock_guard<std::mutex> traceLock{ trace->mutex };
+			for (const TraceEvent& event : trace->events)
+			{
+				Total& total = totals[event.name];
+				++total.calls;
+				total.duration += event.duration;
+			}
+		}
+	}
+
+	std::stringstream ss{};
+	ss << std::left << std::setw(32) << "phase" << std::right << std::setw(10) << "calls" << std::setw(14) << "total (us)" << std::endl;
+	for (const auto& total : totals)
+		ss << std::left << std::setw(32) << total.first << std::right << std::setw(10) << total.second.calls << std::setw(14) << total.second.duration << std::endl;
+
+	ss << std::endl;
+	for (size_t i = 0; i < static_cast<size_t>(ProfileCounter::Count); ++i)
+		ss << std::left << std::setw(32) << COUNTER_NAMES[i] << std::right << std::setw(10) << counters[i].load(std::memory_order_relaxed) << std::endl;
+
+	return ss.str();
+}
+
+void Profiler::reset()
+{
+	std::lock_guard<std::mutex> lock{ tracesMutex };
+	for (const auto& trace : traces)
+	{
+		std::lock_guard<std::mutex> traceLock{ trace->mutex };
+		trace->events.clear();
+	}
+	for (auto& counter : counters)
+		counter.store(0, std::memory_order_relaxed);
+}
+
+
+
+ProfileScope::ProfileScope(const char* name) :
+	_name{ Profiler::isEnabled() ? name : nullptr },
+	_start{ _name ? Profiler::now() : 0 }
+{}
+
+ProfileScope::~ProfileScope()
+{
+	if (_name)
+		Profiler::record(_name, _start, Profiler::now());
+}
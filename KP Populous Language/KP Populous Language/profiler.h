@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+#include <ostream>
+
+enum class ProfileCounter : uint8_t
+{
+	Allocations,
+	AstNodes,
+	Codes,
+	Fields,
+
+	Count
+};
+
+class Profiler
+{
+public:
+	static bool isEnabled();
+	static void setEnabled(bool enabled);
+
+	static uint64_t now();
+
+	static void record(const char* name, uint64_t start, uint64_t end);
+	static void count(ProfileCounter counter, uint64_t amount = 1);
+
+	static uint64_t counter(ProfileCounter counter);
+
+	static void writeTrace(std::ostream& output);
+	static bool writeTraceToFile(const std::string& file);
+
+	static std::string stats();
+
+	static void reset();
+};
+
+class ProfileScope
+{
+private:
+	const char* _name;
+	uint64_t _start;
+
+public:
+	ProfileScope(const char* name);
+	~ProfileScope();
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator= (const ProfileScope&) = delete;
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(__profile_scope_, __LINE__){ name }
+#define PROFILE_COUNT(counter, amount) do { if (Profiler::isEnabled()) Profiler::count(counter, amount); } while (0)
@@ -0,0 +1,31 @@
+#include "result.h"
+
+#include <sstream>
+
+Diagnostics::Diagnostics() :
+	_entries{}
+{}
+
+bool Diagnostics::empty() const { return _entries.empty(); }
+size_t Diagnostics::size() const { return _entries.size(); }
+
+void Diagnostics::report(const Error& error) { _entries.push_back({ error.code, error.message }); }
+void Diagnostics::report(const Error& error, const std::string& context)
+{
+	_entries.push_back({ error.code, context + ": " + error.message });
+}
+
+const Diagnostic& Diagnostics::operator[] (const size_t idx) const { return _entries[idx]; }
+
+Diagnostics::const_iterator Diagnostics::begin() const { return _entries.begin(); }
+Diagnostics::const_iterator Diagnostics::end() const { return _entries.end(); }
+
+void Diagnostics::clear() { _entries.clear(); }
+
+std::string Diagnostics::toString() const
+{
+	std::stringstream ss{};
+	for (const Diagnostic& diag : _entries)
+		ss << diag.message << std::endl;
+	return ss.str();
+}
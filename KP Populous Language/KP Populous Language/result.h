@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <optional>
+
+enum class ErrorCode : uint8_t
+{
+	None,
+	BadIndex,
+	InvalidBuilder,
+	FullCodeData,
+	FullFieldData,
+	TooManyVariables,
+	InvalidIdentifier,
+	InvalidPattern,
+	DuplicateMatchCase,
+	InvalidMatchCase,
+	NonExhaustiveMatch,
+	UndefinedIrValue,
+	InvalidIrInstruction,
+	InvalidIrRegion,
+	UnsupportedIr
+};
+
+struct Error
+{
+	ErrorCode code;
+	const char* message;
+};
+
+
+template<class _Ty>
+class Result
+{
+private:
+	std::optional<_Ty> _value;
+	Error _error;
+
+public:
+	Result(const _Ty& value) : _value{ value }, _error{ ErrorCode::None, "" } {}
+	Result(_Ty&& value) : _value{ std::move(value) }, _error{ ErrorCode::None, "" } {}
+	Result(const Error& error) : _value{}, _error{ error } {}
+
+	bool ok() const { return _value.has_value(); }
+
+	_Ty& value() { return *_value; }
+	const _Ty& value() const { return *_value; }
+
+	_Ty valueOr(const _Ty& defaultValue) const { return _value ? *_value : defaultValue; }
+
+	const Error& error() const { return _error; }
+
+	bool operator! () const { return !_value; }
+	explicit operator bool() const { return _value.has_value(); }
+};
+
+template<>
+class Result<void>
+{
+private:
+	Error _error;
+
+public:
+	Result() : _error{ ErrorCode::None, "" } {}
+	Result(const Error& error) : _error{ error } {}
+
+	bool ok() const { return _error.code == ErrorCode::None; }
+
+	const Error& error() const { return _error; }
+
+	bool operator! () const { return !ok(); }
+	explicit operator bool() const { return ok(); }
+};
+
+
+
+struct Diagnostic
+{
+	ErrorCode code;
+	std::string message;
+};
+
+class Diagnostics
+{
+	using const_iterator = std::vector<Diagnostic>::const_iterator;
+
+private:
+	std::vector<Diagnostic> _entries;
+
+public:
+	Diagnostics();
+
+	bool empty() const;
+	size_t size() const;
+
+	void report(const Error& error);
+	void report(const Error& error, const std::string& context);
+
+	template<class _Ty>
+	bool check(const Result<_Ty>& result)
+	{
+		if (result)
+			return true;
+		report(result.error());
+		return false;
+	}
+
+	const Diagnostic& operator[] (const size_t idx) const;
+
+	const_iterator begin() const;
+	const_iterator end() const;
+
+	void clear();
+
+	std::string toString() const;
+};
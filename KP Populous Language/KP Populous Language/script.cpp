@@ -2,6 +2,21 @@
 #include <cstring>
 #include <fstream>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCRIPT_SSE2
+#endif
+
+#include "profiler.h"
+
+namespace
+{
+	const Error BAD_CODE_INDEX{ ErrorCode::BadIndex, "Bad Index location in Script Codes" };
+	const Error BAD_FIELD_INDEX{ ErrorCode::BadIndex, "Bad Index location in Script Fields" };
+	const Error INVALID_BUILDER{ ErrorCode::InvalidBuilder, "Invalid Builder" };
+	const Error FULL_CODE_DATA{ ErrorCode::FullCodeData, "Script code data is full" };
+}
+
 BadIndex::BadIndex(const char* const message) :
 	exception{ message }
 {}
@@ -9,16 +24,31 @@ BadIndex::BadIndex(const char* const message) :
 
 ScriptCode& ScriptCodeAccessor::operator[] (int index)
 {
-	if (index < 0 || index >= MAX_CODES)
-		throw BadIndex{ "Bad Index location in Script Codes" };
-	return _codeData[index];
+	const Result<ScriptCode*> result = tryAt(index);
+	if (!result)
+		throw BadIndex{ result.error().message };
+	return *result.value();
 }
 
 const ScriptCode& ScriptCodeAccessor::operator[] (int index) const
 {
-	if (index < 0 || index >= MAX_CODES)
-		throw BadIndex{ "Bad Index location in Script Codes" };
-	return _codeData[index];
+	const Result<const ScriptCode*> result = tryAt(index);
+	if (!result)
+		throw BadIndex{ result.error().message };
+	return *result.value();
+}
+
+Result<ScriptCode*> ScriptCodeAccessor::tryAt(int index)
+{
+	if (index < 0 || index >= static_cast<int>(MAX_CODES))
+		return BAD_CODE_INDEX;
+	return _codeData + index;
+}
+Result<const ScriptCode*> ScriptCodeAccessor::tryAt(int index) const
+{
+	if (index < 0 || index >= static_cast<int>(MAX_CODES))
+		return BAD_CODE_INDEX;
+	return static_cast<const ScriptCode*>(_codeData + index);
 }
 
 ScriptCodeAccessor::ScriptCodeAccessor(ScriptCode* const data) :
@@ -31,16 +61,31 @@ ScriptCodeAccessor::ScriptCodeAccessor(const ScriptCode* const data) :
 
 ScriptField& ScriptFieldAccessor::operator[] (int index)
 {
-	if (index < 0 || index >= MAX_FIELDS)
-		throw BadIndex{ "Bad Index location in Script Fields" };
-	return _fieldData[index];
+	const Result<ScriptField*> result = tryAt(index);
+	if (!result)
+		throw BadIndex{ result.error().message };
+	return *result.value();
 }
 
 const ScriptField& ScriptFieldAccessor::operator[] (int index) const
 {
-	if (index < 0 || index >= MAX_FIELDS)
-		throw BadIndex{ "Bad Index location in Script Fields" };
-	return _fieldData[index];
+	const Result<const ScriptField*> result = tryAt(index);
+	if (!result)
+		throw BadIndex{ result.error().message };
+	return *result.value();
+}
+
+Result<ScriptField*> ScriptFieldAccessor::tryAt(int index)
+{
+	if (index < 0 || index >= static_cast<int>(MAX_FIELDS))
+		return BAD_FIELD_INDEX;
+	return _fieldData + index;
+}
+Result<const ScriptField*> ScriptFieldAccessor::tryAt(int index) const
+{
+	if (index < 0 || index >= static_cast<int>(MAX_FIELDS))
+		return BAD_FIELD_INDEX;
+	return static_cast<const ScriptField*>(_fieldData + index);
 }
 
 ScriptFieldAccessor::ScriptFieldAccessor(ScriptField* const data) :
@@ -58,18 +103,11 @@ Script::Script() :
 	clear();
 }
 
-ScriptCode& Script::code(int index)
-{
-	if (index < 0 || index >= MAX_CODES)
-		throw BadIndex{ "Bad Index location in Script Codes" };
-	return codeData[index];
-}
-const ScriptCode& Script::code(int index) const
-{
-	if (index < 0 || index >= MAX_CODES)
-		throw BadIndex{ "Bad Index location in Script Codes" };
-	return codeData[index];
-}
+ScriptCode& Script::code(int index) { return codes()[index]; }
+const ScriptCode& Script::code(int index) const { return codes()[index]; }
+
+Result<ScriptCode*> Script::tryCode(int index) { return codes().tryAt(index); }
+Result<const ScriptCode*> Script::tryCode(int index) const { return codes().tryAt(index); }
 
 void Script::setVersion()
 {
@@ -85,18 +123,67 @@ void Script::copyCodeDataFrom(Script& other)
 	setVersion();
 }
 
-ScriptField& Script::field(int index)
+uint16_t Script::findCode(ScriptCode code, uint16_t from) const
+{
+	unsigned int idx = from;
+#ifdef SCRIPT_SSE2
+	const __m128i needle = _mm_set1_epi16(static_cast<short>(code));
+	for (; idx + 8 <= MAX_CODES; idx += 8)
+	{
+		const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codeData + idx));
+		const int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(block, needle));
+		if (mask)
+		{
+			for (unsigned int bit = 0; bit < 16; bit += 2)
+				if (mask & (1 << bit))
+					return static_cast<uint16_t>(idx + bit / 2);
+		}
+	}
+#endif
+	for (; idx < MAX_CODES; ++idx)
+		if (codeData[idx] == code)
+			return static_cast<uint16_t>(idx);
+	return MAX_CODES;
+}
+
+uint16_t Script::length() const
 {
-	if (index < 0 || index >= MAX_FIELDS)
-		throw BadIndex{ "Bad Index location in Script Fields" };
-	return fieldData[index];
+	const uint16_t end = findCode(InstructionToken::ScriptEnd, 1);
+	return end < MAX_CODES ? end + 1 : MAX_CODES;
 }
 
-const ScriptField& Script::field(int index) const
+ScriptField& Script::field(int index) { return fields()[index]; }
+const ScriptField& Script::field(int index) const { return fields()[index]; }
+
+Result<ScriptField*> Script::tryField(int index) { return fields().tryAt(index); }
+Result<const ScriptField*> Script::tryField(int index) const { return fields().tryAt(index); }
+
+uint16_t Script::findField(const ScriptField& field) const
 {
-	if (index < 0 || index >= MAX_FIELDS)
-		throw BadIndex{ "Bad Index location in Script Fields" };
-	return fieldData[index];
+	if (field.isInvalid())
+		return MAX_FIELDS;
+
+	for (uint16_t idx = 0; idx < MAX_FIELDS; ++idx)
+		if (fieldData[idx].type == field.type && fieldData[idx].value == field.value)
+			return idx;
+	return MAX_FIELDS;
+}
+
+uint16_t Script::addField(const ScriptField& field)
+{
+	const uint16_t found = findField(field);
+	if (found < MAX_FIELDS)
+		return found;
+
+	for (uint16_t idx = 0; idx < MAX_FIELDS; ++idx)
+	{
+		if (fieldData[idx].isInvalid())
+		{
+			fieldData[idx] = field;
+			return idx;
+		}
+	}
+	return MAX_FIELDS;
 }
 
 void Script::clear()
@@ -112,7 +199,7 @@ ScriptFieldAccessor Script::fields() { return { fieldData }; }
 const ScriptFieldAccessor Script::fields() const { return { fieldData }; }
 
 
-void Script::read(std::istream& input)
+bool Script::read(std::istream& input)
 {
 	clear();
 
@@ -120,6 +207,7 @@ void Script::read(std::istream& input)
 		input.read(reinterpret_cast<char*>(codeData), sizeof(codeData));
 	if (input && !input.eof())
 		input.read(reinterpret_cast<char*>(fieldData), sizeof(fieldData));
+	return static_cast<bool>(input);
 }
 
 void Script::write(std::ostream& output) const
@@ -129,15 +217,16 @@ void Script::write(std::ostream& output) const
 }
 
 
-void Script::readFromFile(const std::string& file)
+bool Script::readFromFile(const std::string& file)
 {
 	std::fstream f{ file, std::ios::in | std::ios::binary };
-	read(f);
-	f.close();
+	return f && read(f);
 }
 
 void Script::writeToFile(const std::string& file) const
 {
+	PROFILE_SCOPE("Script::writeToFile");
+
 	std::fstream f{ file, std::ios::out | std::ios::binary };
 	write(f);
 	if (f)
@@ -145,6 +234,40 @@ void Script::writeToFile(const std::string& file) const
 	f.close();
 }
 
+int Script::blockDelta(ScriptCode code)
+{
+	switch (code)
+	{
+		case InstructionToken::If:
+		case InstructionToken::Begin:
+			return 1;
+		case InstructionToken::Endif:
+		case InstructionToken::End:
+			return -1;
+		default:
+			return 0;
+	}
+}
+
+bool Script::isConditionCode(ScriptCode code)
+{
+	if (code < TOKEN_OFFSET)
+		return true;
+
+	switch (code)
+	{
+		case InstructionToken::And:
+		case InstructionToken::Or:
+		case InstructionToken::Multiply:
+		case InstructionToken::Divide:
+		case InstructionToken::ExpStart:
+		case InstructionToken::ExpEnd:
+			return true;
+		default:
+			return code >= InstructionToken::GreaterThan && code <= InstructionToken::LessThanEqualTo;
+	}
+}
+
 
 
 
@@ -173,43 +296,50 @@ void ScriptCodeBuilder::clear()
 	_size = 0;
 }
 
-CodeLocation ScriptCodeBuilder::push_back(const ScriptCode code)
+CodeLocation ScriptCodeBuilder::push_back(const ScriptCode code) { return unwrap(try_push_back(code)); }
+CodeLocation ScriptCodeBuilder::push_front(const ScriptCode code) { return unwrap(try_push_front(code)); }
+
+Result<CodeLocation> ScriptCodeBuilder::try_push_back(const ScriptCode code)
 {
 	if (_size >= MAX_CODES)
-		throw FullCodeData{};
+		return FULL_CODE_DATA;
 
 	if (!_front)
 	{
 		_front = new Node{ this, code, nullptr, nullptr };
+		PROFILE_COUNT(ProfileCounter::Allocations, 1);
 		_back = _front;
 		++_size;
-		return _front;
+		return static_cast<CodeLocation>(_front);
 	}
 
 	Node* const node{ new Node{ this, code, nullptr, _back } };
+	PROFILE_COUNT(ProfileCounter::Allocations, 1);
 	_back->next = node;
 	_back = node;
 	++_size;
-	return node;
+	return static_cast<CodeLocation>(node);
 }
-CodeLocation ScriptCodeBuilder::push_front(const ScriptCode code)
+Result<CodeLocation> ScriptCodeBuilder::try_push_front(const ScriptCode code)
 {
 	if (_size >= MAX_CODES)
-		throw FullCodeData{};
+		return FULL_CODE_DATA;
 
 	if (!_front)
 	{
 		_front = new Node{ this, code, nullptr, nullptr };
+		PROFILE_COUNT(ProfileCounter::Allocations, 1);
 		_back = _front;
 		++_size;
-		return _front;
+		return static_cast<CodeLocation>(_front);
 	}
 
 	Node* const node{ new Node{ this, code, _front, nullptr } };
+	PROFILE_COUNT(ProfileCounter::Allocations, 1);
 	_front->prev = node;
 	_front = node;
 	++_size;
-	return node;
+	return static_cast<CodeLocation>(node);
 }
 
 ScriptCode& ScriptCodeBuilder::front() { return _front->code; }
@@ -218,49 +348,125 @@ const ScriptCode& ScriptCodeBuilder::front() const { return _front->code; }
 ScriptCode& ScriptCodeBuilder::back() { return _back->code; }
 const ScriptCode& ScriptCodeBuilder::back() const { return _back->code; }
 
-CodeLocation ScriptCodeBuilder::insert_before(const CodeLocation location, const ScriptCode code)
+CodeLocation ScriptCodeBuilder::insert_before(const CodeLocation location, const ScriptCode code) { return unwrap(try_insert_before(location, code)); }
+CodeLocation ScriptCodeBuilder::insert_after(const CodeLocation location, const ScriptCode code) { return unwrap(try_insert_after(location, code)); }
+
+Result<CodeLocation> ScriptCodeBuilder::try_insert_before(const CodeLocation location, const ScriptCode code)
 {
 	if (location->builder != this)
-		throw BadIndex{ "Invalid Builder" };
+		return INVALID_BUILDER;
 	if (_size >= MAX_CODES)
-		throw FullCodeData{};
+		return FULL_CODE_DATA;
 	
 	Node* const base = const_cast<Node*>(location);
 	if (!base->prev)
-		return push_front(code);
+		return try_push_front(code);
 
 	Node* node{ new Node{ this, code, base, base->prev } };
+	PROFILE_COUNT(ProfileCounter::Allocations, 1);
 	base->prev->next = node;
 	base->prev = node;
 	++_size;
-	return node;
+	return static_cast<CodeLocation>(node);
 }
-CodeLocation ScriptCodeBuilder::insert_after(const CodeLocation location, const ScriptCode code)
+Result<CodeLocation> ScriptCodeBuilder::try_insert_after(const CodeLocation location, const ScriptCode code)
 {
 	if (location->builder != this)
-		throw BadIndex{ "Invalid Builder" };
+		return INVALID_BUILDER;
 	if (_size >= MAX_CODES)
-		throw FullCodeData{};
+		return FULL_CODE_DATA;
 
 	Node* const base = const_cast<Node*>(location);
 	if (!base->next)
-		return push_back(code);
+		return try_push_back(code);
 
 	Node* node{ new Node{ this, code, base->next, base } };
+	PROFILE_COUNT(ProfileCounter::Allocations, 1);
 	base->next->prev = node;
 	base->next = node;
 	++_size;
-	return node;
+	return static_cast<CodeLocation>(node);
+}
+
+CodeLocation ScriptCodeBuilder::unwrap(const Result<CodeLocation>& result)
+{
+	if (result)
+		return result.value();
+	if (result.error().code == ErrorCode::FullCodeData)
+		throw FullCodeData{};
+	throw BadIndex{ result.error().message };
 }
 
 uint16_t ScriptCodeBuilder::size() const { return _size; }
 bool ScriptCodeBuilder::empty() const { return _size <= 0; }
 
-void ScriptCodeBuilder::build(Script& script) const
+void ScriptCodeBuilder::build(Script& script) const { build(script, 0); }
+
+uint16_t ScriptCodeBuilder::build(Script& script, const uint16_t offset) const
 {
+	PROFILE_SCOPE("ScriptCodeBuilder::build");
+
 	auto accessor = script.codes();
-	uint16_t count = 0;
+	uint16_t count = offset;
 	for (Node* node = _front; node && count < MAX_CODES; node = node->next)
 		accessor[count++] = node->code;
+
+	PROFILE_COUNT(ProfileCounter::Codes, count - offset);
+	return count - offset;
+}
+
+void ScriptCodeBuilder::build(std::vector<ScriptCode>& codes) const
+{
+	codes.clear();
+	codes.reserve(_size);
+	for (Node* node = _front; node; node = node->next)
+		codes.push_back(node->code);
+}
+
+
+
+
+ScriptCodeStream::ScriptCodeStream(Script& script, const uint16_t offset) :
+	_script{ &script },
+	_offset{ offset }
+{}
+
+uint16_t ScriptCodeStream::size() const { return _offset; }
+bool ScriptCodeStream::empty() const { return _offset <= 0; }
+
+void ScriptCodeStream::reset(const uint16_t offset) { _offset = offset; }
+
+void ScriptCodeStream::flush(ScriptCodeBuilder& fragment)
+{
+	if (!tryFlush(fragment))
+		throw FullCodeData{};
+}
+
+void ScriptCodeStream::write(const std::vector<ScriptCode>& codes)
+{
+	if (!tryWrite(codes))
+		throw FullCodeData{};
+}
+
+Result<void> ScriptCodeStream::tryFlush(ScriptCodeBuilder& fragment)
+{
+	if (static_cast<unsigned int>(_offset) + fragment.size() > MAX_CODES)
+		return FULL_CODE_DATA;
+
+	_offset += fragment.build(*_script, _offset);
+	fragment.clear();
+	return {};
+}
+
+Result<void> ScriptCodeStream::tryWrite(const std::vector<ScriptCode>& codes)
+{
+	if (_offset + codes.size() > MAX_CODES)
+		return FULL_CODE_DATA;
+
+	for (const ScriptCode code : codes)
+		_script->codeData[_offset++] = code;
+
+	PROFILE_COUNT(ProfileCounter::Codes, codes.size());
+	return {};
 }
 
@@ -10,8 +10,10 @@
 #include <string>
 #include <istream>
 #include <ostream>
+#include <vector>
 
 #include "config_and_consts.h"
+#include "result.h"
 
 #define CODES_ARRAY_SIZE (MAX_CODES * sizeof(ScriptCode))
 #define FIELDS_ARRAY_SIZE (MAX_FIELDS * sizeof(ScriptField))
@@ -35,6 +37,9 @@ public:
 	ScriptCode& operator[] (int index);
 	const ScriptCode& operator[] (int index) const;
 
+	Result<ScriptCode*> tryAt(int index);
+	Result<const ScriptCode*> tryAt(int index) const;
+
 	friend struct Script;
 
 private:
@@ -51,6 +56,9 @@ public:
 	ScriptField& operator[] (int index);
 	const ScriptField& operator[] (int index) const;
 
+	Result<ScriptField*> tryAt(int index);
+	Result<const ScriptField*> tryAt(int index) const;
+
 	friend struct Script;
 
 private:
@@ -76,6 +84,9 @@ struct Script
 	ScriptCode& code(int index);
 	const ScriptCode& code(int index) const;
 
+	Result<ScriptCode*> tryCode(int index);
+	Result<const ScriptCode*> tryCode(int index) const;
+
 	ScriptCodeAccessor codes();
 	const ScriptCodeAccessor codes() const;
 
@@ -84,38 +95,48 @@ struct Script
 
 	void copyCodeDataFrom(Script& other);
 
+	uint16_t findCode(ScriptCode code, uint16_t from = 0) const;
+	uint16_t length() const;
+
 	ScriptField& field(int index);
 	const ScriptField& field(int index) const;
 
+	Result<ScriptField*> tryField(int index);
+	Result<const ScriptField*> tryField(int index) const;
+
+	uint16_t findField(const ScriptField& field) const;
+	uint16_t addField(const ScriptField& field);
+
 	ScriptFieldAccessor fields();
 	const ScriptFieldAccessor fields() const;
 
 	void clear();
 
-	void read(std::istream& input);
+	bool read(std::istream& input);
 	void write(std::ostream& output) const;
 
-	void readFromFile(const std::string& file);
+	bool readFromFile(const std::string& file);
 	void writeToFile(const std::string& file) const;
 
+public:
+	static int blockDelta(ScriptCode code);
+	static bool isConditionCode(ScriptCode code);
 };
 
 
 
 class FullCodeData : public std::exception {};
+class FullFieldData : public std::exception {};
 
 
 class ScriptCodeBuilder;
-namespace
+struct ScriptCodeBuilderNode
 {
-	struct ScriptCodeBuilderNode
-	{
-		const ScriptCodeBuilder* const builder;
-		ScriptCode code;
-		ScriptCodeBuilderNode* next;
-		ScriptCodeBuilderNode* prev;
-	};
-}
+	const ScriptCodeBuilder* const builder;
+	ScriptCode code;
+	ScriptCodeBuilderNode* next;
+	ScriptCodeBuilderNode* prev;
+};
 typedef const ScriptCodeBuilderNode* CodeLocation;
 
 
@@ -137,6 +158,9 @@ public:
 	CodeLocation push_back(const ScriptCode code);
 	CodeLocation push_front(const ScriptCode code);
 
+	Result<CodeLocation> try_push_back(const ScriptCode code);
+	Result<CodeLocation> try_push_front(const ScriptCode code);
+
 	ScriptCode& front();
 	const ScriptCode& front() const;
 
@@ -146,14 +170,44 @@ public:
 	CodeLocation insert_before(const CodeLocation location, const ScriptCode code);
 	CodeLocation insert_after(const CodeLocation location, const ScriptCode code);
 
+	Result<CodeLocation> try_insert_before(const CodeLocation location, const ScriptCode code);
+	Result<CodeLocation> try_insert_after(const CodeLocation location, const ScriptCode code);
+
 	uint16_t size() const;
 	bool empty() const;
 
 	void build(Script& script) const;
+	uint16_t build(Script& script, const uint16_t offset) const;
+	void build(std::vector<ScriptCode>& codes) const;
 
 
 	constexpr ScriptCode& code(const CodeLocation location) { return const_cast<Node*>(location)->code; }
 	constexpr const ScriptCode& code(const CodeLocation location) const { return location->code; }
+
+private:
+	static CodeLocation unwrap(const Result<CodeLocation>& result);
+};
+
+
+class ScriptCodeStream
+{
+private:
+	Script* const _script;
+	uint16_t _offset;
+
+public:
+	ScriptCodeStream(Script& script, const uint16_t offset = 0);
+
+	uint16_t size() const;
+	bool empty() const;
+
+	void reset(const uint16_t offset = 0);
+
+	void flush(ScriptCodeBuilder& fragment);
+	void write(const std::vector<ScriptCode>& codes);
+
+	Result<void> tryFlush(ScriptCodeBuilder& fragment);
+	Result<void> tryWrite(const std::vector<ScriptCode>& codes);
 };
 
 
@@ -0,0 +1,349 @@
+#include "script_archive.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "compression.h"
+#include "profiler.h"
+
+namespace
+{
+	const char MAGIC[4] = { 'K', 'P', 'S', 'A' };
+	const uint8_t FORMAT_VERSION = 1;
+	const uint32_t END_OF_RECORDS = 0;
+	const size_t FOOTER_SIZE = sizeof(uint64_t) + sizeof(MAGIC);
+	const size_t MAX_IMAGE_SIZE = 2 * sizeof(uint16_t) + CODES_ARRAY_SIZE + FIELDS_ARRAY_SIZE;
+	const size_t MAX_COMPRESSED_SIZE = MAX_IMAGE_SIZE + MAX_IMAGE_SIZE / 255 + 16;
+
+	void append_varint(std::vector<uint8_t>& output, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			output.push_back(static_cast<uint8_t>((value & 0x7f) | 0x80));
+			value >>= 7;
+		}
+		output.push_back(static_cast<uint8_t>(value));
+	}
+
+	uint64_t read_varint(std::istream& input)
+	{
+		uint64_t value = 0;
+		for (unsigned int shift = 0; shift < 64; shift += 7)
+		{
+			const int c = input.get();
+			if (c == std::char_traits<char>::eof())
+				throw BadScriptArchive{};
+			value |= static_cast<uint64_t>(c & 0x7f) << shift;
+			if (!(c & 0x80))
+				return value;
+		}
+		throw BadScriptArchive{};
+	}
+
+	uint64_t read_size(std::istream& input, uint64_t limit)
+	{
+		const uint64_t size = read_varint(input);
+		if (size > limit)
+			throw BadScriptArchive{};
+		return size;
+	}
+
+	void read_bytes(std::istream& input, void* data, size_t size)
+	{
+		if (size > 0 && !input.read(reinterpret_cast<char*>(data), size))
+			throw BadScriptArchive{};
+	}
+
+	std::string read_name(std::istream& input, uint64_t length)
+	{
+		if (length > 0xffff)
+			throw BadScriptArchive{};
+		std::string name(static_cast<size_t>(length), '\0');
+		read_bytes(input, &name[0], name.size());
+		return name;
+	}
+
+	void read_header(std::istream& input)
+	{
+		char magic[sizeof(MAGIC)];
+		read_bytes(input, magic, sizeof(magic));
+		if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || input.get() != FORMAT_VERSION)
+			throw BadScriptArchive{};
+	}
+
+	std::vector<uint8_t> trimmed_image(const Script& script)
+	{
+		uint16_t codes = MAX_CODES;
+		while (codes > 0 && script.codeData[codes - 1] == 0)
+			--codes;
+
+		uint16_t fields = MAX_FIELDS;
+		const ScriptField invalid = ScriptField::invalid();
+		while (fields > 0 && std::memcmp(&script.fieldData[fields - 1], &invalid, sizeof(ScriptField)) == 0)
+			--fields;
+
+		std::vector<uint8_t> image(2 * sizeof(uint16_t) + codes * sizeof(ScriptCode) + fields * sizeof(ScriptField));
+		uint8_t* ptr = image.data();
+		std::memcpy(ptr, &codes, sizeof(codes));
+		std::memcpy(ptr += sizeof(codes), &fields, sizeof(fields));
+		std::memcpy(ptr += sizeof(fields), script.codeData, codes * sizeof(ScriptCode));
+		std::memcpy(ptr + codes * sizeof(ScriptCode), script.fieldData, fields * sizeof(ScriptField));
+		return image;
+	}
+
+	void restore_image(const std::vector<uint8_t>& image, Script& script)
+	{
+		uint16_t codes, fields;
+		if (image.size() < sizeof(codes) + sizeof(fields))
+			throw BadScriptArchive{};
+		std::memcpy(&codes, image.data(), sizeof(codes));
+		std::memcpy(&fields, image.data() + sizeof(codes), sizeof(fields));
+		if (codes > MAX_CODES || fields > MAX_FIELDS ||
+			image.size() != sizeof(codes) + sizeof(fields) + codes * sizeof(ScriptCode) + fields * sizeof(ScriptField))
+			throw BadScriptArchive{};
+
+		script.clear();
+		const uint8_t* ptr = image.data() + sizeof(codes) + sizeof(fields);
+		std::memcpy(script.codeData, ptr, codes * sizeof(ScriptCode));
+		std::memcpy(script.fieldData, ptr + codes * sizeof(ScriptCode), fields * sizeof(ScriptField));
+	}
+
+	void read_blob(std::istream& input, const ScriptArchiveBlob& blob, Script& script)
+	{
+		if (blob.rawSize > MAX_IMAGE_SIZE || blob.compressedSize > MAX_COMPRESSED_SIZE)
+			throw BadScriptArchive{};
+
+		std::vector<uint8_t> compressed(blob.compressedSize);
+		read_bytes(input, compressed.data(), compressed.size());
+
+		std::vector<uint8_t> image{};
+		if (!lz_decompress(compressed.data(), compressed.size(), image, blob.rawSize))
+			throw BadScriptArchive{};
+		restore_image(image, script);
+	}
+}
+
+
+
+
+ScriptArchiveWriter::ScriptArchiveWriter(std::ostream& output) :
+	_output{ &output },
+	_position{ 0 },
+	_blobs{},
+	_entries{},
+	_hashes{},
+	_compressed{},
+	_finished{ false }
+{
+	write(MAGIC, sizeof(MAGIC));
+	write(&FORMAT_VERSION, sizeof(FORMAT_VERSION));
+}
+
+ScriptArchiveWriter::~ScriptArchiveWriter()
+{
+	if (!_finished)
+		finish();
+}
+
+bool ScriptArchiveWriter::add(const std::string& name, const Script& script)
+{
+	PROFILE_SCOPE("ScriptArchiveWriter::add");
+
+	if (_finished || name.empty() || name.size() > 0xffff)
+		throw BadScriptArchive{};
+
+	const std::vector<uint8_t> image = trimmed_image(script);
+	ContentHasher hasher{};
+	hasher.update(image.data(), image.size());
+
+	std::vector<uint8_t> compressed = lz_compress(image.data(), image.size());
+	const auto& it = _hashes.find(hasher.hash());
+	const bool unique = it == _hashes.end() || _compressed[it->second] != compressed;
+	const uint32_t blob = unique ? static_cast<uint32_t>(_blobs.size()) : it->second;
+	_entries.push_back({ name, blob });
+
+	std::vector<uint8_t> record{};
+	append_varint(record, name.size());
+	record.insert(record.end(), name.begin(), name.end());
+	append_varint(record, blob);
+
+	if (!unique)
+	{
+		write(record.data(), record.size());
+		return false;
+	}
+
+	append_varint(record, image.size());
+	append_varint(record, compressed.size());
+	write(record.data(), record.size());
+
+	_blobs.push_back({ _position, static_cast<uint32_t>(image.size()), static_cast<uint32_t>(compressed.size()) });
+	_hashes.emplace(hasher.hash(), blob);
+	write(compressed.data(), compressed.size());
+	_compressed.push_back(std::move(compressed));
+	return true;
+}
+
+void ScriptArchiveWriter::finish()
+{
+	if (_finished)
+		return;
+	_finished = true;
+
+	std::vector<uint8_t> index{};
+	append_varint(index, END_OF_RECORDS);
+	const uint64_t indexOffset = _position + index.size();
+
+	append_varint(index, _blobs.size());
+	for (const ScriptArchiveBlob& blob : _blobs)
+	{
+		append_varint(index, blob.offset);
+		append_varint(index, blob.rawSize);
+		append_varint(index, blob.compressedSize);
+	}
+	append_varint(index, _entries.size());
+	for (const ScriptArchiveEntry& entry : _entries)
+	{
+		append_varint(index, entry.name.size());
+		index.insert(index.end(), entry.name.begin(), entry.name.end());
+		append_varint(index, entry.blob);
+	}
+	write(index.data(), index.size());
+
+	uint8_t footer[FOOTER_SIZE];
+	for (size_t i = 0; i < sizeof(uint64_t); ++i)
+		footer[i] = static_cast<uint8_t>(indexOffset >> (i * 8));
+	std::memcpy(footer + sizeof(uint64_t), MAGIC, sizeof(MAGIC));
+	write(footer, sizeof(footer));
+	_output->flush();
+}
+
+size_t ScriptArchiveWriter::size() const { return _entries.size(); }
+size_t ScriptArchiveWriter::blobCount() const { return _blobs.size(); }
+
+void ScriptArchiveWriter::write(const void* data, size_t size)
+{
+	_output->write(reinterpret_cast<const char*>(data), size);
+	_position += size;
+}
+
+
+
+
+ScriptArchiveReader::ScriptArchiveReader(std::istream& input) :
+	_input{ &input },
+	_blobs{},
+	_entries{},
+	_names{}
+{
+	input.seekg(0, std::ios::beg);
+	read_header(input);
+
+	input.seekg(-static_cast<std::streamoff>(FOOTER_SIZE), std::ios::end);
+	const std::streamoff footerOffset = input.tellg();
+	if (footerOffset < 0)
+		throw BadScriptArchive{};
+	const uint64_t indexEnd = static_cast<uint64_t>(footerOffset);
+
+	uint8_t footer[FOOTER_SIZE];
+	read_bytes(input, footer, sizeof(footer));
+	if (std::memcmp(footer + sizeof(uint64_t), MAGIC, sizeof(MAGIC)) != 0)
+		throw BadScriptArchive{};
+
+	uint64_t indexOffset = 0;
+	for (size_t i = 0; i < sizeof(uint64_t); ++i)
+		indexOffset |= static_cast<uint64_t>(footer[i]) << (i * 8);
+	if (indexOffset > indexEnd)
+		throw BadScriptArchive{};
+	input.seekg(static_cast<std::streamoff>(indexOffset), std::ios::beg);
+
+	_blobs.resize(static_cast<size_t>(read_size(input, (indexEnd - indexOffset) / 3)));
+	for (ScriptArchiveBlob& blob : _blobs)
+	{
+		blob.offset = read_size(input, indexOffset);
+		blob.rawSize = static_cast<uint32_t>(read_size(input, MAX_IMAGE_SIZE));
+		blob.compressedSize = static_cast<uint32_t>(read_size(input, std::min<uint64_t>(MAX_COMPRESSED_SIZE, indexOffset - blob.offset)));
+	}
+
+	_entries.resize(static_cast<size_t>(read_size(input, (indexEnd - indexOffset) / 2)));
+	_names.reserve(_entries.size());
+	for (size_t i = 0; i < _entries.size(); ++i)
+	{
+		_entries[i].name = read_name(input, read_varint(input));
+		_entries[i].blob = static_cast<uint32_t>(read_varint(input));
+		if (_entries[i].blob >= _blobs.size())
+			throw BadScriptArchive{};
+		_names[_entries[i].name] = i;
+	}
+}
+
+size_t ScriptArchiveReader::size() const { return _entries.size(); }
+size_t ScriptArchiveReader::blobCount() const { return _blobs.size(); }
+
+bool ScriptArchiveReader::contains(const std::string& name) const { return _names.find(name) != _names.end(); }
+
+const ScriptArchiveEntry& ScriptArchiveReader::entry(size_t index) const
+{
+	if (index >= _entries.size())
+		throw BadIndex{ "Archive entry index out of range" };
+	return _entries[index];
+}
+
+const std::vector<ScriptArchiveEntry>& ScriptArchiveReader::entries() const { return _entries; }
+
+bool ScriptArchiveReader::extract(const std::string& name, Script& script)
+{
+	const auto& it = _names.find(name);
+	if (it == _names.end())
+		return false;
+	extract(it->second, script);
+	return true;
+}
+
+void ScriptArchiveReader::extract(size_t index, Script& script)
+{
+	PROFILE_SCOPE("ScriptArchiveReader::extract");
+
+	const ScriptArchiveBlob& blob = _blobs[entry(index).blob];
+	_input->clear();
+	_input->seekg(static_cast<std::streamoff>(blob.offset), std::ios::beg);
+	read_blob(*_input, blob, script);
+}
+
+void ScriptArchiveReader::stream(std::istream& input, const std::function<void(const std::string&, const Script&)>& callback)
+{
+	read_header(input);
+
+	std::vector<ScriptArchiveBlob> blobs{};
+	Script script{};
+	for (;;)
+	{
+		const uint64_t length = read_varint(input);
+		if (length == END_OF_RECORDS)
+			break;
+
+		const std::string name = read_name(input, length);
+		const uint64_t blob = read_varint(input);
+		if (blob > blobs.size())
+			throw BadScriptArchive{};
+
+		if (blob == blobs.size())
+		{
+			const uint32_t rawSize = static_cast<uint32_t>(read_size(input, MAX_IMAGE_SIZE));
+			const uint32_t compressedSize = static_cast<uint32_t>(read_size(input, MAX_COMPRESSED_SIZE));
+			blobs.push_back({ static_cast<uint64_t>(input.tellg()), rawSize, compressedSize });
+			read_blob(input, blobs.back(), script);
+		}
+		else
+		{
+			const std::streamoff resume = input.tellg();
+			if (resume < 0)
+				throw BadScriptArchive{};
+			input.seekg(static_cast<std::streamoff>(blobs[static_cast<size_t>(blob)].offset), std::ios::beg);
+			read_blob(input, blobs[static_cast<size_t>(blob)], script);
+			input.seekg(resume, std::ios::beg);
+		}
+
+		callback(name, script);
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <functional>
+#include <istream>
+#include <ostream>
+
+#include "script.h"
+#include "content_hash.h"
+
+struct ScriptArchiveBlob
+{
+	uint64_t offset;
+	uint32_t rawSize;
+	uint32_t compressedSize;
+};
+
+struct ScriptArchiveEntry
+{
+	std::string name;
+	uint32_t blob;
+};
+
+class ScriptArchiveWriter
+{
+private:
+	std::ostream* const _output;
+	uint64_t _position;
+	std::vector<ScriptArchiveBlob> _blobs;
+	std::vector<ScriptArchiveEntry> _entries;
+	std::map<ContentHash, uint32_t> _hashes;
+	std::vector<std::vector<uint8_t>> _compressed;
+	bool _finished;
+
+public:
+	ScriptArchiveWriter(std::ostream& output);
+	~ScriptArchiveWriter();
+
+	ScriptArchiveWriter(const ScriptArchiveWriter&) = delete;
+	ScriptArchiveWriter& operator= (const ScriptArchiveWriter&) = delete;
+
+	bool add(const std::string& name, const Script& script);
+
+	void finish();
+
+	size_t size() const;
+	size_t blobCount() const;
+
+private:
+	void write(const void* data, size_t size);
+};
+
+class ScriptArchiveReader
+{
+private:
+	std::istream* const _input;
+	std::vector<ScriptArchiveBlob> _blobs;
+	std::vector<ScriptArchiveEntry> _entries;
+	std::unordered_map<std::string, size_t> _names;
+
+public:
+	ScriptArchiveReader(std::istream& input);
+
+	size_t size() const;
+	size_t blobCount() const;
+
+	bool contains(const std::string& name) const;
+	const ScriptArchiveEntry& entry(size_t index) const;
+	const std::vector<ScriptArchiveEntry>& entries() const;
+
+	bool extract(const std::string& name, Script& script);
+	void extract(size_t index, Script& script);
+
+public:
+	static void stream(std::istream& input, const std::function<void(const std::string&, const Script&)>& callback);
+};
+
+class BadScriptArchive : public std::exception {};
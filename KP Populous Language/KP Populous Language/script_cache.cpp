@@ -0,0 +1,184 @@
+#include "script_cache.h"
+
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+
+#include "content_hash.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	const char* const ENTRY_EXTENSION = ".scr";
+}
+
+
+ScriptCache::ScriptCache(const std::string& root, uintmax_t capacity) :
+	_root{ root },
+	_capacity{ capacity },
+	_stats{}
+{
+	fs::create_directories(_root);
+
+	for (const auto& entry : fs::recursive_directory_iterator{ _root })
+		if (entry.is_regular_file() && entry.path().extension() == ENTRY_EXTENSION)
+			_stats.size += entry.file_size();
+}
+
+const fs::path& ScriptCache::root() const { return _root; }
+uintmax_t ScriptCache::capacity() const { return _capacity; }
+
+const ScriptCacheStats& ScriptCache::stats() const { return _stats; }
+
+bool ScriptCache::contains(const std::string& key) const
+{
+	std::error_code ec{};
+	return fs::is_regular_file(entryPath(key), ec);
+}
+
+bool ScriptCache::load(const std::string& key, Script& script)
+{
+	const fs::path path = entryPath(key);
+	std::error_code ec{};
+	if (fs::file_size(path, ec) != SCRIPT_SIZE || ec)
+	{
+		if (!ec)
+			erase(key);
+		++_stats.misses;
+		return false;
+	}
+
+	std::ifstream f{ path, std::ios::in | std::ios::binary };
+	if (!f || !script.read(f) || script.getVersion() != SCRIPT_VERSION)
+	{
+		f.close();
+		script.clear();
+		erase(key);
+		++_stats.misses;
+		return false;
+	}
+	f.close();
+
+	fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+	++_stats.hits;
+	return true;
+}
+
+void ScriptCache::store(const std::string& key, const Script& script)
+{
+	const fs::path path = entryPath(key);
+	fs::create_directories(path.parent_path());
+
+	std::error_code ec{};
+	const uintmax_t previous = fs::is_regular_file(path, ec) ? fs::file_size(path, ec) : 0;
+
+	fs::path temp = path;
+	temp += ".tmp." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+	{
+		std::ofstream f{ temp, std::ios::out | std::ios::binary | std::ios::trunc };
+		script.write(f);
+		f.flush();
+		if (!f)
+		{
+			f.close();
+			fs::remove(temp, ec);
+			return;
+		}
+	}
+
+	fs::rename(temp, path, ec);
+	if (ec)
+	{
+		fs::remove(temp, ec);
+		return;
+	}
+
+	_stats.size = _stats.size - previous + fs::file_size(path, ec);
+	++_stats.stores;
+
+	if (_stats.size > _capacity)
+		evict();
+}
+
+bool ScriptCache::erase(const std::string& key)
+{
+	const fs::path path = entryPath(key);
+	std::error_code ec{};
+	const uintmax_t size = fs::file_size(path, ec);
+	if (ec || !fs::remove(path, ec))
+		return false;
+
+	_stats.size -= std::min(size, _stats.size);
+	return true;
+}
+
+void ScriptCache::clear()
+{
+	std::error_code ec{};
+	for (const auto& entry : fs::directory_iterator{ _root })
+		fs::remove_all(entry.path(), ec);
+	_stats.size = 0;
+}
+
+void ScriptCache::setCapacity(uintmax_t capacity)
+{
+	_capacity = capacity;
+	if (_stats.size > _capacity)
+		evict();
+}
+
+fs::path ScriptCache::entryPath(const std::string& key) const
+{
+	return _root / key.substr(0, 2) / (key + ENTRY_EXTENSION);
+}
+
+void ScriptCache::evict()
+{
+	struct Entry
+	{
+		fs::path path;
+		fs::file_time_type time;
+		uintmax_t size;
+	};
+
+	std::vector<Entry> entries{};
+	std::error_code ec{};
+	uintmax_t total = 0;
+	for (const auto& entry : fs::recursive_directory_iterator{ _root })
+	{
+		if (!entry.is_regular_file() || entry.path().extension() != ENTRY_EXTENSION)
+			continue;
+		entries.push_back({ entry.path(), entry.last_write_time(ec), entry.file_size(ec) });
+		total += entries.back().size;
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const Entry& e0, const Entry& e1) { return e0.time < e1.time; });
+
+	for (const Entry& entry : entries)
+	{
+		if (total <= _capacity)
+			break;
+		if (fs::remove(entry.path, ec))
+		{
+			total -= entry.size;
+			++_stats.evictions;
+		}
+	}
+	_stats.size = total;
+}
+
+std::string ScriptCache::makeKey(const std::string& source, const std::vector<std::string>& imports)
+{
+	ContentHasher hasher{};
+	hasher.update(COMPILER_VERSION);
+	hasher.update(std::to_string(SCRIPT_VERSION));
+	hasher.update(source);
+
+	const uint64_t count = imports.size();
+	hasher.update(&count, sizeof(count));
+	for (const std::string& import : imports)
+		hasher.update(import);
+
+	return hasher.hash().hex();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include "script.h"
+
+struct ScriptCacheStats
+{
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t stores;
+	uint64_t evictions;
+	uintmax_t size;
+};
+
+class ScriptCache
+{
+private:
+	std::filesystem::path _root;
+	uintmax_t _capacity;
+	ScriptCacheStats _stats;
+
+public:
+	ScriptCache(const std::string& root, uintmax_t capacity);
+
+	const std::filesystem::path& root() const;
+	uintmax_t capacity() const;
+
+	const ScriptCacheStats& stats() const;
+
+	bool contains(const std::string& key) const;
+
+	bool load(const std::string& key, Script& script);
+	void store(const std::string& key, const Script& script);
+
+	bool erase(const std::string& key);
+	void clear();
+
+	void setCapacity(uintmax_t capacity);
+
+private:
+	std::filesystem::path entryPath(const std::string& key) const;
+
+	void evict();
+
+public:
+	static std::string makeKey(const std::string& source, const std::vector<std::string>& imports);
+};
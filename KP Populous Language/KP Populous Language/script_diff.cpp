@@ -0,0 +1,446 @@
+#include "script_diff.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+#include "profiler.h"
+
+namespace
+{
+	const char MAGIC[4] = { 'K', 'P', 'S', 'P' };
+	const uint8_t FORMAT_VERSION = 1;
+	const int MAX_EDIT_DISTANCE = 1024;
+
+	struct Unit
+	{
+		uint16_t begin;
+		uint16_t end;
+		uint64_t hash;
+	};
+
+	enum class EditKind : uint8_t
+	{
+		Equal,
+		Delete,
+		Insert
+	};
+
+	struct Edit
+	{
+		EditKind kind;
+		size_t base;
+		size_t target;
+	};
+
+	uint16_t code_end(const Script& script)
+	{
+		uint16_t end = MAX_CODES;
+		while (end > 0 && script.codeData[end - 1] == 0)
+			--end;
+		return end;
+	}
+
+	uint16_t field_end(const Script& script)
+	{
+		const ScriptField invalid = ScriptField::invalid();
+		uint16_t end = MAX_FIELDS;
+		while (end > 0 && std::memcmp(&script.fieldData[end - 1], &invalid, sizeof(ScriptField)) == 0)
+			--end;
+		return end;
+	}
+
+	ContentHash image_hash(const Script& script)
+	{
+		const uint16_t codes = code_end(script);
+		const uint16_t fields = field_end(script);
+
+		ContentHasher hasher{};
+		hasher.update(&codes, sizeof(codes));
+		hasher.update(&fields, sizeof(fields));
+		hasher.update(script.codeData, codes * sizeof(ScriptCode));
+		hasher.update(script.fieldData, fields * sizeof(ScriptField));
+		return hasher.hash();
+	}
+
+	std::vector<Unit> split_units(const Script& script, uint16_t begin, uint16_t end)
+	{
+		std::vector<Unit> units{};
+		for (uint16_t idx = begin; idx < end;)
+		{
+			uint16_t next = idx + 1;
+			if (Script::blockDelta(script.codeData[idx]) > 0)
+			{
+				for (int depth = 1; next < end && depth > 0; ++next)
+					depth += Script::blockDelta(script.codeData[next]);
+			}
+
+			uint64_t hash = 0xcbf29ce484222325ULL;
+			for (uint16_t i = idx; i < next; ++i)
+				hash = (hash ^ script.codeData[i]) * 0x100000001b3ULL;
+			units.push_back({ idx, next, hash });
+			idx = next;
+		}
+		return units;
+	}
+
+	bool same_unit(const Script& base, const Unit& left, const Script& target, const Unit& right)
+	{
+		return left.hash == right.hash && left.end - left.begin == right.end - right.begin &&
+			std::memcmp(base.codeData + left.begin, target.codeData + right.begin, (left.end - left.begin) * sizeof(ScriptCode)) == 0;
+	}
+
+	bool myers(const std::vector<Unit>& base, const Script& baseScript, const std::vector<Unit>& target, const Script& targetScript, std::vector<Edit>& edits)
+	{
+		const int n = static_cast<int>(base.size());
+		const int m = static_cast<int>(target.size());
+		const int limit = std::min(n + m, MAX_EDIT_DISTANCE);
+		const int offset = limit + 1;
+
+		std::vector<int> v(2 * static_cast<size_t>(limit) + 3, 0);
+		std::vector<std::vector<int>> trace{};
+
+		for (int d = 0; d <= limit; ++d)
+		{
+			trace.emplace_back(v.begin() + (offset - d - 1), v.begin() + (offset + d + 2));
+			for (int k = -d; k <= d; k += 2)
+			{
+				int x = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) ? v[offset + k + 1] : v[offset + k - 1] + 1;
+				int y = x - k;
+				while (x < n && y < m && same_unit(baseScript, base[x], targetScript, target[y]))
+					++x, ++y;
+				v[offset + k] = x;
+
+				if (x < n || y < m)
+					continue;
+
+				for (int step = d; step >= 0; --step)
+				{
+					const auto& prev = trace[step];
+					const auto at = [&prev, step](int k) { return prev[k + step + 1]; };
+					const int kk = x - y;
+					const int prevK = (kk == -step || (kk != step && at(kk - 1) < at(kk + 1))) ? kk + 1 : kk - 1;
+					const int prevX = step > 0 ? at(prevK) : 0;
+					const int prevY = step > 0 ? prevX - prevK : 0;
+
+					while (x > prevX && y > prevY)
+						--x, --y, edits.push_back({ EditKind::Equal, static_cast<size_t>(x), static_cast<size_t>(y) });
+					if (step > 0)
+					{
+						if (x == prevX)
+							edits.push_back({ EditKind::Insert, static_cast<size_t>(x), static_cast<size_t>(prevY) });
+						else edits.push_back({ EditKind::Delete, static_cast<size_t>(prevX), static_cast<size_t>(y) });
+					}
+					x = prevX;
+					y = prevY;
+				}
+				std::reverse(edits.begin(), edits.end());
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void write_varint(std::ostream& output, uint32_t value)
+	{
+		while (value >= 0x80)
+		{
+			output.put(static_cast<char>((value & 0x7f) | 0x80));
+			value >>= 7;
+		}
+		output.put(static_cast<char>(value));
+	}
+
+	uint32_t read_varint(std::istream& input)
+	{
+		uint32_t value = 0;
+		for (unsigned int shift = 0; shift < 35; shift += 7)
+		{
+			const int c = input.get();
+			if (c == std::char_traits<char>::eof())
+				throw BadScriptPatch{};
+			value |= static_cast<uint32_t>(c & 0x7f) << shift;
+			if (!(c & 0x80))
+				return value;
+		}
+		throw BadScriptPatch{};
+	}
+
+	void write_hash(std::ostream& output, const ContentHash& hash)
+	{
+		for (int i = 0; i < 8; ++i)
+			output.put(static_cast<char>(hash.low >> (i * 8)));
+		for (int i = 0; i < 8; ++i)
+			output.put(static_cast<char>(hash.high >> (i * 8)));
+	}
+
+	ContentHash read_hash(std::istream& input)
+	{
+		unsigned char bytes[16];
+		if (!input.read(reinterpret_cast<char*>(bytes), sizeof(bytes)))
+			throw BadScriptPatch{};
+
+		ContentHash hash{ 0, 0 };
+		for (int i = 0; i < 8; ++i)
+		{
+			hash.low |= static_cast<uint64_t>(bytes[i]) << (i * 8);
+			hash.high |= static_cast<uint64_t>(bytes[i + 8]) << (i * 8);
+		}
+		return hash;
+	}
+}
+
+ScriptPatch::ScriptPatch() :
+	_base{ 0, 0 },
+	_target{ 0, 0 },
+	_ops{},
+	_codes{},
+	_runs{},
+	_fields{}
+{}
+
+bool ScriptPatch::empty() const { return _base == _target; }
+
+const std::vector<PatchOp>& ScriptPatch::operations() const { return _ops; }
+const std::vector<PatchFieldRun>& ScriptPatch::fieldRuns() const { return _runs; }
+
+size_t ScriptPatch::copiedCodes() const
+{
+	size_t count = 0;
+	for (const PatchOp& op : _ops)
+		if (op.kind == PatchOpKind::Copy)
+			count += op.count;
+	return count;
+}
+
+size_t ScriptPatch::insertedCodes() const { return _codes.size(); }
+size_t ScriptPatch::changedFields() const { return _fields.size(); }
+
+bool ScriptPatch::apply(const Script& base, Script& result) const
+{
+	PROFILE_SCOPE("ScriptPatch::apply");
+
+	if (image_hash(base) != _base)
+		return false;
+
+	Script script{};
+	uint32_t size = 0;
+	for (const PatchOp& op : _ops)
+	{
+		if (size + op.count > MAX_CODES)
+			return false;
+
+		if (op.kind == PatchOpKind::Copy)
+		{
+			if (op.source + op.count > MAX_CODES)
+				return false;
+			std::memcpy(script.codeData + size, base.codeData + op.source, op.count * sizeof(ScriptCode));
+		}
+		else
+		{
+			if (op.source + op.count > _codes.size())
+				return false;
+			std::memcpy(script.codeData + size, _codes.data() + op.source, op.count * sizeof(ScriptCode));
+		}
+		size += op.count;
+	}
+
+	std::memcpy(script.fieldData, base.fieldData, sizeof(script.fieldData));
+	for (const PatchFieldRun& run : _runs)
+	{
+		if (run.start + run.count > MAX_FIELDS || run.source + run.count > _fields.size())
+			return false;
+		std::memcpy(script.fieldData + run.start, _fields.data() + run.source, run.count * sizeof(ScriptField));
+	}
+
+	if (image_hash(script) != _target)
+		return false;
+
+	std::memcpy(result.codeData, script.codeData, sizeof(script.codeData));
+	std::memcpy(result.fieldData, script.fieldData, sizeof(script.fieldData));
+	return true;
+}
+
+void ScriptPatch::read(std::istream& input)
+{
+	char magic[sizeof(MAGIC)];
+	if (!input.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), MAGIC) || input.get() != FORMAT_VERSION)
+		throw BadScriptPatch{};
+
+	*this = {};
+	_base = read_hash(input);
+	_target = read_hash(input);
+
+	for (uint32_t remaining = read_varint(input); remaining > 0; --remaining)
+	{
+		const uint32_t header = read_varint(input);
+		const uint32_t count = header >> 1;
+		if (count == 0 || count > MAX_CODES)
+			throw BadScriptPatch{};
+
+		if (header & 1)
+		{
+			_ops.push_back({ PatchOpKind::Insert, static_cast<uint16_t>(count), static_cast<uint32_t>(_codes.size()) });
+			for (uint32_t i = 0; i < count; ++i)
+				_codes.push_back(static_cast<ScriptCode>(read_varint(input)));
+		}
+		else _ops.push_back({ PatchOpKind::Copy, static_cast<uint16_t>(count), read_varint(input) });
+	}
+
+	for (uint32_t remaining = read_varint(input); remaining > 0; --remaining)
+	{
+		const uint32_t start = read_varint(input);
+		const uint32_t count = read_varint(input);
+		if (count == 0 || start + count > MAX_FIELDS)
+			throw BadScriptPatch{};
+
+		_runs.push_back({ static_cast<uint16_t>(start), static_cast<uint16_t>(count), static_cast<uint32_t>(_fields.size()) });
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const uint32_t type = read_varint(input);
+			const uint32_t zigzag = read_varint(input);
+			_fields.push_back({ type, static_cast<field_value_t>((zigzag >> 1) ^ (~(zigzag & 1) + 1)) });
+		}
+	}
+}
+
+void ScriptPatch::write(std::ostream& output) const
+{
+	output.write(MAGIC, sizeof(MAGIC));
+	output.put(static_cast<char>(FORMAT_VERSION));
+	write_hash(output, _base);
+	write_hash(output, _target);
+
+	write_varint(output, static_cast<uint32_t>(_ops.size()));
+	for (const PatchOp& op : _ops)
+	{
+		write_varint(output, (static_cast<uint32_t>(op.count) << 1) | (op.kind == PatchOpKind::Insert ? 1 : 0));
+		if (op.kind == PatchOpKind::Copy)
+			write_varint(output, op.source);
+		else for (uint32_t i = 0; i < op.count; ++i)
+			write_varint(output, _codes[op.source + i]);
+	}
+
+	write_varint(output, static_cast<uint32_t>(_runs.size()));
+	for (const PatchFieldRun& run : _runs)
+	{
+		write_varint(output, run.start);
+		write_varint(output, run.count);
+		for (uint32_t i = 0; i < run.count; ++i)
+		{
+			const ScriptField& field = _fields[run.source + i];
+			write_varint(output, field.type);
+			write_varint(output, (static_cast<uint32_t>(field.value) << 1) ^ static_cast<uint32_t>(field.value >> 31));
+		}
+	}
+}
+
+bool ScriptPatch::readFromFile(const std::string& file)
+{
+	std::ifstream f{ file, std::ios::in | std::ios::binary };
+	if (!f)
+		return false;
+
+	try { read(f); }
+	catch (const BadScriptPatch&)
+	{
+		*this = {};
+		return false;
+	}
+	return true;
+}
+
+bool ScriptPatch::writeToFile(const std::string& file) const
+{
+	std::ofstream f{ file, std::ios::out | std::ios::binary | std::ios::trunc };
+	write(f);
+	f.flush();
+	return static_cast<bool>(f);
+}
+
+void ScriptPatch::copy(uint16_t offset, uint16_t count)
+{
+	if (count == 0)
+		return;
+	if (!_ops.empty() && _ops.back().kind == PatchOpKind::Copy && _ops.back().source + _ops.back().count == offset)
+		_ops.back().count += count;
+	else _ops.push_back({ PatchOpKind::Copy, count, offset });
+}
+
+void ScriptPatch::insert(const ScriptCode* codes, uint16_t count)
+{
+	if (count == 0)
+		return;
+	if (_ops.empty() || _ops.back().kind != PatchOpKind::Insert)
+		_ops.push_back({ PatchOpKind::Insert, 0, static_cast<uint32_t>(_codes.size()) });
+	_ops.back().count += count;
+	_codes.insert(_codes.end(), codes, codes + count);
+}
+
+void ScriptPatch::diffCodes(const Script& base, uint16_t baseBegin, uint16_t baseEnd, const Script& target, uint16_t targetBegin, uint16_t targetEnd)
+{
+	const std::vector<Unit> baseUnits = split_units(base, baseBegin, baseEnd);
+	const std::vector<Unit> targetUnits = split_units(target, targetBegin, targetEnd);
+
+	std::vector<Edit> edits{};
+	if (!myers(baseUnits, base, targetUnits, target, edits))
+	{
+		insert(target.codeData + targetBegin, targetEnd - targetBegin);
+		return;
+	}
+
+	std::vector<size_t> deleted{};
+	std::vector<size_t> inserted{};
+	const auto flush = [&]() {
+		for (size_t i = 0; i < inserted.size(); ++i)
+		{
+			const Unit& to = targetUnits[inserted[i]];
+			const Unit* const from = deleted.size() == inserted.size() ? &baseUnits[deleted[i]] : nullptr;
+			if (from && from->end - from->begin > 1 && to.end - to.begin > 1 && base.codeData[from->begin] == target.codeData[to.begin])
+			{
+				copy(from->begin, 1);
+				diffCodes(base, from->begin + 1, from->end, target, to.begin + 1, to.end);
+			}
+			else insert(target.codeData + to.begin, to.end - to.begin);
+		}
+		deleted.clear();
+		inserted.clear();
+	};
+
+	for (const Edit& edit : edits)
+	{
+		switch (edit.kind)
+		{
+			case EditKind::Equal:
+				flush();
+				copy(baseUnits[edit.base].begin, baseUnits[edit.base].end - baseUnits[edit.base].begin);
+				break;
+			case EditKind::Delete: deleted.push_back(edit.base); break;
+			case EditKind::Insert: inserted.push_back(edit.target); break;
+		}
+	}
+	flush();
+}
+
+ScriptPatch ScriptPatch::diff(const Script& base, const Script& target)
+{
+	PROFILE_SCOPE("ScriptPatch::diff");
+
+	ScriptPatch patch{};
+	patch._base = image_hash(base);
+	patch._target = image_hash(target);
+	patch.diffCodes(base, 0, code_end(base), target, 0, code_end(target));
+
+	const uint16_t fields = std::max(field_end(base), field_end(target));
+	for (uint16_t idx = 0; idx < fields; ++idx)
+	{
+		if (std::memcmp(&base.fieldData[idx], &target.fieldData[idx], sizeof(ScriptField)) == 0)
+			continue;
+
+		if (!patch._runs.empty() && patch._runs.back().start + patch._runs.back().count == idx)
+			++patch._runs.back().count;
+		else patch._runs.push_back({ idx, 1, static_cast<uint32_t>(patch._fields.size()) });
+		patch._fields.push_back(target.fieldData[idx]);
+	}
+	return patch;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+
+#include "script.h"
+#include "content_hash.h"
+
+enum class PatchOpKind : uint8_t
+{
+	Copy,
+	Insert
+};
+
+struct PatchOp
+{
+	PatchOpKind kind;
+	uint16_t count;
+	uint32_t source;
+};
+
+struct PatchFieldRun
+{
+	uint16_t start;
+	uint16_t count;
+	uint32_t source;
+};
+
+class ScriptPatch
+{
+private:
+	ContentHash _base;
+	ContentHash _target;
+	std::vector<PatchOp> _ops;
+	std::vector<ScriptCode> _codes;
+	std::vector<PatchFieldRun> _runs;
+	std::vector<ScriptField> _fields;
+
+public:
+	ScriptPatch();
+
+	bool empty() const;
+
+	const std::vector<PatchOp>& operations() const;
+	const std::vector<PatchFieldRun>& fieldRuns() const;
+
+	size_t copiedCodes() const;
+	size_t insertedCodes() const;
+	size_t changedFields() const;
+
+	bool apply(const Script& base, Script& result) const;
+
+	void read(std::istream& input);
+	void write(std::ostream& output) const;
+
+	bool readFromFile(const std::string& file);
+	bool writeToFile(const std::string& file) const;
+
+private:
+	void copy(uint16_t offset, uint16_t count);
+	void insert(const ScriptCode* codes, uint16_t count);
+
+	void diffCodes(const Script& base, uint16_t baseBegin, uint16_t baseEnd, const Script& target, uint16_t targetBegin, uint16_t targetEnd);
+
+public:
+	static ScriptPatch diff(const Script& base, const Script& target);
+};
+
+class BadScriptPatch : public std::exception {};
@@ -0,0 +1,413 @@
+#include "script_index.h"
+
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <cctype>
+
+#include "profiler.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	const char MAGIC[4] = { 'K', 'P', 'S', 'I' };
+	const uint8_t FORMAT_VERSION = 1;
+	const char* const SCRIPT_EXTENSION = ".scr";
+
+	struct IndexedTerm
+	{
+		uint64_t key;
+		uint32_t script;
+		uint16_t offset;
+
+		bool operator< (const IndexedTerm& other) const
+		{
+			if (key != other.key)
+				return key < other.key;
+			return script != other.script ? script < other.script : offset < other.offset;
+		}
+	};
+
+	bool is_script_file(const fs::path& path)
+	{
+		std::string ext = path.extension().string();
+		for (char& c : ext)
+			c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+		return ext == SCRIPT_EXTENSION;
+	}
+
+	bool precedes(const ScriptPosting& left, const ScriptPosting& right)
+	{
+		return left.script != right.script ? left.script < right.script : left.offset < right.offset;
+	}
+
+
+	class BufferWriter
+	{
+	private:
+		std::vector<uint8_t> _data;
+
+	public:
+		BufferWriter() : _data{} {}
+
+		const std::vector<uint8_t>& data() const { return _data; }
+
+		void put(uint64_t value, size_t bytes)
+		{
+			for (size_t i = 0; i < bytes; ++i)
+				_data.push_back(static_cast<uint8_t>(value >> (i * 8)));
+		}
+
+		void put(const void* data, size_t size)
+		{
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+			_data.insert(_data.end(), bytes, bytes + size);
+		}
+	};
+
+	class BufferReader
+	{
+	private:
+		const std::vector<uint8_t>& _data;
+		size_t _pos;
+
+	public:
+		BufferReader(const std::vector<uint8_t>& data) : _data{ data }, _pos{ 0 } {}
+
+		bool finished() const { return _pos == _data.size(); }
+
+		uint64_t get(size_t bytes)
+		{
+			if (_data.size() - _pos < bytes)
+				throw BadScriptIndex{};
+			uint64_t value = 0;
+			for (size_t i = 0; i < bytes; ++i)
+				value |= static_cast<uint64_t>(_data[_pos++]) << (i * 8);
+			return value;
+		}
+
+		size_t count(size_t bytes, size_t itemSize)
+		{
+			const uint64_t value = get(bytes);
+			if (value > (_data.size() - _pos) / itemSize)
+				throw BadScriptIndex{};
+			return static_cast<size_t>(value);
+		}
+
+		void get(void* data, size_t size)
+		{
+			if (_data.size() - _pos < size)
+				throw BadScriptIndex{};
+			std::memcpy(data, _data.data() + _pos, size);
+			_pos += size;
+		}
+	};
+}
+
+uint64_t ScriptTerm::key() const { return (static_cast<uint64_t>(kind) << 32) | static_cast<uint32_t>(value); }
+
+ScriptTerm ScriptTerm::token(ScriptCode code) { return { ScriptTermKind::Token, code }; }
+ScriptTerm ScriptTerm::constant(field_value_t value) { return { ScriptTermKind::Constant, value }; }
+ScriptTerm ScriptTerm::internal(field_value_t index) { return { ScriptTermKind::Internal, index }; }
+ScriptTerm ScriptTerm::variable(field_value_t index) { return { ScriptTermKind::Variable, index }; }
+
+
+
+
+ScriptPostingRange::ScriptPostingRange(const ScriptPosting* begin, const ScriptPosting* end) :
+	_begin{ begin },
+	_end{ end }
+{}
+
+const ScriptPosting* ScriptPostingRange::begin() const { return _begin; }
+const ScriptPosting* ScriptPostingRange::end() const { return _end; }
+
+size_t ScriptPostingRange::size() const { return static_cast<size_t>(_end - _begin); }
+bool ScriptPostingRange::empty() const { return _begin == _end; }
+
+
+
+
+ScriptIndex::ScriptIndex(unsigned int threads) :
+	_files{},
+	_terms{},
+	_postings{},
+	_threads{ threads > 0 ? threads : std::max(1U, std::thread::hardware_concurrency()) }
+{}
+
+size_t ScriptIndex::update(const std::string& directory)
+{
+	PROFILE_SCOPE("ScriptIndex::update");
+
+	std::vector<ScriptIndexFile> files{};
+	std::error_code ec{};
+	for (fs::recursive_directory_iterator it{ directory, ec }, end{}; !ec && it != end; it.increment(ec))
+	{
+		if (!it->is_regular_file(ec) || !is_script_file(it->path()))
+			continue;
+		files.push_back({ it->path().generic_string(), it->file_size(ec), it->last_write_time(ec).time_since_epoch().count() });
+	}
+	std::sort(files.begin(), files.end(), [](const ScriptIndexFile& left, const ScriptIndexFile& right) { return left.path < right.path; });
+
+	std::unordered_map<std::string, uint32_t> previous{};
+	for (uint32_t i = 0; i < _files.size(); ++i)
+		previous[_files[i].path] = i;
+
+	std::vector<uint32_t> remap(_files.size(), UINT32_MAX);
+	std::vector<uint32_t> pending{};
+	size_t removed = _files.size();
+	for (uint32_t i = 0; i < files.size(); ++i)
+	{
+		const auto& it = previous.find(files[i].path);
+		if (it != previous.end())
+			--removed;
+		if (it != previous.end() && _files[it->second].size == files[i].size && _files[it->second].modified == files[i].modified)
+			remap[it->second] = i;
+		else pending.push_back(i);
+	}
+
+	if (pending.empty() && removed == 0)
+		return 0;
+
+	std::vector<std::vector<std::pair<uint64_t, uint16_t>>> results(pending.size());
+	std::atomic<size_t> next{ 0 };
+	const auto worker = [&files, &pending, &results, &next]() {
+		Script script{};
+		for (size_t i = next++; i < pending.size(); i = next++)
+		{
+			if (script.readFromFile(files[pending[i]].path))
+				collect(script, results[i]);
+		}
+	};
+
+	std::vector<std::thread> workers{};
+	const size_t count = std::min<size_t>(_threads, pending.size());
+	for (size_t i = 1; i < count; ++i)
+		workers.emplace_back(worker);
+	worker();
+	for (std::thread& thread : workers)
+		thread.join();
+
+	std::vector<IndexedTerm> terms{};
+	for (const TermEntry& term : _terms)
+		for (uint32_t i = term.first; i < term.first + term.count; ++i)
+			if (remap[_postings[i].script] != UINT32_MAX)
+				terms.push_back({ term.key, remap[_postings[i].script], _postings[i].offset });
+	for (size_t i = 0; i < pending.size(); ++i)
+		for (const auto& term : results[i])
+			terms.push_back({ term.first, pending[i], term.second });
+	std::sort(terms.begin(), terms.end());
+
+	_files = std::move(files);
+	_terms.clear();
+	_postings.clear();
+	_postings.reserve(terms.size());
+	for (const IndexedTerm& term : terms)
+	{
+		if (_terms.empty() || _terms.back().key != term.key)
+			_terms.push_back({ term.key, static_cast<uint32_t>(_postings.size()), 0 });
+		++_terms.back().count;
+		_postings.push_back({ term.script, term.offset });
+	}
+
+	return pending.size() + removed;
+}
+
+size_t ScriptIndex::scriptCount() const { return _files.size(); }
+size_t ScriptIndex::termCount() const { return _terms.size(); }
+size_t ScriptIndex::postingCount() const { return _postings.size(); }
+
+const ScriptIndexFile& ScriptIndex::script(uint32_t id) const
+{
+	if (id >= _files.size())
+		throw BadIndex{ "Script id out of range" };
+	return _files[id];
+}
+
+ScriptPostingRange ScriptIndex::find(const ScriptTerm& term) const
+{
+	const uint64_t key = term.key();
+	const auto& it = std::lower_bound(_terms.begin(), _terms.end(), key, [](const TermEntry& entry, uint64_t key) { return entry.key < key; });
+	if (it == _terms.end() || it->key != key)
+		return { nullptr, nullptr };
+
+	const ScriptPosting* const first = _postings.data() + it->first;
+	return { first, first + it->count };
+}
+
+std::vector<uint32_t> ScriptIndex::scripts(const ScriptTerm& term) const
+{
+	std::vector<uint32_t> ids{};
+	for (const ScriptPosting& posting : find(term))
+		if (ids.empty() || ids.back() != posting.script)
+			ids.push_back(posting.script);
+	return ids;
+}
+
+std::vector<uint32_t> ScriptIndex::scriptsWithAll(const std::vector<ScriptTerm>& terms) const
+{
+	if (terms.empty())
+		return {};
+
+	std::vector<ScriptTerm> ordered{ terms };
+	std::sort(ordered.begin(), ordered.end(), [this](const ScriptTerm& left, const ScriptTerm& right) { return find(left).size() < find(right).size(); });
+
+	std::vector<uint32_t> ids = scripts(ordered.front());
+	for (size_t i = 1; i < ordered.size() && !ids.empty(); ++i)
+	{
+		const std::vector<uint32_t> other = scripts(ordered[i]);
+		std::vector<uint32_t> common{};
+		std::set_intersection(ids.begin(), ids.end(), other.begin(), other.end(), std::back_inserter(common));
+		ids = std::move(common);
+	}
+	return ids;
+}
+
+std::vector<ScriptPosting> ScriptIndex::near(const ScriptTerm& first, const ScriptTerm& second, uint16_t distance) const
+{
+	const ScriptPostingRange anchors = find(first);
+	std::vector<ScriptPosting> matches{};
+
+	const ScriptPosting* anchor = anchors.begin();
+	for (const ScriptPosting& posting : find(second))
+	{
+		const ScriptPosting lowest{ posting.script, static_cast<uint16_t>(posting.offset > distance ? posting.offset - distance : 0) };
+		while (anchor != anchors.end() && precedes(*anchor, lowest))
+			++anchor;
+		if (anchor != anchors.end() && anchor->script == posting.script && anchor->offset < posting.offset)
+			matches.push_back(posting);
+	}
+	return matches;
+}
+
+void ScriptIndex::clear()
+{
+	_files.clear();
+	_terms.clear();
+	_postings.clear();
+}
+
+bool ScriptIndex::load(const std::string& file)
+{
+	PROFILE_SCOPE("ScriptIndex::load");
+
+	std::ifstream f{ file, std::ios::in | std::ios::binary | std::ios::ate };
+	if (!f)
+		return false;
+
+	std::vector<uint8_t> data(static_cast<size_t>(f.tellg()));
+	f.seekg(0, std::ios::beg);
+	if (!f.read(reinterpret_cast<char*>(data.data()), data.size()))
+		return false;
+
+	clear();
+	try
+	{
+		BufferReader reader{ data };
+		char magic[sizeof(MAGIC)];
+		reader.get(magic, sizeof(magic));
+		if (!std::equal(magic, magic + sizeof(magic), MAGIC) || reader.get(1) != FORMAT_VERSION)
+			throw BadScriptIndex{};
+
+		_files.resize(reader.count(4, 18));
+		for (ScriptIndexFile& script : _files)
+		{
+			script.path.resize(reader.count(2, 1));
+			reader.get(&script.path[0], script.path.size());
+			script.size = static_cast<uintmax_t>(reader.get(8));
+			script.modified = static_cast<int64_t>(reader.get(8));
+		}
+
+		_terms.resize(reader.count(4, 12));
+		_postings.resize(reader.count(4, 6));
+		uint64_t expected = 0;
+		for (TermEntry& term : _terms)
+		{
+			term.key = reader.get(8);
+			term.first = static_cast<uint32_t>(expected);
+			term.count = static_cast<uint32_t>(reader.get(4));
+			expected += term.count;
+		}
+		if (expected != _postings.size())
+			throw BadScriptIndex{};
+
+		for (ScriptPosting& posting : _postings)
+		{
+			posting.script = static_cast<uint32_t>(reader.get(4));
+			posting.offset = static_cast<uint16_t>(reader.get(2));
+			if (posting.script >= _files.size())
+				throw BadScriptIndex{};
+		}
+		if (!reader.finished())
+			throw BadScriptIndex{};
+	}
+	catch (const BadScriptIndex&)
+	{
+		clear();
+		return false;
+	}
+	return true;
+}
+
+bool ScriptIndex::save(const std::string& file) const
+{
+	BufferWriter writer{};
+	writer.put(MAGIC, sizeof(MAGIC));
+	writer.put(FORMAT_VERSION, 1);
+
+	writer.put(_files.size(), 4);
+	for (const ScriptIndexFile& script : _files)
+	{
+		writer.put(script.path.size(), 2);
+		writer.put(script.path.data(), script.path.size());
+		writer.put(script.size, 8);
+		writer.put(static_cast<uint64_t>(script.modified), 8);
+	}
+
+	writer.put(_terms.size(), 4);
+	writer.put(_postings.size(), 4);
+	for (const TermEntry& term : _terms)
+	{
+		writer.put(term.key, 8);
+		writer.put(term.count, 4);
+	}
+	for (const ScriptPosting& posting : _postings)
+	{
+		writer.put(posting.script, 4);
+		writer.put(posting.offset, 2);
+	}
+
+	std::ofstream f{ file, std::ios::out | std::ios::binary | std::ios::trunc };
+	f.write(reinterpret_cast<const char*>(writer.data().data()), writer.data().size());
+	f.flush();
+	return static_cast<bool>(f);
+}
+
+void ScriptIndex::collect(const Script& script, std::vector<std::pair<uint64_t, uint16_t>>& terms)
+{
+	for (uint16_t offset = 1; offset < MAX_CODES; ++offset)
+	{
+		const ScriptCode code = script.codeData[offset];
+		if (code >= TOKEN_OFFSET)
+		{
+			terms.emplace_back(ScriptTerm::token(code).key(), offset);
+			if (code == InstructionToken::ScriptEnd)
+				break;
+			continue;
+		}
+		if (code >= MAX_FIELDS)
+			continue;
+
+		const ScriptField& field = script.fieldData[code];
+		switch (field.type)
+		{
+			case FieldType::Constant: terms.emplace_back(ScriptTerm::constant(field.value).key(), offset); break;
+			case FieldType::Internal: terms.emplace_back(ScriptTerm::internal(field.index).key(), offset); break;
+			case FieldType::User: terms.emplace_back(ScriptTerm::variable(field.index).key(), offset); break;
+		}
+	}
+}
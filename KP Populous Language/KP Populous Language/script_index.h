@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include "script.h"
+
+enum class ScriptTermKind : uint8_t
+{
+	Token,
+	Constant,
+	Internal,
+	Variable
+};
+
+struct ScriptTerm
+{
+	ScriptTermKind kind;
+	int32_t value;
+
+	uint64_t key() const;
+
+	static ScriptTerm token(ScriptCode code);
+	static ScriptTerm constant(field_value_t value);
+	static ScriptTerm internal(field_value_t index);
+	static ScriptTerm variable(field_value_t index);
+};
+
+struct ScriptPosting
+{
+	uint32_t script;
+	uint16_t offset;
+};
+
+class ScriptPostingRange
+{
+private:
+	const ScriptPosting* _begin;
+	const ScriptPosting* _end;
+
+public:
+	ScriptPostingRange(const ScriptPosting* begin, const ScriptPosting* end);
+
+	const ScriptPosting* begin() const;
+	const ScriptPosting* end() const;
+
+	size_t size() const;
+	bool empty() const;
+};
+
+struct ScriptIndexFile
+{
+	std::string path;
+	uintmax_t size;
+	int64_t modified;
+};
+
+class ScriptIndex
+{
+private:
+	struct TermEntry
+	{
+		uint64_t key;
+		uint32_t first;
+		uint32_t count;
+	};
+
+	std::vector<ScriptIndexFile> _files;
+	std::vector<TermEntry> _terms;
+	std::vector<ScriptPosting> _postings;
+	unsigned int _threads;
+
+public:
+	ScriptIndex(unsigned int threads = 0);
+
+	size_t update(const std::string& directory);
+
+	size_t scriptCount() const;
+	size_t termCount() const;
+	size_t postingCount() const;
+
+	const ScriptIndexFile& script(uint32_t id) const;
+
+	ScriptPostingRange find(const ScriptTerm& term) const;
+
+	std::vector<uint32_t> scripts(const ScriptTerm& term) const;
+	std::vector<uint32_t> scriptsWithAll(const std::vector<ScriptTerm>& terms) const;
+
+	std::vector<ScriptPosting> near(const ScriptTerm& first, const ScriptTerm& second, uint16_t distance) const;
+
+	void clear();
+
+	bool load(const std::string& file);
+	bool save(const std::string& file) const;
+
+public:
+	static void collect(const Script& script, std::vector<std::pair<uint64_t, uint16_t>>& terms);
+};
+
+class BadScriptIndex : public std::exception {};
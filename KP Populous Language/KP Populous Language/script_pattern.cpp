@@ -0,0 +1,285 @@
+#include "script_pattern.h"
+
+#include <algorithm>
+#include <sstream>
+#include <cstdlib>
+
+#include "datatypes.h"
+#include "token_names.h"
+#include "profiler.h"
+
+namespace
+{
+	const Error INVALID_ELEMENT{ ErrorCode::InvalidPattern, "Invalid pattern element" };
+	const Error INVALID_ARGUMENT{ ErrorCode::InvalidPattern, "Invalid pattern field value" };
+	const Error MISPLACED_GAP{ ErrorCode::InvalidPattern, "Gaps cannot be combined with other alternatives" };
+	const Error EMPTY_PATTERN{ ErrorCode::InvalidPattern, "Empty pattern" };
+
+	struct Thread
+	{
+		size_t state;
+		int depth;
+	};
+
+	bool parse_number(const std::string& str, field_value_t& value)
+	{
+		if (str.empty())
+			return false;
+		char* end = nullptr;
+		const long number = std::strtol(str.c_str(), &end, 10);
+		if (*end)
+			return false;
+		value = static_cast<field_value_t>(number);
+		return true;
+	}
+
+	Result<PatternPredicate> parse_predicate(const std::string& element)
+	{
+		PatternPredicate pred{ PatternPredicateKind::Any, 0, FieldType::Invalid, false, 0 };
+		if (element == "*")
+			return pred;
+		if (element == "token")
+			return pred.kind = PatternPredicateKind::AnyToken, pred;
+		if (element == "field")
+			return pred.kind = PatternPredicateKind::AnyField, pred;
+
+		if (element[0] == '#')
+		{
+			field_value_t code;
+			if (!parse_number(element.substr(1), code) || code < 0 || code > UINT16_MAX)
+				return INVALID_ELEMENT;
+			pred.kind = PatternPredicateKind::Token;
+			pred.code = static_cast<ScriptCode>(code);
+			return pred;
+		}
+
+		const size_t paren = element.find('(');
+		const std::string name = element.substr(0, paren);
+		if (name == "const" || name == "internal" || name == "var")
+		{
+			pred.kind = PatternPredicateKind::Field;
+			pred.fieldType = name == "const" ? FieldType::Constant : name == "internal" ? FieldType::Internal : FieldType::User;
+			if (paren == std::string::npos)
+				return pred;
+
+			if (element.back() != ')')
+				return INVALID_ARGUMENT;
+			const std::string arg = element.substr(paren + 1, element.size() - paren - 2);
+			pred.hasValue = true;
+			if (parse_number(arg, pred.value))
+				return pred;
+
+			const DataType type = DataType::findTypeFromValueName(arg);
+			if (!type)
+				return INVALID_ARGUMENT;
+			pred.value = type.getIdentifierValue(arg);
+			return pred;
+		}
+
+		if (paren != std::string::npos || !find_token(element, pred.code))
+			return INVALID_ELEMENT;
+		pred.kind = PatternPredicateKind::Token;
+		return pred;
+	}
+
+	void add_thread(std::vector<Thread>& threads, const std::vector<PatternState>& states, size_t state, int depth, bool& matched)
+	{
+		if (state == states.size())
+		{
+			matched = true;
+			return;
+		}
+		for (const Thread& thread : threads)
+			if (thread.state == state && thread.depth == depth)
+				return;
+
+		threads.push_back({ state, depth });
+		if (states[state].gap)
+			add_thread(threads, states, state + 1, 0, matched);
+	}
+}
+
+bool PatternPredicate::matches(const Script& script, ScriptCode code) const
+{
+	switch (kind)
+	{
+		case PatternPredicateKind::Any: return true;
+		case PatternPredicateKind::Token: return code == this->code;
+		case PatternPredicateKind::AnyToken: return code >= TOKEN_OFFSET;
+		case PatternPredicateKind::AnyField: return code < MAX_FIELDS && !script.fieldData[code].isInvalid();
+		case PatternPredicateKind::Field:
+			if (code >= MAX_FIELDS || script.fieldData[code].type != fieldType)
+				return false;
+			return !hasValue || script.fieldData[code].value == value;
+	}
+	return false;
+}
+
+
+
+
+ScriptPattern::ScriptPattern() :
+	_states{},
+	_anchors{}
+{}
+
+size_t ScriptPattern::stateCount() const { return _states.size(); }
+const std::vector<ScriptCode>& ScriptPattern::anchors() const { return _anchors; }
+
+std::vector<PatternMatch> ScriptPattern::match(const Script& script) const
+{
+	PROFILE_SCOPE("ScriptPattern::match");
+
+	const uint16_t length = script.length();
+	std::vector<PatternMatch> matches{};
+	PatternMatch match{};
+
+	if (_anchors.empty())
+	{
+		for (uint16_t begin = 1; begin < length; ++begin)
+			if (matchAt(script, begin, length, match))
+				matches.push_back(match);
+		return matches;
+	}
+
+	std::vector<uint16_t> starts{};
+	for (const ScriptCode anchor : _anchors)
+		for (uint16_t begin = script.findCode(anchor, 1); begin < length; begin = script.findCode(anchor, begin + 1))
+			starts.push_back(begin);
+	std::sort(starts.begin(), starts.end());
+
+	for (const uint16_t begin : starts)
+		if (matchAt(script, begin, length, match))
+			matches.push_back(match);
+	return matches;
+}
+
+bool ScriptPattern::matches(const Script& script) const { return !match(script).empty(); }
+
+std::vector<ScriptPatternHit> ScriptPattern::search(const ScriptIndex& index) const
+{
+	PROFILE_SCOPE("ScriptPattern::search");
+
+	std::vector<uint32_t> candidates{};
+	if (_anchors.empty())
+	{
+		for (uint32_t id = 0; id < index.scriptCount(); ++id)
+			candidates.push_back(id);
+	}
+	else
+	{
+		for (const ScriptCode anchor : _anchors)
+		{
+			const std::vector<uint32_t> ids = index.scripts(ScriptTerm::token(anchor));
+			candidates.insert(candidates.end(), ids.begin(), ids.end());
+		}
+		std::sort(candidates.begin(), candidates.end());
+		candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+	}
+
+	std::vector<ScriptPatternHit> hits{};
+	Script script{};
+	for (const uint32_t id : candidates)
+	{
+		if (!script.readFromFile(index.script(id).path))
+			continue;
+		for (const PatternMatch& match : match(script))
+			hits.push_back({ id, match });
+	}
+	return hits;
+}
+
+bool ScriptPattern::matchAt(const Script& script, uint16_t begin, uint16_t length, PatternMatch& match) const
+{
+	std::vector<Thread> threads{};
+	std::vector<Thread> next{};
+	bool matched = false;
+	add_thread(threads, _states, 0, 0, matched);
+
+	for (uint16_t offset = begin; offset < length && !threads.empty(); ++offset)
+	{
+		const ScriptCode code = script.codeData[offset];
+		next.clear();
+		for (const Thread& thread : threads)
+		{
+			const PatternState& state = _states[thread.state];
+			if (state.gap)
+			{
+				const int depth = thread.depth + Script::blockDelta(code);
+				if (depth >= 0)
+					add_thread(next, _states, thread.state, depth, matched);
+				continue;
+			}
+
+			for (const PatternPredicate& pred : state.alternatives)
+			{
+				if (pred.matches(script, code))
+				{
+					add_thread(next, _states, thread.state + 1, 0, matched);
+					break;
+				}
+			}
+		}
+
+		if (matched)
+		{
+			match = { begin, static_cast<uint16_t>(offset + 1) };
+			return true;
+		}
+		std::swap(threads, next);
+	}
+	return false;
+}
+
+Result<ScriptPattern> ScriptPattern::compile(const std::string& source)
+{
+	ScriptPattern pattern{};
+
+	std::stringstream ss{ source };
+	std::string element{};
+	while (ss >> element)
+	{
+		PatternState state{ {}, element == "..." };
+		if (state.gap)
+		{
+			if (pattern._states.empty() || !pattern._states.back().gap)
+				pattern._states.push_back(state);
+			continue;
+		}
+
+		size_t start = 0;
+		for (;;)
+		{
+			const size_t bar = element.find('|', start);
+			const std::string alternative = element.substr(start, bar == std::string::npos ? std::string::npos : bar - start);
+			if (alternative == "...")
+				return MISPLACED_GAP;
+			if (alternative.empty())
+				return INVALID_ELEMENT;
+
+			const Result<PatternPredicate> pred = parse_predicate(alternative);
+			if (!pred)
+				return pred.error();
+			state.alternatives.push_back(pred.value());
+
+			if (bar == std::string::npos)
+				break;
+			start = bar + 1;
+		}
+		pattern._states.push_back(state);
+	}
+
+	while (!pattern._states.empty() && pattern._states.front().gap)
+		pattern._states.erase(pattern._states.begin());
+	while (!pattern._states.empty() && pattern._states.back().gap)
+		pattern._states.pop_back();
+	if (pattern._states.empty())
+		return EMPTY_PATTERN;
+
+	const PatternState& first = pattern._states.front();
+	if (std::all_of(first.alternatives.begin(), first.alternatives.end(), [](const PatternPredicate& pred) { return pred.kind == PatternPredicateKind::Token; }))
+		for (const PatternPredicate& pred : first.alternatives)
+			pattern._anchors.push_back(pred.code);
+
+	return pattern;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+
+#include "script.h"
+#include "script_index.h"
+#include "result.h"
+
+enum class PatternPredicateKind : uint8_t
+{
+	Any,
+	Token,
+	AnyToken,
+	Field,
+	AnyField
+};
+
+struct PatternPredicate
+{
+	PatternPredicateKind kind;
+	ScriptCode code;
+	FieldType fieldType;
+	bool hasValue;
+	field_value_t value;
+
+	bool matches(const Script& script, ScriptCode code) const;
+};
+
+struct PatternState
+{
+	std::vector<PatternPredicate> alternatives;
+	bool gap;
+};
+
+struct PatternMatch
+{
+	uint16_t begin;
+	uint16_t end;
+};
+
+struct ScriptPatternHit
+{
+	uint32_t script;
+	PatternMatch match;
+};
+
+class ScriptPattern
+{
+private:
+	std::vector<PatternState> _states;
+	std::vector<ScriptCode> _anchors;
+
+	ScriptPattern();
+
+public:
+	size_t stateCount() const;
+	const std::vector<ScriptCode>& anchors() const;
+
+	std::vector<PatternMatch> match(const Script& script) const;
+	bool matches(const Script& script) const;
+
+	std::vector<ScriptPatternHit> search(const ScriptIndex& index) const;
+
+private:
+	bool matchAt(const Script& script, uint16_t begin, uint16_t length, PatternMatch& match) const;
+
+public:
+	static Result<ScriptPattern> compile(const std::string& source);
+};
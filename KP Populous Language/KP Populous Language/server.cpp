@@ -0,0 +1,400 @@
+#include "server.h"
+
+#include <sstream>
+#include <cstdlib>
+#include <cctype>
+
+#include "datatypes.h"
+#include "parser_elements.h"
+
+namespace
+{
+	class RpcError : public std::exception
+	{
+	private:
+		int _code;
+		std::string _message;
+
+	public:
+		RpcError(int code, const std::string& message) : _code{ code }, _message{ message } {}
+
+		int code() const { return _code; }
+		const std::string& message() const { return _message; }
+	};
+
+	enum RpcErrorCode : int
+	{
+		ParseError = -32700,
+		InvalidRequest = -32600,
+		MethodNotFound = -32601,
+		InvalidParams = -32602,
+		InternalError = -32603
+	};
+
+
+	class JsonParser
+	{
+	private:
+		const std::string& _text;
+		size_t _pos;
+
+	public:
+		JsonParser(const std::string& text) : _text{ text }, _pos{ 0 } {}
+
+		_JsonValue parse()
+		{
+			_JsonValue value = parseValue();
+			skipSpaces();
+			if (_pos < _text.size())
+				throw RpcError{ ParseError, "Trailing characters" };
+			return value;
+		}
+
+	private:
+		void skipSpaces()
+		{
+			while (_pos < _text.size() && std::isspace(static_cast<unsigned char>(_text[_pos])))
+				++_pos;
+		}
+
+		char peek()
+		{
+			skipSpaces();
+			if (_pos >= _text.size())
+				throw RpcError{ ParseError, "Unexpected end of input" };
+			return _text[_pos];
+		}
+
+		void expect(const char c)
+		{
+			if (peek() != c)
+				throw RpcError{ ParseError, std::string{ "Expected '" } + c + "'" };
+			++_pos;
+		}
+
+		bool consume(const std::string& word)
+		{
+			if (_text.compare(_pos, word.size(), word) != 0)
+				return false;
+			_pos += word.size();
+			return true;
+		}
+
+		_JsonValue parseValue()
+		{
+			_JsonValue value{ _JsonType::Null, false, 0, {}, {}, {} };
+			const char c = peek();
+			if (c == '{')
+			{
+				value.type = _JsonType::Object;
+				++_pos;
+				if (peek() == '}')
+					return ++_pos, value;
+				for (;;)
+				{
+					const std::string key = parseString();
+					expect(':');
+					value.object[key] = parseValue();
+					if (peek() == '}')
+						return ++_pos, value;
+					expect(',');
+				}
+			}
+			if (c == '[')
+			{
+				value.type = _JsonType::Array;
+				++_pos;
+				if (peek() == ']')
+					return ++_pos, value;
+				for (;;)
+				{
+					value.array.push_back(parseValue());
+					if (peek() == ']')
+						return ++_pos, value;
+					expect(',');
+				}
+			}
+			if (c == '"')
+			{
+				value.type = _JsonType::String;
+				value.string = parseString();
+				return value;
+			}
+			if (consume("true") || consume("false"))
+			{
+				value.type = _JsonType::Boolean;
+				value.boolean = _text[_pos - 2] == 'u';
+				return value;
+			}
+			if (consume("null"))
+				return value;
+
+			const char* const begin = _text.c_str() + _pos;
+			char* end = nullptr;
+			value.number = std::strtod(begin, &end);
+			if (end == begin)
+				throw RpcError{ ParseError, "Invalid value" };
+			value.type = _JsonType::Number;
+			_pos += end - begin;
+			return value;
+		}
+
+		std::string parseString()
+		{
+			expect('"');
+			std::string str{};
+			while (_pos < _text.size() && _text[_pos] != '"')
+			{
+				char c = _text[_pos++];
+				if (c == '\\' && _pos < _text.size())
+				{
+					c = _text[_pos++];
+					switch (c)
+					{
+						case 'n': c = '\n'; break;
+						case 't': c = '\t'; break;
+						case 'r': c = '\r'; break;
+						case 'b': c = '\b'; break;
+						case 'f': c = '\f'; break;
+						case 'u':
+							c = static_cast<char>(std::strtol(_text.substr(_pos, 4).c_str(), nullptr, 16));
+							_pos += 4;
+							break;
+					}
+				}
+				str.push_back(c);
+			}
+			expect('"');
+			return str;
+		}
+	};
+
+
+	std::string json_string(const std::string& str)
+	{
+		std::string result{ "\"" };
+		for (const char c : str)
+		{
+			switch (c)
+			{
+				case '"': result += "\\\""; break;
+				case '\\': result += "\\\\"; break;
+				case '\n': result += "\\n"; break;
+				case '\t': result += "\\t"; break;
+				case '\r': result += "\\r"; break;
+				default: result.push_back(c); break;
+			}
+		}
+		return result + "\"";
+	}
+
+	std::string json_string_array(const std::vector<std::string>& strs)
+	{
+		std::stringstream ss{};
+		ss << "[";
+		for (size_t i = 0; i < strs.size(); ++i)
+			ss << (i > 0 ? "," : "") << json_string(strs[i]);
+		ss << "]";
+		return ss.str();
+	}
+
+	std::string json_id(const _JsonValue* id)
+	{
+		if (!id)
+			return "null";
+		if (id->type == _JsonType::String)
+			return json_string(id->string);
+		if (id->type == _JsonType::Number)
+			return std::to_string(static_cast<long long>(id->number));
+		return "null";
+	}
+
+	std::string error_reply(const _JsonValue* id, int code, const std::string& message)
+	{
+		return "{\"jsonrpc\":\"2.0\",\"id\":" + json_id(id) + ",\"error\":{\"code\":" +
+			std::to_string(code) + ",\"message\":" + json_string(message) + "}}";
+	}
+
+	const std::string& string_param(const _JsonValue& params, const std::string& name)
+	{
+		const _JsonValue* const value = params.get(name);
+		if (!value || value->type != _JsonType::String)
+			throw RpcError{ InvalidParams, "Expected string parameter '" + name + "'" };
+		return value->string;
+	}
+}
+
+const _JsonValue* _JsonValue::get(const std::string& key) const
+{
+	if (type != _JsonType::Object)
+		return nullptr;
+	const auto& it = object.find(key);
+	return it != object.end() ? &it->second : nullptr;
+}
+
+
+
+
+CompileServer::CompileServer() :
+	_scripts{},
+	_running{ true }
+{}
+
+bool CompileServer::isRunning() const { return _running; }
+
+void CompileServer::run(std::istream& input, std::ostream& output)
+{
+	std::string line{};
+	while (_running && std::getline(input, line))
+	{
+		if (line.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+
+		output << handle(line) << std::endl;
+	}
+}
+
+std::string CompileServer::handle(const std::string& request)
+{
+	const _JsonValue* id = nullptr;
+	_JsonValue root{};
+	try
+	{
+		root = JsonParser{ request }.parse();
+		if (root.type != _JsonType::Object)
+			throw RpcError{ InvalidRequest, "Request must be an object" };
+
+		id = root.get("id");
+		const _JsonValue* const method = root.get("method");
+		if (!method || method->type != _JsonType::String)
+			throw RpcError{ InvalidRequest, "Missing method" };
+
+		const _JsonValue* params = root.get("params");
+		const _JsonValue empty{ _JsonType::Object, false, 0, {}, {}, {} };
+		if (!params)
+			params = &empty;
+
+		std::string result{};
+		if (method->string == "hover")
+			result = hover(*params);
+		else if (method->string == "types")
+			result = types(*params);
+		else if (method->string == "load")
+			result = load(*params);
+		else if (method->string == "unload")
+			result = unload(*params);
+		else if (method->string == "diagnostics")
+			result = diagnostics(*params);
+		else if (method->string == "shutdown")
+			result = shutdown(*params);
+		else throw RpcError{ MethodNotFound, "Unknown method '" + method->string + "'" };
+
+		return "{\"jsonrpc\":\"2.0\",\"id\":" + json_id(id) + ",\"result\":" + result + "}";
+	}
+	catch (const RpcError& ex)
+	{
+		return error_reply(id, ex.code(), ex.message());
+	}
+	catch (const std::exception& ex)
+	{
+		return error_reply(id, InternalError, ex.what());
+	}
+}
+
+std::string CompileServer::hover(const _JsonValue& params)
+{
+	const std::string& name = string_param(params, "name");
+
+	if (DataType::isValidType(name))
+	{
+		const DataType type = DataType::getType(name);
+		return "{\"kind\":\"type\",\"name\":" + json_string(type.name()) +
+			",\"values\":" + json_string_array(type.availableValues()) + "}";
+	}
+
+	const DataType type = DataType::findTypeFromValueName(name);
+	if (type)
+	{
+		return "{\"kind\":\"constant\",\"name\":" + json_string(name) +
+			",\"type\":" + json_string(type.name()) +
+			",\"value\":" + std::to_string(type.getIdentifierValue(name)) + "}";
+	}
+
+	if (Identifier::isValid(name))
+		return "{\"kind\":\"identifier\",\"name\":" + json_string(name) + "}";
+	return "null";
+}
+
+std::string CompileServer::types(const _JsonValue&)
+{
+	return json_string_array(DataType::availableTypes());
+}
+
+std::string CompileServer::load(const _JsonValue& params)
+{
+	const std::string& file = string_param(params, "file");
+
+	Script& script = _scripts[file];
+	if (!script.readFromFile(file))
+	{
+		_scripts.erase(file);
+		throw RpcError{ InvalidParams, "Cannot read script '" + file + "'" };
+	}
+
+	uint16_t count = 1;
+	while (count < MAX_CODES && script.codeData[count] != InstructionToken::ScriptEnd)
+		++count;
+
+	return "{\"file\":" + json_string(file) + ",\"version\":" + std::to_string(script.getVersion()) +
+		",\"codes\":" + std::to_string(count) + "}";
+}
+
+std::string CompileServer::unload(const _JsonValue& params)
+{
+	return _scripts.erase(string_param(params, "file")) ? "true" : "false";
+}
+
+std::string CompileServer::diagnostics(const _JsonValue& params)
+{
+	const std::string& file = string_param(params, "file");
+	const auto& it = _scripts.find(file);
+	if (it == _scripts.end())
+		throw RpcError{ InvalidParams, "Script '" + file + "' is not loaded" };
+
+	const Script& script = it->second;
+	std::stringstream ss{};
+	bool first = true;
+	const auto report = [&ss, &first](int offset, const std::string& message) {
+		ss << (first ? "" : ",") << "{\"offset\":" << offset << ",\"message\":" << json_string(message) << "}";
+		first = false;
+	};
+
+	ss << "[";
+	if (script.getVersion() != SCRIPT_VERSION)
+		report(0, "Unsupported script version " + std::to_string(script.getVersion()));
+
+	int offset = 1;
+	for (; offset < static_cast<int>(MAX_CODES); ++offset)
+	{
+		const ScriptCode code = script.codeData[offset];
+		if (code == InstructionToken::ScriptEnd)
+			break;
+		if (code >= TOKEN_OFFSET)
+			continue;
+		if (code >= MAX_FIELDS)
+			report(offset, "Field index " + std::to_string(code) + " out of range");
+		else if (script.fieldData[code].isInvalid())
+			report(offset, "Reference to invalid field " + std::to_string(code));
+	}
+	if (offset >= static_cast<int>(MAX_CODES))
+		report(offset, "Missing ScriptEnd token");
+	ss << "]";
+
+	return ss.str();
+}
+
+std::string CompileServer::shutdown(const _JsonValue&)
+{
+	_running = false;
+	return "null";
+}
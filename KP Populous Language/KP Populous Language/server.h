@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <istream>
+#include <ostream>
+
+#include "script.h"
+
+namespace
+{
+	enum class _JsonType
+	{
+		Null,
+		Boolean,
+		Number,
+		String,
+		Array,
+		Object
+	};
+
+	struct _JsonValue
+	{
+		_JsonType type;
+		bool boolean;
+		double number;
+		std::string string;
+		std::vector<_JsonValue> array;
+		std::map<std::string, _JsonValue> object;
+
+		const _JsonValue* get(const std::string& key) const;
+	};
+}
+
+
+class CompileServer
+{
+private:
+	std::map<std::string, Script> _scripts;
+	bool _running;
+
+public:
+	CompileServer();
+
+	bool isRunning() const;
+
+	void run(std::istream& input, std::ostream& output);
+
+	std::string handle(const std::string& request);
+
+private:
+	std::string hover(const _JsonValue& params);
+	std::string types(const _JsonValue& params);
+	std::string load(const _JsonValue& params);
+	std::string unload(const _JsonValue& params);
+	std::string diagnostics(const _JsonValue& params);
+	std::string shutdown(const _JsonValue& params);
+};
@@ -0,0 +1,251 @@
+#include "source_map.h"
+
+#include <algorithm>
+#include <fstream>
+
+namespace
+{
+	const char MAGIC[4] = { 'K', 'P', 'S', 'M' };
+	const uint8_t FORMAT_VERSION = 1;
+	const uint32_t MAX_COUNT = 1U << 24;
+	const size_t MIN_ENTRY_SIZE = 5;
+
+	void write_varint(std::ostream& output, uint32_t value)
+	{
+		while (value >= 0x80)
+		{
+			output.put(static_cast<char>((value & 0x7f) | 0x80));
+			value >>= 7;
+		}
+		output.put(static_cast<char>(value));
+	}
+
+	uint32_t read_varint(std::istream& input)
+	{
+		uint32_t value = 0;
+		for (unsigned int shift = 0; shift < 35; shift += 7)
+		{
+			const int c = input.get();
+			if (c == std::char_traits<char>::eof())
+				throw BadSourceMap{};
+			value |= static_cast<uint32_t>(c & 0x7f) << shift;
+			if (!(c & 0x80))
+				return value;
+		}
+		throw BadSourceMap{};
+	}
+
+	size_t remaining(std::istream& input)
+	{
+		const std::streampos pos = input.tellg();
+		if (pos < 0)
+			return MAX_COUNT;
+
+		input.seekg(0, std::ios::end);
+		const std::streampos end = input.tellg();
+		input.seekg(pos);
+		return end > pos ? static_cast<size_t>(end - pos) : 0;
+	}
+
+	uint32_t read_count(std::istream& input, size_t itemSize)
+	{
+		const uint32_t count = read_varint(input);
+		if (count > MAX_COUNT || count > remaining(input) / itemSize)
+			throw BadSourceMap{};
+		return count;
+	}
+
+	void write_delta(std::ostream& output, uint32_t value, uint32_t previous)
+	{
+		const int32_t delta = static_cast<int32_t>(value - previous);
+		write_varint(output, (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31));
+	}
+
+	uint32_t read_delta(std::istream& input, uint32_t previous)
+	{
+		const uint32_t zigzag = read_varint(input);
+		const int32_t delta = static_cast<int32_t>((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+		return previous + static_cast<uint32_t>(delta);
+	}
+
+	void write_strings(std::ostream& output, const std::vector<std::string>& strs)
+	{
+		write_varint(output, static_cast<uint32_t>(strs.size()));
+		for (const std::string& str : strs)
+		{
+			write_varint(output, static_cast<uint32_t>(str.size()));
+			output.write(str.data(), str.size());
+		}
+	}
+
+	void read_strings(std::istream& input, std::vector<std::string>& strs)
+	{
+		strs.resize(read_count(input, 1));
+		for (std::string& str : strs)
+		{
+			str.resize(read_count(input, 1));
+			if (!str.empty() && !input.read(&str[0], str.size()))
+				throw BadSourceMap{};
+		}
+	}
+
+	void write_entries(std::ostream& output, const std::vector<SourceMapEntry>& entries)
+	{
+		write_varint(output, static_cast<uint32_t>(entries.size()));
+
+		SourceMapEntry prev{};
+		for (const SourceMapEntry& entry : entries)
+		{
+			write_varint(output, entry.index - prev.index);
+			write_delta(output, entry.location.file, prev.location.file);
+			write_delta(output, entry.location.line, prev.location.line);
+			write_varint(output, entry.location.column);
+			write_delta(output, entry.location.symbol, prev.location.symbol);
+			prev = entry;
+		}
+	}
+
+	void read_entries(std::istream& input, std::vector<SourceMapEntry>& entries)
+	{
+		entries.resize(read_count(input, MIN_ENTRY_SIZE));
+
+		SourceMapEntry prev{};
+		for (SourceMapEntry& entry : entries)
+		{
+			entry.index = static_cast<uint16_t>(prev.index + read_varint(input));
+			entry.location.file = read_delta(input, prev.location.file);
+			entry.location.line = read_delta(input, prev.location.line);
+			entry.location.column = read_varint(input);
+			entry.location.symbol = read_delta(input, prev.location.symbol);
+			prev = entry;
+		}
+	}
+
+	bool entry_before(const SourceMapEntry& entry, uint16_t index) { return entry.index < index; }
+}
+
+
+SourceMap::SourceMap() :
+	_files{},
+	_symbols{},
+	_codes{},
+	_fields{}
+{
+	clear();
+}
+
+uint32_t SourceMap::file(const std::string& name)
+{
+	const auto& it = std::find(_files.begin(), _files.end(), name);
+	if (it != _files.end())
+		return static_cast<uint32_t>(it - _files.begin());
+	_files.push_back(name);
+	return static_cast<uint32_t>(_files.size() - 1);
+}
+
+uint32_t SourceMap::symbol(const std::string& name)
+{
+	const auto& it = std::find(_symbols.begin(), _symbols.end(), name);
+	if (it != _symbols.end())
+		return static_cast<uint32_t>(it - _symbols.begin());
+	_symbols.push_back(name);
+	return static_cast<uint32_t>(_symbols.size() - 1);
+}
+
+const std::string& SourceMap::fileName(const SourceLocation& location) const
+{
+	return location.file < _files.size() ? _files[location.file] : _files.front();
+}
+
+const std::string& SourceMap::symbolName(const SourceLocation& location) const
+{
+	return location.symbol < _symbols.size() ? _symbols[location.symbol] : _symbols.front();
+}
+
+void SourceMap::add(SourceMapTarget target, uint16_t index, const SourceLocation& location)
+{
+	std::vector<SourceMapEntry>& vec = entries(target);
+	if (vec.empty() || vec.back().index < index)
+	{
+		vec.push_back({ index, location });
+		return;
+	}
+
+	const auto& it = std::lower_bound(vec.begin(), vec.end(), index, entry_before);
+	if (it != vec.end() && it->index == index)
+		it->location = location;
+	else vec.insert(it, { index, location });
+}
+
+const SourceLocation* SourceMap::find(SourceMapTarget target, uint16_t index) const
+{
+	const std::vector<SourceMapEntry>& vec = entries(target);
+	const auto& it = std::lower_bound(vec.begin(), vec.end(), index, entry_before);
+	return it != vec.end() && it->index == index ? &it->location : nullptr;
+}
+
+size_t SourceMap::size(SourceMapTarget target) const { return entries(target).size(); }
+bool SourceMap::empty() const { return _codes.empty() && _fields.empty(); }
+
+void SourceMap::clear()
+{
+	_files.assign(1, "");
+	_symbols.assign(1, "");
+	_codes.clear();
+	_fields.clear();
+}
+
+void SourceMap::read(std::istream& input)
+{
+	char magic[sizeof(MAGIC)];
+	if (!input.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), MAGIC) || input.get() != FORMAT_VERSION)
+		throw BadSourceMap{};
+
+	read_strings(input, _files);
+	read_strings(input, _symbols);
+	if (_files.empty() || _symbols.empty())
+		throw BadSourceMap{};
+
+	read_entries(input, _codes);
+	read_entries(input, _fields);
+}
+
+void SourceMap::write(std::ostream& output) const
+{
+	output.write(MAGIC, sizeof(MAGIC));
+	output.put(static_cast<char>(FORMAT_VERSION));
+
+	write_strings(output, _files);
+	write_strings(output, _symbols);
+
+	write_entries(output, _codes);
+	write_entries(output, _fields);
+}
+
+bool SourceMap::readFromFile(const std::string& file)
+{
+	std::ifstream f{ file, std::ios::in | std::ios::binary };
+	if (!f)
+		return false;
+
+	try { read(f); }
+	catch (const BadSourceMap&)
+	{
+		clear();
+		return false;
+	}
+	return true;
+}
+
+bool SourceMap::writeToFile(const std::string& file) const
+{
+	std::ofstream f{ file, std::ios::out | std::ios::binary | std::ios::trunc };
+	write(f);
+	f.flush();
+	return static_cast<bool>(f);
+}
+
+std::vector<SourceMapEntry>& SourceMap::entries(SourceMapTarget target) { return target == SourceMapTarget::Code ? _codes : _fields; }
+const std::vector<SourceMapEntry>& SourceMap::entries(SourceMapTarget target) const { return target == SourceMapTarget::Code ? _codes : _fields; }
+
+std::string SourceMap::sidecarFile(const std::string& scriptFile) { return scriptFile + ".map"; }
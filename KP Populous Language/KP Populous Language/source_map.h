@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+
+#include "script.h"
+
+enum class SourceMapTarget : uint8_t
+{
+	Code,
+	Field
+};
+
+struct SourceLocation
+{
+	uint32_t file;
+	uint32_t line;
+	uint32_t column;
+	uint32_t symbol;
+};
+
+struct SourceMapEntry
+{
+	uint16_t index;
+	SourceLocation location;
+};
+
+class SourceMap
+{
+private:
+	std::vector<std::string> _files;
+	std::vector<std::string> _symbols;
+	std::vector<SourceMapEntry> _codes;
+	std::vector<SourceMapEntry> _fields;
+
+public:
+	SourceMap();
+
+	uint32_t file(const std::string& name);
+	uint32_t symbol(const std::string& name);
+
+	const std::string& fileName(const SourceLocation& location) const;
+	const std::string& symbolName(const SourceLocation& location) const;
+
+	void add(SourceMapTarget target, uint16_t index, const SourceLocation& location);
+
+	const SourceLocation* find(SourceMapTarget target, uint16_t index) const;
+
+	size_t size(SourceMapTarget target) const;
+	bool empty() const;
+
+	void clear();
+
+	void read(std::istream& input);
+	void write(std::ostream& output) const;
+
+	bool readFromFile(const std::string& file);
+	bool writeToFile(const std::string& file) const;
+
+private:
+	std::vector<SourceMapEntry>& entries(SourceMapTarget target);
+	const std::vector<SourceMapEntry>& entries(SourceMapTarget target) const;
+
+public:
+	static std::string sidecarFile(const std::string& scriptFile);
+};
+
+class BadSourceMap : public std::exception {};
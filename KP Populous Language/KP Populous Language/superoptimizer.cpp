@@ -0,0 +1,747 @@
+#include "superoptimizer.h"
+
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <random>
+#include <limits>
+#include <cstring>
+#include <cctype>
+#include <iterator>
+
+#include "token_names.h"
+#include "profiler.h"
+
+namespace
+{
+	constexpr int64_t POISON = std::numeric_limits<int64_t>::min();
+	constexpr unsigned int MAX_SEQUENCE_LENGTH = 16;
+	constexpr uint64_t ENUMERATION_CHUNK = 4096;
+	constexpr uint64_t VERIFICATION_CHUNK = 64;
+
+	constexpr ScriptCode OPERATORS[] = {
+		InstructionToken::Multiply,
+		InstructionToken::Divide,
+		InstructionToken::GreaterThan,
+		InstructionToken::LessThan,
+		InstructionToken::Equalto,
+		InstructionToken::NotEqualTo,
+		InstructionToken::GreaterThanEqualTo,
+		InstructionToken::LessThanEqualTo,
+		InstructionToken::And,
+		InstructionToken::Or,
+		InstructionToken::ExpStart,
+		InstructionToken::ExpEnd
+	};
+
+	constexpr field_value_t GRID_VALUES[] = { -2, -1, 0, 1, 2, 5 };
+	constexpr field_value_t VERIFY_MIN = -4;
+	constexpr field_value_t VERIFY_MAX = 4;
+
+	bool is_slot(ScriptCode symbol) { return symbol < SUPEROPT_MAX_SLOTS; }
+	bool is_constant(ScriptCode symbol) { return symbol >= SUPEROPT_CONSTANT_BASE && symbol < TOKEN_OFFSET; }
+
+	bool is_comparison(ScriptCode code)
+	{
+		return code == InstructionToken::GreaterThan || code == InstructionToken::LessThan || code == InstructionToken::Equalto ||
+			code == InstructionToken::NotEqualTo || code == InstructionToken::GreaterThanEqualTo || code == InstructionToken::LessThanEqualTo;
+	}
+
+	bool is_better(const TokenSequence& left, const TokenSequence& right)
+	{
+		return left.size() < right.size() || (left.size() == right.size() && left < right);
+	}
+
+	bool is_canonical(const TokenSequence& sequence)
+	{
+		ScriptCode next = 0;
+		for (const ScriptCode symbol : sequence)
+		{
+			if (!is_slot(symbol))
+				continue;
+			if (symbol > next)
+				return false;
+			if (symbol == next)
+				++next;
+		}
+		return true;
+	}
+
+	bool uses_only(const TokenSequence& sequence, const TokenSequence& slots)
+	{
+		for (const ScriptCode symbol : sequence)
+		{
+			if (is_slot(symbol) && std::find(slots.begin(), slots.end(), symbol) == slots.end())
+				return false;
+		}
+		return true;
+	}
+
+	size_t hash_combine(size_t seed, size_t value) { return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2)); }
+
+
+	class SequenceCompiler
+	{
+	private:
+		const TokenSequence& _sequence;
+		TokenSequence& _program;
+		size_t _pos;
+		bool _failed;
+
+	public:
+		SequenceCompiler(const TokenSequence& sequence, TokenSequence& program) :
+			_sequence{ sequence },
+			_program{ program },
+			_pos{ 0 },
+			_failed{ false }
+		{}
+
+		bool compile()
+		{
+			_program.clear();
+			expression();
+			return !_failed && _pos == _sequence.size();
+		}
+
+	private:
+		ScriptCode peek() const { return _pos < _sequence.size() ? _sequence[_pos] : static_cast<ScriptCode>(InstructionToken::ScriptEnd); }
+
+		void expression()
+		{
+			comparison();
+			while (!_failed && (peek() == InstructionToken::And || peek() == InstructionToken::Or))
+			{
+				const ScriptCode op = _sequence[_pos++];
+				comparison();
+				_program.push_back(op);
+			}
+		}
+
+		void comparison()
+		{
+			product();
+			if (!_failed && is_comparison(peek()))
+			{
+				const ScriptCode op = _sequence[_pos++];
+				product();
+				_program.push_back(op);
+			}
+		}
+
+		void product()
+		{
+			factor();
+			while (!_failed && (peek() == InstructionToken::Multiply || peek() == InstructionToken::Divide))
+			{
+				const ScriptCode op = _sequence[_pos++];
+				factor();
+				_program.push_back(op);
+			}
+		}
+
+		void factor()
+		{
+			const ScriptCode code = peek();
+			if (code == InstructionToken::ExpStart)
+			{
+				++_pos;
+				expression();
+				if (peek() != InstructionToken::ExpEnd)
+					_failed = true;
+				++_pos;
+			}
+			else if (code < TOKEN_OFFSET)
+			{
+				_program.push_back(code);
+				++_pos;
+			}
+			else _failed = true;
+		}
+	};
+
+	int64_t apply(ScriptCode op, int64_t left, int64_t right)
+	{
+		if (left == POISON || right == POISON)
+			return POISON;
+
+		int64_t value = 0;
+		switch (op)
+		{
+			case InstructionToken::Multiply: value = left * right; break;
+			case InstructionToken::Divide:
+				if (right == 0)
+					return POISON;
+				value = left / right;
+				break;
+			case InstructionToken::GreaterThan: value = left > right; break;
+			case InstructionToken::LessThan: value = left < right; break;
+			case InstructionToken::Equalto: value = left == right; break;
+			case InstructionToken::NotEqualTo: value = left != right; break;
+			case InstructionToken::GreaterThanEqualTo: value = left >= right; break;
+			case InstructionToken::LessThanEqualTo: value = left <= right; break;
+			case InstructionToken::And: value = left != 0 && right != 0; break;
+			case InstructionToken::Or: value = left != 0 || right != 0; break;
+			default: return POISON;
+		}
+		return value < std::numeric_limits<field_value_t>::min() || value > std::numeric_limits<field_value_t>::max() ? POISON : value;
+	}
+
+	int64_t evaluate(const TokenSequence& program, const field_value_t* inputs)
+	{
+		int64_t stack[MAX_SEQUENCE_LENGTH];
+		size_t top = 0;
+		for (const ScriptCode code : program)
+		{
+			if (is_slot(code))
+				stack[top++] = inputs[code];
+			else if (is_constant(code))
+				stack[top++] = code - SUPEROPT_CONSTANT_BASE;
+			else
+			{
+				--top;
+				stack[top - 1] = apply(code, stack[top - 1], stack[top]);
+			}
+		}
+		return stack[0];
+	}
+
+	int64_t observe(RewriteContext context, int64_t value)
+	{
+		return context == RewriteContext::Value || value == POISON ? value : value != 0;
+	}
+
+	std::vector<field_value_t> grid(unsigned int slots, const field_value_t* values, size_t count)
+	{
+		std::vector<field_value_t> inputs{};
+		std::vector<size_t> digits(slots, 0);
+		for (;;)
+		{
+			for (const size_t digit : digits)
+				inputs.push_back(values[digit]);
+
+			size_t i = 0;
+			while (i < slots && ++digits[i] == count)
+				digits[i++] = 0;
+			if (i == slots)
+				return inputs;
+		}
+	}
+
+	std::vector<field_value_t> random_inputs(unsigned int slots, unsigned int samples, uint64_t seed)
+	{
+		std::mt19937_64 rng{ seed };
+		std::uniform_int_distribution<field_value_t> small{ -64, 64 };
+		std::uniform_int_distribution<field_value_t> wide{ std::numeric_limits<field_value_t>::min(), std::numeric_limits<field_value_t>::max() };
+		std::bernoulli_distribution pickWide{ 0.25 };
+
+		std::vector<field_value_t> inputs{};
+		inputs.reserve(static_cast<size_t>(slots) * samples);
+		for (unsigned int i = 0; i < samples * slots; ++i)
+			inputs.push_back(pickWide(rng) ? wide(rng) : small(rng));
+		return inputs;
+	}
+
+	template<class _FnTy>
+	void parallel_chunks(uint64_t count, uint64_t chunk, unsigned int threads, _FnTy&& fn)
+	{
+		std::atomic<uint64_t> next{ 0 };
+		const auto worker = [&next, &fn, count, chunk](unsigned int id) {
+			for (uint64_t begin = next.fetch_add(chunk); begin < count; begin = next.fetch_add(chunk))
+				fn(id, begin, std::min(begin + chunk, count));
+		};
+
+		std::vector<std::thread> workers{};
+		const uint64_t workerCount = std::min<uint64_t>(threads, (count + chunk - 1) / chunk);
+		for (unsigned int i = 1; i < workerCount; ++i)
+			workers.emplace_back(worker, i);
+		worker(0);
+		for (std::thread& thread : workers)
+			thread.join();
+	}
+
+
+	struct Candidate
+	{
+		TokenSequence sequence;
+		uint64_t value;
+		uint64_t condition;
+	};
+
+	struct EnumerationState
+	{
+		std::unordered_map<uint64_t, TokenSequence> values;
+		std::unordered_map<uint64_t, TokenSequence> conditions;
+		std::vector<Candidate> candidates;
+		uint64_t valid;
+	};
+
+	void keep_best(std::unordered_map<uint64_t, TokenSequence>& classes, uint64_t key, const TokenSequence& sequence)
+	{
+		const auto it = classes.find(key);
+		if (it == classes.end())
+			classes.emplace(key, sequence);
+		else if (is_better(sequence, it->second))
+			it->second = sequence;
+	}
+
+	struct PendingRule
+	{
+		RewriteContext context;
+		const TokenSequence* pattern;
+		const TokenSequence* replacement;
+		bool verified;
+	};
+
+
+	std::string symbol_name(ScriptCode symbol)
+	{
+		if (is_slot(symbol))
+			return "$" + std::to_string(symbol);
+		if (is_constant(symbol))
+			return "#" + std::to_string(symbol - SUPEROPT_CONSTANT_BASE);
+
+		const char* const name = token_name(symbol);
+		return name ? name : std::to_string(symbol);
+	}
+
+	bool parse_symbol(const std::string& name, ScriptCode& symbol)
+	{
+		if (name.size() > 1 && (name[0] == '$' || name[0] == '#') && std::all_of(name.begin() + 1, name.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; }))
+		{
+			const unsigned long value = std::stoul(name.substr(1));
+			if (name[0] == '$' ? value >= SUPEROPT_MAX_SLOTS : value >= SUPEROPT_MAX_CONSTANT)
+				return false;
+			symbol = static_cast<ScriptCode>(name[0] == '$' ? value : SUPEROPT_CONSTANT_BASE + value);
+			return true;
+		}
+		return find_token(name, symbol) && symbol >= TOKEN_OFFSET;
+	}
+
+	bool canonicalize(const Script& script, const std::vector<ScriptCode>& codes, size_t begin, size_t end, bool constants,
+		TokenSequence& pattern, std::vector<ScriptCode>& slots)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			const ScriptCode code = codes[i];
+			if (code >= TOKEN_OFFSET)
+			{
+				pattern.push_back(code);
+				continue;
+			}
+			if (code >= MAX_FIELDS || script.fieldData[code].isInvalid() || script.fieldData[code].isVolatile())
+				return false;
+
+			const ScriptField& field = script.fieldData[code];
+			if (constants && field.isConstant() && field.value >= 0 && static_cast<uint32_t>(field.value) < SUPEROPT_MAX_CONSTANT)
+			{
+				pattern.push_back(static_cast<ScriptCode>(SUPEROPT_CONSTANT_BASE + field.value));
+				continue;
+			}
+
+			const auto it = std::find(slots.begin(), slots.end(), code);
+			if (it == slots.end() && slots.size() >= SUPEROPT_MAX_SLOTS)
+				return false;
+			pattern.push_back(static_cast<ScriptCode>(it - slots.begin()));
+			if (it == slots.end())
+				slots.push_back(code);
+		}
+		return true;
+	}
+
+	bool materialize(Script& script, const TokenSequence& replacement, const std::vector<ScriptCode>& slots, std::vector<ScriptCode>& codes)
+	{
+		for (const ScriptCode symbol : replacement)
+		{
+			if (is_slot(symbol))
+			{
+				if (symbol >= slots.size())
+					return false;
+				codes.push_back(slots[symbol]);
+			}
+			else if (is_constant(symbol))
+			{
+				const uint16_t field = script.addField({ FieldType::Constant, static_cast<field_value_t>(symbol - SUPEROPT_CONSTANT_BASE) });
+				if (field >= MAX_FIELDS)
+					return false;
+				codes.push_back(field);
+			}
+			else codes.push_back(symbol);
+		}
+		return true;
+	}
+
+	bool find_group_end(const std::vector<ScriptCode>& codes, size_t begin, size_t end, size_t& close)
+	{
+		unsigned int depth = 0;
+		for (close = begin; close < end; ++close)
+		{
+			if (codes[close] == InstructionToken::ExpStart)
+				++depth;
+			else if (codes[close] == InstructionToken::ExpEnd && --depth == 0)
+				return true;
+		}
+		return false;
+	}
+}
+
+size_t TokenSequenceHash::operator() (const TokenSequence& sequence) const
+{
+	size_t seed = sequence.size();
+	for (const ScriptCode code : sequence)
+		seed = hash_combine(seed, code);
+	return seed;
+}
+
+
+
+
+RewriteTable::RewriteTable() :
+	_values{},
+	_conditions{},
+	_maxLength{ 0 }
+{}
+
+size_t RewriteTable::size() const { return _values.size() + _conditions.size(); }
+size_t RewriteTable::maxLength() const { return _maxLength; }
+
+void RewriteTable::add(RewriteContext context, const TokenSequence& pattern, const TokenSequence& replacement)
+{
+	rules(context)[pattern] = replacement;
+	_maxLength = std::max(_maxLength, pattern.size());
+}
+
+const TokenSequence* RewriteTable::find(RewriteContext context, const TokenSequence& pattern) const
+{
+	const auto& table = rules(context);
+	const auto it = table.find(pattern);
+	return it != table.end() ? &it->second : nullptr;
+}
+
+OptimizationStats RewriteTable::apply(Script& script) const
+{
+	PROFILE_SCOPE("RewriteTable::apply");
+
+	const uint16_t length = script.length();
+	if (size() == 0 || length < 2 || script.codeData[length - 1] != InstructionToken::ScriptEnd)
+		return {};
+
+	std::vector<ScriptCode> codes{ script.codeData + 1, script.codeData + length - 1 };
+	OptimizationStats stats{};
+	for (size_t pos = 0; pos < codes.size(); ++pos)
+	{
+		if (codes[pos] != InstructionToken::If)
+			continue;
+
+		size_t end = pos + 1;
+		while (end < codes.size() && Script::isConditionCode(codes[end]))
+			++end;
+
+		for (bool progress = true; progress;)
+		{
+			progress = false;
+			for (size_t open = pos + 1; open < end && !progress; ++open)
+			{
+				size_t close = 0;
+				if (codes[open] != InstructionToken::ExpStart || !find_group_end(codes, open, end, close))
+					continue;
+
+				const size_t before = codes.size();
+				rewrite(script, RewriteContext::Value, codes, open + 1, close);
+				close -= before - codes.size();
+				if (close - open == 2)
+				{
+					codes.erase(codes.begin() + close);
+					codes.erase(codes.begin() + open);
+				}
+
+				if (codes.size() != before)
+				{
+					end -= before - codes.size();
+					++stats.rewrites;
+					progress = true;
+				}
+			}
+		}
+
+		const size_t before = codes.size();
+		if (rewrite(script, RewriteContext::Condition, codes, pos + 1, end) || rewrite(script, RewriteContext::Value, codes, pos + 1, end))
+		{
+			end -= before - codes.size();
+			++stats.rewrites;
+		}
+		pos = end - 1;
+	}
+
+	if (!stats.rewrites)
+		return stats;
+
+	stats.codesSaved = length - 2 - static_cast<uint32_t>(codes.size());
+	codes.push_back(InstructionToken::ScriptEnd);
+	std::memset(script.codeData + 1, 0, (MAX_CODES - 1) * sizeof(ScriptCode));
+	std::memcpy(script.codeData + 1, codes.data(), codes.size() * sizeof(ScriptCode));
+	stats.fieldsSaved = compact_fields(script);
+	return stats;
+}
+
+bool RewriteTable::read(std::istream& input)
+{
+	std::string line{};
+	bool versioned = false;
+	while (std::getline(input, line))
+	{
+		std::istringstream ss{ line };
+		std::string word{};
+		if (!(ss >> word) || word[0] == '#')
+			continue;
+
+		if (!versioned)
+		{
+			unsigned int version = 0;
+			if (word != "rewrite-table" || !(ss >> version) || version != REWRITE_TABLE_VERSION)
+				return false;
+			versioned = true;
+			continue;
+		}
+
+		RewriteContext context;
+		if (word == "value")
+			context = RewriteContext::Value;
+		else if (word == "condition")
+			context = RewriteContext::Condition;
+		else return false;
+
+		TokenSequence pattern{};
+		TokenSequence replacement{};
+		TokenSequence* target = &pattern;
+		while (ss >> word)
+		{
+			ScriptCode symbol;
+			if (word == "=>" && target == &pattern)
+				target = &replacement;
+			else if (parse_symbol(word, symbol))
+				target->push_back(symbol);
+			else return false;
+		}
+		if (target != &replacement || pattern.empty() || replacement.empty())
+			return false;
+		add(context, pattern, replacement);
+	}
+	return versioned;
+}
+
+void RewriteTable::write(std::ostream& output) const
+{
+	output << "rewrite-table " << REWRITE_TABLE_VERSION << std::endl;
+	for (const RewriteContext context : { RewriteContext::Value, RewriteContext::Condition })
+	{
+		std::vector<std::pair<TokenSequence, TokenSequence>> entries{ rules(context).begin(), rules(context).end() };
+		std::sort(entries.begin(), entries.end(), [](const auto& left, const auto& right) { return is_better(left.first, right.first); });
+
+		for (const auto& entry : entries)
+		{
+			output << (context == RewriteContext::Value ? "value" : "condition");
+			for (const ScriptCode symbol : entry.first)
+				output << " " << symbol_name(symbol);
+			output << " =>";
+			for (const ScriptCode symbol : entry.second)
+				output << " " << symbol_name(symbol);
+			output << std::endl;
+		}
+	}
+}
+
+bool RewriteTable::readFromFile(const std::string& file)
+{
+	std::ifstream f{ file };
+	return f && read(f);
+}
+
+bool RewriteTable::writeToFile(const std::string& file) const
+{
+	std::ofstream f{ file };
+	if (!f)
+		return false;
+	write(f);
+	return static_cast<bool>(f);
+}
+
+bool RewriteTable::rewrite(Script& script, RewriteContext context, std::vector<ScriptCode>& codes, size_t begin, size_t end) const
+{
+	if (end <= begin || end - begin > _maxLength)
+		return false;
+
+	for (const bool constants : { true, false })
+	{
+		TokenSequence pattern{};
+		std::vector<ScriptCode> slots{};
+		if (!canonicalize(script, codes, begin, end, constants, pattern, slots))
+			continue;
+
+		const TokenSequence* const replacement = find(context, pattern);
+		std::vector<ScriptCode> materialized{};
+		if (!replacement || !materialize(script, *replacement, slots, materialized))
+			continue;
+
+		codes.erase(codes.begin() + begin, codes.begin() + end);
+		codes.insert(codes.begin() + begin, materialized.begin(), materialized.end());
+		return true;
+	}
+	return false;
+}
+
+const std::unordered_map<TokenSequence, TokenSequence, TokenSequenceHash>& RewriteTable::rules(RewriteContext context) const
+{
+	return context == RewriteContext::Value ? _values : _conditions;
+}
+
+std::unordered_map<TokenSequence, TokenSequence, TokenSequenceHash>& RewriteTable::rules(RewriteContext context)
+{
+	return context == RewriteContext::Value ? _values : _conditions;
+}
+
+
+
+
+Superoptimizer::Superoptimizer(unsigned int maxLength, unsigned int slots, const std::vector<field_value_t>& constants, unsigned int threads) :
+	_maxLength{ std::min(maxLength, MAX_SEQUENCE_LENGTH - 1) },
+	_slots{ std::min(slots, SUPEROPT_MAX_SLOTS) },
+	_constants{},
+	_threads{ threads > 0 ? threads : std::max(1U, std::thread::hardware_concurrency()) },
+	_samples{ 1024 },
+	_seed{ 0x5eed },
+	_candidates{ 0 },
+	_valid{ 0 }
+{
+	for (const field_value_t constant : constants)
+		if (constant >= 0 && static_cast<uint32_t>(constant) < SUPEROPT_MAX_CONSTANT)
+			_constants.push_back(constant);
+}
+
+void Superoptimizer::setSamples(unsigned int samples) { _samples = samples; }
+void Superoptimizer::setSeed(uint64_t seed) { _seed = seed; }
+
+RewriteTable Superoptimizer::build()
+{
+	PROFILE_SCOPE("Superoptimizer::build");
+
+	TokenSequence alphabet{};
+	for (ScriptCode slot = 0; slot < _slots; ++slot)
+		alphabet.push_back(slot);
+	for (const field_value_t constant : _constants)
+		alphabet.push_back(static_cast<ScriptCode>(SUPEROPT_CONSTANT_BASE + constant));
+	alphabet.insert(alphabet.end(), std::begin(OPERATORS), std::end(OPERATORS));
+
+	const unsigned int slotCount = std::max(_slots, 1U);
+	std::vector<field_value_t> inputs = grid(slotCount, GRID_VALUES, std::size(GRID_VALUES));
+	const std::vector<field_value_t> extra = random_inputs(slotCount, 16, _seed);
+	inputs.insert(inputs.end(), extra.begin(), extra.end());
+	const size_t tests = inputs.size() / slotCount;
+
+	std::vector<EnumerationState> states(_threads);
+	_candidates = 0;
+	for (unsigned int length = 1; length <= _maxLength; ++length)
+	{
+		uint64_t count = 1;
+		for (unsigned int i = 0; i < length; ++i)
+			count *= alphabet.size();
+		_candidates += count;
+
+		parallel_chunks(count, ENUMERATION_CHUNK, _threads, [&](unsigned int id, uint64_t begin, uint64_t end) {
+			EnumerationState& state = states[id];
+			TokenSequence sequence(length);
+			TokenSequence program{};
+			for (uint64_t index = begin; index < end; ++index)
+			{
+				uint64_t rest = index;
+				for (unsigned int i = length; i-- > 0; rest /= alphabet.size())
+					sequence[i] = alphabet[rest % alphabet.size()];
+				if (!SequenceCompiler{ sequence, program }.compile())
+					continue;
+
+				size_t value = tests;
+				size_t condition = tests;
+				for (size_t test = 0; test < tests; ++test)
+				{
+					const int64_t result = evaluate(program, inputs.data() + test * slotCount);
+					value = hash_combine(value, static_cast<size_t>(observe(RewriteContext::Value, result)));
+					condition = hash_combine(condition, static_cast<size_t>(observe(RewriteContext::Condition, result)));
+				}
+
+				++state.valid;
+				keep_best(state.values, value, sequence);
+				keep_best(state.conditions, condition, sequence);
+				if (length > 1 && is_canonical(sequence))
+					state.candidates.push_back({ sequence, value, condition });
+			}
+		});
+	}
+
+	EnumerationState& merged = states.front();
+	for (size_t i = 1; i < states.size(); ++i)
+	{
+		for (const auto& entry : states[i].values)
+			keep_best(merged.values, entry.first, entry.second);
+		for (const auto& entry : states[i].conditions)
+			keep_best(merged.conditions, entry.first, entry.second);
+		merged.candidates.insert(merged.candidates.end(), states[i].candidates.begin(), states[i].candidates.end());
+		merged.valid += states[i].valid;
+	}
+	_valid = merged.valid;
+	std::sort(merged.candidates.begin(), merged.candidates.end(),
+		[](const Candidate& left, const Candidate& right) { return is_better(left.sequence, right.sequence); });
+
+	std::vector<PendingRule> pending{};
+	for (const Candidate& candidate : merged.candidates)
+	{
+		TokenSequence slots{};
+		for (const ScriptCode symbol : candidate.sequence)
+			if (is_slot(symbol))
+				slots.push_back(symbol);
+
+		const TokenSequence& value = merged.values[candidate.value];
+		const bool valueRule = value.size() < candidate.sequence.size() && uses_only(value, slots);
+		if (valueRule)
+			pending.push_back({ RewriteContext::Value, &candidate.sequence, &value, false });
+
+		const TokenSequence& condition = merged.conditions[candidate.condition];
+		if (condition.size() < (valueRule ? value.size() : candidate.sequence.size()) && uses_only(condition, slots))
+			pending.push_back({ RewriteContext::Condition, &candidate.sequence, &condition, false });
+	}
+
+	std::vector<field_value_t> verification{};
+	for (field_value_t value = VERIFY_MIN; value <= VERIFY_MAX; ++value)
+		verification.push_back(value);
+	std::vector<field_value_t> checks = grid(slotCount, verification.data(), verification.size());
+	const std::vector<field_value_t> samples = random_inputs(slotCount, _samples, _seed + 1);
+	checks.insert(checks.end(), samples.begin(), samples.end());
+	const size_t checkCount = checks.size() / slotCount;
+
+	parallel_chunks(pending.size(), VERIFICATION_CHUNK, _threads, [&](unsigned int, uint64_t begin, uint64_t end) {
+		TokenSequence pattern{};
+		TokenSequence replacement{};
+		for (uint64_t i = begin; i < end; ++i)
+		{
+			PendingRule& rule = pending[i];
+			SequenceCompiler{ *rule.pattern, pattern }.compile();
+			SequenceCompiler{ *rule.replacement, replacement }.compile();
+
+			rule.verified = true;
+			for (size_t test = 0; test < checkCount && rule.verified; ++test)
+			{
+				const field_value_t* const values = checks.data() + test * slotCount;
+				rule.verified = observe(rule.context, evaluate(pattern, values)) == observe(rule.context, evaluate(replacement, values));
+			}
+		}
+	});
+
+	RewriteTable table{};
+	for (const PendingRule& rule : pending)
+		if (rule.verified)
+			table.add(rule.context, *rule.pattern, *rule.replacement);
+	return table;
+}
+
+uint64_t Superoptimizer::candidates() const { return _candidates; }
+uint64_t Superoptimizer::validCandidates() const { return _valid; }
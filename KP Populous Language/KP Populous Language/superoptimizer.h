@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <istream>
+#include <ostream>
+
+#include "script.h"
+#include "optimizer.h"
+
+#define REWRITE_TABLE_VERSION 1U
+#define SUPEROPT_MAX_SLOTS 4U
+#define SUPEROPT_CONSTANT_BASE 512U
+#define SUPEROPT_MAX_CONSTANT (TOKEN_OFFSET - SUPEROPT_CONSTANT_BASE)
+
+typedef std::vector<ScriptCode> TokenSequence;
+
+enum class RewriteContext : uint8_t
+{
+	Value,
+	Condition
+};
+
+struct TokenSequenceHash
+{
+	size_t operator() (const TokenSequence& sequence) const;
+};
+
+class RewriteTable
+{
+private:
+	std::unordered_map<TokenSequence, TokenSequence, TokenSequenceHash> _values;
+	std::unordered_map<TokenSequence, TokenSequence, TokenSequenceHash> _conditions;
+	size_t _maxLength;
+
+public:
+	RewriteTable();
+
+	size_t size() const;
+	size_t maxLength() const;
+
+	void add(RewriteContext context, const TokenSequence& pattern, const TokenSequence& replacement);
+	const TokenSequence* find(RewriteContext context, const TokenSequence& pattern) const;
+
+	OptimizationStats apply(Script& script) const;
+
+	bool read(std::istream& input);
+	void write(std::ostream& output) const;
+
+	bool readFromFile(const std::string& file);
+	bool writeToFile(const std::string& file) const;
+
+private:
+	bool rewrite(Script& script, RewriteContext context, std::vector<ScriptCode>& codes, size_t begin, size_t end) const;
+
+	const std::unordered_map<TokenSequence, TokenSequence, TokenSequenceHash>& rules(RewriteContext context) const;
+	std::unordered_map<TokenSequence, TokenSequence, TokenSequenceHash>& rules(RewriteContext context);
+};
+
+class Superoptimizer
+{
+private:
+	unsigned int _maxLength;
+	unsigned int _slots;
+	std::vector<field_value_t> _constants;
+	unsigned int _threads;
+	unsigned int _samples;
+	uint64_t _seed;
+	uint64_t _candidates;
+	uint64_t _valid;
+
+public:
+	Superoptimizer(unsigned int maxLength = 5, unsigned int slots = 2, const std::vector<field_value_t>& constants = { 0, 1 }, unsigned int threads = 0);
+
+	void setSamples(unsigned int samples);
+	void setSeed(uint64_t seed);
+
+	RewriteTable build();
+
+	uint64_t candidates() const;
+	uint64_t validCandidates() const;
+};
@@ -0,0 +1,256 @@
+#include "token_names.h"
+
+namespace
+{
+	struct TokenName
+	{
+		const char* name;
+		ScriptCode code;
+	};
+
+	constexpr TokenName TOKEN_NAMES[] = {
+		{ "If", InstructionToken::If },
+		{ "Else", InstructionToken::Else },
+		{ "Endif", InstructionToken::Endif },
+		{ "Begin", InstructionToken::Begin },
+		{ "End", InstructionToken::End },
+		{ "Every", InstructionToken::Every },
+		{ "Do", InstructionToken::Do },
+		{ "Set", InstructionToken::Set },
+		{ "Increment", InstructionToken::Increment },
+		{ "Decrement", InstructionToken::Decrement },
+		{ "ExpStart", InstructionToken::ExpStart },
+		{ "ExpEnd", InstructionToken::ExpEnd },
+		{ "GreaterThan", InstructionToken::GreaterThan },
+		{ "LessThan", InstructionToken::LessThan },
+		{ "Equalto", InstructionToken::Equalto },
+		{ "NotEqualTo", InstructionToken::NotEqualTo },
+		{ "GreaterThanEqualTo", InstructionToken::GreaterThanEqualTo },
+		{ "LessThanEqualTo", InstructionToken::LessThanEqualTo },
+		{ "ScriptEnd", InstructionToken::ScriptEnd },
+		{ "And", InstructionToken::And },
+		{ "Or", InstructionToken::Or },
+		{ "On", InstructionToken::On },
+		{ "Off", InstructionToken::Off },
+		{ "ComputerPlayer", InstructionToken::ComputerPlayer },
+		{ "Multiply", InstructionToken::Multiply },
+		{ "Divide", InstructionToken::Divide },
+		{ "CountWild", CommandValueToken::CountWild },
+		{ "AttackMarker", CommandValueToken::AttackMarker },
+		{ "AttackBuilding", CommandValueToken::AttackBuilding },
+		{ "AttackPerson", CommandValueToken::AttackPerson },
+		{ "AttackNormal", CommandValueToken::AttackNormal },
+		{ "AttackByBoat", CommandValueToken::AttackByBoat },
+		{ "AttackByBallon", CommandValueToken::AttackByBallon },
+		{ "GuardNormal", CommandValueToken::GuardNormal },
+		{ "GuardWithGhosts", CommandValueToken::GuardWithGhosts },
+		{ "Blue", CommandValueToken::Blue },
+		{ "Red", CommandValueToken::Red },
+		{ "Yellow", CommandValueToken::Yellow },
+		{ "Green", CommandValueToken::Green },
+		{ "ConstructBuilding", CommandToken::ConstructBuilding },
+		{ "FetchWood", CommandToken::FetchWood },
+		{ "ShamanGetWilds", CommandToken::ShamanGetWilds },
+		{ "HouseAPerson", CommandToken::HouseAPerson },
+		{ "SendGhosts", CommandToken::SendGhosts },
+		{ "BringNewPeopleBack", CommandToken::BringNewPeopleBack },
+		{ "TrainPeople", CommandToken::TrainPeople },
+		{ "PopulateDrumTower", CommandToken::PopulateDrumTower },
+		{ "Defend", CommandToken::Defend },
+		{ "DefendBase", CommandToken::DefendBase },
+		{ "SpellDefense", CommandToken::SpellDefense },
+		{ "Preach", CommandToken::Preach },
+		{ "BuildWalls", CommandToken::BuildWalls },
+		{ "Sabotage", CommandToken::Sabotage },
+		{ "SpellOffensive", CommandToken::SpellOffensive },
+		{ "FirewarriorDefend", CommandToken::FirewarriorDefend },
+		{ "BuildVehicle", CommandToken::BuildVehicle },
+		{ "FetchLostPeople", CommandToken::FetchLostPeople },
+		{ "FetchLostVehicle", CommandToken::FetchLostVehicle },
+		{ "FetchFarVehicle", CommandToken::FetchFarVehicle },
+		{ "AutoAttack", CommandToken::AutoAttack },
+		{ "ShamanDefend", CommandToken::ShamanDefend },
+		{ "FlattenBase", CommandToken::FlattenBase },
+		{ "BuildOuterDefences", CommandToken::BuildOuterDefences },
+		{ "Spare5", CommandToken::Spare5 },
+		{ "Spare6", CommandToken::Spare6 },
+		{ "Spare7", CommandToken::Spare7 },
+		{ "Spare8", CommandToken::Spare8 },
+		{ "Spare9", CommandToken::Spare9 },
+		{ "Spare10", CommandToken::Spare10 },
+		{ "Attack", CommandToken::Attack },
+		{ "AttackBlue", CommandToken::AttackBlue },
+		{ "AttackRed", CommandToken::AttackRed },
+		{ "AttackYellow", CommandToken::AttackYellow },
+		{ "AttackGreen", CommandToken::AttackGreen },
+		{ "SpellAttack", CommandToken::SpellAttack },
+		{ "ResetBaseMarker", CommandToken::ResetBaseMarker },
+		{ "SetBaseMarker", CommandToken::SetBaseMarker },
+		{ "SetBaseRadius", CommandToken::SetBaseRadius },
+		{ "CountPeopleInMarker", CommandToken::CountPeopleInMarker },
+		{ "SetDrumTowerPos", CommandToken::SetDrumTowerPos },
+		{ "ConvertAtMarker", CommandToken::ConvertAtMarker },
+		{ "PreachAtMarker", CommandToken::PreachAtMarker },
+		{ "SendGhostPeople", CommandToken::SendGhostPeople },
+		{ "GetSpellsCast", CommandToken::GetSpellsCast },
+		{ "GetNumOneOffSpells", CommandToken::GetNumOneOffSpells },
+		{ "SetAttackVariable", CommandToken::SetAttackVariable },
+		{ "BuildDrumTower", CommandToken::BuildDrumTower },
+		{ "GuardAtMarker", CommandToken::GuardAtMarker },
+		{ "GuardBetweenMarkers", CommandToken::GuardBetweenMarkers },
+		{ "GetHeightAtPos", CommandToken::GetHeightAtPos },
+		{ "SendAllPeopleToMarker", CommandToken::SendAllPeopleToMarker },
+		{ "ResetConvertMarker", CommandToken::ResetConvertMarker },
+		{ "SetConvertMarker", CommandToken::SetConvertMarker },
+		{ "SetMarkerEntry", CommandToken::SetMarkerEntry },
+		{ "MarkerEntries", CommandToken::MarkerEntries },
+		{ "ClearGuardingFrom", CommandToken::ClearGuardingFrom },
+		{ "SetBuildingDirection", CommandToken::SetBuildingDirection },
+		{ "TrainPeopleNow", CommandToken::TrainPeopleNow },
+		{ "PrayAtHead", CommandToken::PrayAtHead },
+		{ "PutPersonInDT", CommandToken::PutPersonInDT },
+		{ "IHaveOneShot", CommandToken::IHaveOneShot },
+		{ "SpellType", CommandToken::SpellType },
+		{ "BuildingType", CommandToken::BuildingType },
+		{ "BoatPatrol", CommandToken::BoatPatrol },
+		{ "DefendShamen", CommandToken::DefendShamen },
+		{ "SendShamenDefendersHome", CommandToken::SendShamenDefendersHome },
+		{ "BoatType", CommandToken::BoatType },
+		{ "BallonType", CommandToken::BallonType },
+		{ "IsBuildingNear", CommandToken::IsBuildingNear },
+		{ "BuildAt", CommandToken::BuildAt },
+		{ "SetSpellEntry", CommandToken::SetSpellEntry },
+		{ "DelayMainDrumTower", CommandToken::DelayMainDrumTower },
+		{ "BuildMainDrumTower", CommandToken::BuildMainDrumTower },
+		{ "ZoomTo", CommandToken::ZoomTo },
+		{ "DisableUserInputs", CommandToken::DisableUserInputs },
+		{ "EnableUserInputs", CommandToken::EnableUserInputs },
+		{ "OpenDialog", CommandToken::OpenDialog },
+		{ "GiveOneShot", CommandToken::GiveOneShot },
+		{ "ClearStandingPeople", CommandToken::ClearStandingPeople },
+		{ "OnlyStandAtMarkers", CommandToken::OnlyStandAtMarkers },
+		{ "NavCheck", CommandToken::NavCheck },
+		{ "TargetSWarriors", CommandToken::TargetSWarriors },
+		{ "DontTargetSWarriors", CommandToken::DontTargetSWarriors },
+		{ "TargetBlueShaman", CommandToken::TargetBlueShaman },
+		{ "DontTargetBlueShaman", CommandToken::DontTargetBlueShaman },
+		{ "TargetBlueDrumTowers", CommandToken::TargetBlueDrumTowers },
+		{ "DontTargetBlueDrumTowers", CommandToken::DontTargetBlueDrumTowers },
+		{ "HasBlueKilledAGhost", CommandToken::HasBlueKilledAGhost },
+		{ "CountGuardFires", CommandToken::CountGuardFires },
+		{ "GetHeadTriggerCount", CommandToken::GetHeadTriggerCount },
+		{ "MoveShamanToMarker", CommandToken::MoveShamanToMarker },
+		{ "TrackShamanToAngle", CommandToken::TrackShamanToAngle },
+		{ "TrackShamanExtraBollocks", CommandToken::TrackShamanExtraBollocks },
+		{ "IsShamanAvailableForAttack", CommandToken::IsShamanAvailableForAttack },
+		{ "PartialBuildingCount", CommandToken::PartialBuildingCount },
+		{ "SendBluePeopleToMarker", CommandToken::SendBluePeopleToMarker },
+		{ "GiveManaToPlayer", CommandToken::GiveManaToPlayer },
+		{ "IsPlayerInWorldView", CommandToken::IsPlayerInWorldView },
+		{ "SetAutoBuild", CommandToken::SetAutoBuild },
+		{ "DeselectAllBluePeople", CommandToken::DeselectAllBluePeople },
+		{ "FlashButton", CommandToken::FlashButton },
+		{ "TurnPanelOn", CommandToken::TurnPanelOn },
+		{ "GivePlayerSpell", CommandToken::GivePlayerSpell },
+		{ "HasPlayerBeenInEncyc", CommandToken::HasPlayerBeenInEncyc },
+		{ "IsBlueShamanSelected", CommandToken::IsBlueShamanSelected },
+		{ "ClearShamanLeftClick", CommandToken::ClearShamanLeftClick },
+		{ "ClearShamanRightClick", CommandToken::ClearShamanRightClick },
+		{ "IsShamanIconLeftClicked", CommandToken::IsShamanIconLeftClicked },
+		{ "IsShamanIconRightClicked", CommandToken::IsShamanIconRightClicked },
+		{ "TriggerThing", CommandToken::TriggerThing },
+		{ "TrackToMarker", CommandToken::TrackToMarker },
+		{ "CameraRotation", CommandToken::CameraRotation },
+		{ "StopCameraRotation", CommandToken::StopCameraRotation },
+		{ "CountBlueShapes", CommandToken::CountBlueShapes },
+		{ "CountBlueInHouses", CommandToken::CountBlueInHouses },
+		{ "HasHouseInfoBeenShown", CommandToken::HasHouseInfoBeenShown },
+		{ "ClearHouseInfoFlag", CommandToken::ClearHouseInfoFlag },
+		{ "SetAutoHouse", CommandToken::SetAutoHouse },
+		{ "CountBlueWithBuildCommand", CommandToken::CountBlueWithBuildCommand },
+		{ "DontHouseSpecialists", CommandToken::DontHouseSpecialists },
+		{ "TargetPlayerDTAndS", CommandToken::TargetPlayerDTAndS },
+		{ "RemovePlayerThing", CommandToken::RemovePlayerThing },
+		{ "SetReincarnation", CommandToken::SetReincarnation },
+		{ "ExtraWoodCollection", CommandToken::ExtraWoodCollection },
+		{ "SetWoodCollectionRadii", CommandToken::SetWoodCollectionRadii },
+		{ "GetNumPeopleConverted", CommandToken::GetNumPeopleConverted },
+		{ "GetNumPeopleBeingPreached", CommandToken::GetNumPeopleBeingPreached },
+		{ "TriggerLevelLost", CommandToken::TriggerLevelLost },
+		{ "TriggerLevelWin", CommandToken::TriggerLevelWin },
+		{ "RemoveHeadAtPos", CommandToken::RemoveHeadAtPos },
+		{ "SetBucketUsage", CommandToken::SetBucketUsage },
+		{ "SetBucketCountForSpell", CommandToken::SetBucketCountForSpell },
+		{ "CreateMsgNarrative", CommandToken::CreateMsgNarrative },
+		{ "CreateMsgObjective", CommandToken::CreateMsgObjective },
+		{ "CreateMsgInformation", CommandToken::CreateMsgInformation },
+		{ "CreateMsgInformationZoom", CommandToken::CreateMsgInformationZoom },
+		{ "SetMsgZoom", CommandToken::SetMsgZoom },
+		{ "SetMsgTimeout", CommandToken::SetMsgTimeout },
+		{ "SetMsgDeleteOnOk", CommandToken::SetMsgDeleteOnOk },
+		{ "SetMsgReturnOnOk", CommandToken::SetMsgReturnOnOk },
+		{ "SetMsgDeleteOnRmbZoom", CommandToken::SetMsgDeleteOnRmbZoom },
+		{ "SetMsgOpenDlgOnRmbZoom", CommandToken::SetMsgOpenDlgOnRmbZoom },
+		{ "SetMsgCreateReturnMsgOnRmbZoom", CommandToken::SetMsgCreateReturnMsgOnRmbZoom },
+		{ "SetMsgOpenDlgOnRmbDelete", CommandToken::SetMsgOpenDlgOnRmbDelete },
+		{ "SetMsgZoomOnLmbOpenDlg", CommandToken::SetMsgZoomOnLmbOpenDlg },
+		{ "SetMsgAutoOpenDlg", CommandToken::SetMsgAutoOpenDlg },
+		{ "SetSpecialNoBldgPanel", CommandToken::SetSpecialNoBldgPanel },
+		{ "SetMsgOkSaveExitDlg", CommandToken::SetMsgOkSaveExitDlg },
+		{ "FixWildInArea", CommandToken::FixWildInArea },
+		{ "CheckIfPersonPreachedTo", CommandToken::CheckIfPersonPreachedTo },
+		{ "CountAngels", CommandToken::CountAngels },
+		{ "SetNoBlueReinc", CommandToken::SetNoBlueReinc },
+		{ "IsShamanInArea", CommandToken::IsShamanInArea },
+		{ "ForceTooltip", CommandToken::ForceTooltip },
+		{ "SetDefenseRadius", CommandToken::SetDefenseRadius },
+		{ "MarvellousHouseDeath", CommandToken::MarvellousHouseDeath },
+		{ "CallToArms", CommandToken::CallToArms },
+		{ "DeleteSmokeStuff", CommandToken::DeleteSmokeStuff },
+		{ "SetTimerGoing", CommandToken::SetTimerGoing },
+		{ "RemoveTimer", CommandToken::RemoveTimer },
+		{ "HasTimerReachedZero", CommandToken::HasTimerReachedZero },
+		{ "StartReincNow", CommandToken::StartReincNow },
+		{ "TurnPush", CommandToken::TurnPush },
+		{ "FlybyCreateNow", CommandToken::FlybyCreateNow },
+		{ "FlybyStart", CommandToken::FlybyStart },
+		{ "FlybyStop", CommandToken::FlybyStop },
+		{ "FlybyAllowInterrupt", CommandToken::FlybyAllowInterrupt },
+		{ "FlybySetEventPos", CommandToken::FlybySetEventPos },
+		{ "FlybySetEventAngle", CommandToken::FlybySetEventAngle },
+		{ "FlybySetEventZoom", CommandToken::FlybySetEventZoom },
+		{ "FlybySetEventIntPoint", CommandToken::FlybySetEventIntPoint },
+		{ "FlybySetEventTooltip", CommandToken::FlybySetEventTooltip },
+		{ "FlybySetEndTarget", CommandToken::FlybySetEndTarget },
+		{ "FlybySetMessage", CommandToken::FlybySetMessage },
+		{ "KillTeamInArea", CommandToken::KillTeamInArea },
+		{ "ClearAllMsg", CommandToken::ClearAllMsg },
+		{ "SetMsgId", CommandToken::SetMsgId },
+		{ "getMsgId", CommandToken::getMsgId },
+		{ "KillAllMsgId", CommandToken::KillAllMsgId },
+		{ "GiveUpAndSulk", CommandToken::GiveUpAndSulk },
+		{ "AutoMessages", CommandToken::AutoMessages },
+		{ "IsPrisionOnLevel", CommandToken::IsPrisionOnLevel }
+	};
+}
+
+const char* token_name(ScriptCode code)
+{
+	for (const TokenName& token : TOKEN_NAMES)
+		if (token.code == code)
+			return token.name;
+	return nullptr;
+}
+
+bool find_token(const std::string& name, ScriptCode& code)
+{
+	for (const TokenName& token : TOKEN_NAMES)
+	{
+		if (name == token.name)
+		{
+			code = token.code;
+			return true;
+		}
+	}
+	return false;
+}
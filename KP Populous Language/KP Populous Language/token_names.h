@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+#include "config_and_consts.h"
+
+const char* token_name(ScriptCode code);
+bool find_token(const std::string& name, ScriptCode& code);
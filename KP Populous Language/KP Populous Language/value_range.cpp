@@ -0,0 +1,170 @@
+#include "value_range.h"
+
+#include <algorithm>
+
+namespace
+{
+	struct InternalRange
+	{
+		ScriptCode first;
+		ScriptCode last;
+		int64_t min;
+		int64_t max;
+	};
+
+	constexpr int64_t FIELD_MIN = INT32_MIN;
+	constexpr int64_t FIELD_MAX = INT32_MAX;
+
+	constexpr InternalRange INTERNAL_RANGES[] = {
+		{ ReadOnlyInternal::GameTurn, ReadOnlyInternal::GreenMana, 0, FIELD_MAX },
+		{ ReadOnlyInternal::MyMana, ReadOnlyInternal::MyNumKilledByGreen, 0, FIELD_MAX },
+		{ ReadOnlyInternal::MyVehicleBoat, ReadOnlyInternal::CpFreeEntries, 0, FIELD_MAX },
+		{ ReadOnlyInternal::Random100, ReadOnlyInternal::Random100, 0, 99 },
+		{ ReadOnlyInternal::NumShamenDefenders, ReadOnlyInternal::NumShamenDefenders, 0, FIELD_MAX },
+		{ ReadOnlyInternal::MySpellShieldCost, ReadOnlyInternal::MySpellShieldCost, 0, FIELD_MAX },
+
+		{ AttributeInternal::Expansion, AttributeInternal::Expansion, 0, 100 },
+		{ AttributeInternal::HousePercentage, AttributeInternal::AwayReligious, 0, 100 },
+		{ AttributeInternal::AwaySpy, AttributeInternal::AwayShaman, 0, 100 },
+		{ AttributeInternal::RetreatValue, AttributeInternal::BaseUnderAttackRetreat, 0, 100 },
+		{ AttributeInternal::SpyDiscoverChance, AttributeInternal::SpyDiscoverChance, 0, 100 }
+	};
+
+	ValueRange clamp(int64_t min, int64_t max)
+	{
+		if (min < FIELD_MIN || max > FIELD_MAX)
+			return ValueRange::full();
+		return { min, max };
+	}
+}
+
+bool ValueRange::empty() const { return min > max; }
+bool ValueRange::isConstant() const { return min == max; }
+bool ValueRange::contains(int64_t value) const { return value >= min && value <= max; }
+
+bool ValueRange::alwaysTrue() const { return !empty() && !contains(0); }
+bool ValueRange::alwaysFalse() const { return min == 0 && max == 0; }
+
+ValueRange ValueRange::join(const ValueRange& other) const
+{
+	if (empty())
+		return other;
+	if (other.empty())
+		return *this;
+	return { std::min(min, other.min), std::max(max, other.max) };
+}
+
+ValueRange ValueRange::intersect(const ValueRange& other) const { return { std::max(min, other.min), std::min(max, other.max) }; }
+
+ValueRange ValueRange::operator+ (const ValueRange& other) const { return clamp(min + other.min, max + other.max); }
+ValueRange ValueRange::operator- (const ValueRange& other) const { return clamp(min - other.max, max - other.min); }
+
+ValueRange ValueRange::operator* (const ValueRange& other) const
+{
+	if (*this == full() || other == full())
+		return full();
+
+	const int64_t products[] = { min * other.min, min * other.max, max * other.min, max * other.max };
+	return clamp(*std::min_element(products, products + 4), *std::max_element(products, products + 4));
+}
+
+ValueRange ValueRange::operator/ (const ValueRange& other) const
+{
+	if (other.contains(0))
+		return full();
+
+	const int64_t quotients[] = { min / other.min, min / other.max, max / other.min, max / other.max };
+	return clamp(*std::min_element(quotients, quotients + 4), *std::max_element(quotients, quotients + 4));
+}
+
+bool ValueRange::operator== (const ValueRange& other) const { return min == other.min && max == other.max; }
+bool ValueRange::operator!= (const ValueRange& other) const { return min != other.min || max != other.max; }
+
+ValueRange ValueRange::full() { return { FIELD_MIN, FIELD_MAX }; }
+ValueRange ValueRange::constant(int64_t value) { return { value, value }; }
+ValueRange ValueRange::boolean() { return { 0, 1 }; }
+
+ValueRange ValueRange::compare(const ValueRange& left, ScriptCode op, const ValueRange& right)
+{
+	bool always, never;
+	switch (op)
+	{
+		case InstructionToken::GreaterThan:
+			always = left.min > right.max, never = left.max <= right.min;
+			break;
+		case InstructionToken::LessThan:
+			always = left.max < right.min, never = left.min >= right.max;
+			break;
+		case InstructionToken::GreaterThanEqualTo:
+			always = left.min >= right.max, never = left.max < right.min;
+			break;
+		case InstructionToken::LessThanEqualTo:
+			always = left.max <= right.min, never = left.min > right.max;
+			break;
+		case InstructionToken::Equalto:
+			always = left.isConstant() && left == right, never = left.intersect(right).empty();
+			break;
+		case InstructionToken::NotEqualTo:
+			always = left.intersect(right).empty(), never = left.isConstant() && left == right;
+			break;
+		default:
+			return boolean();
+	}
+	return always ? constant(1) : never ? constant(0) : boolean();
+}
+
+ValueRange ValueRange::narrow(const ValueRange& left, ScriptCode op, const ValueRange& right)
+{
+	switch (op)
+	{
+		case InstructionToken::GreaterThan: return { std::max(left.min, right.min + 1), left.max };
+		case InstructionToken::LessThan: return { left.min, std::min(left.max, right.max - 1) };
+		case InstructionToken::GreaterThanEqualTo: return { std::max(left.min, right.min), left.max };
+		case InstructionToken::LessThanEqualTo: return { left.min, std::min(left.max, right.max) };
+		case InstructionToken::Equalto: return left.intersect(right);
+		case InstructionToken::NotEqualTo:
+			if (!right.isConstant())
+				return left;
+			if (right.min == left.min)
+				return { left.min + 1, left.max };
+			if (right.min == left.max)
+				return { left.min, left.max - 1 };
+			return left;
+		default:
+			return left;
+	}
+}
+
+ScriptCode ValueRange::negate(ScriptCode op)
+{
+	switch (op)
+	{
+		case InstructionToken::GreaterThan: return InstructionToken::LessThanEqualTo;
+		case InstructionToken::LessThan: return InstructionToken::GreaterThanEqualTo;
+		case InstructionToken::GreaterThanEqualTo: return InstructionToken::LessThan;
+		case InstructionToken::LessThanEqualTo: return InstructionToken::GreaterThan;
+		case InstructionToken::Equalto: return InstructionToken::NotEqualTo;
+		case InstructionToken::NotEqualTo: return InstructionToken::Equalto;
+		default: return op;
+	}
+}
+
+ScriptCode ValueRange::swap(ScriptCode op)
+{
+	switch (op)
+	{
+		case InstructionToken::GreaterThan: return InstructionToken::LessThan;
+		case InstructionToken::LessThan: return InstructionToken::GreaterThan;
+		case InstructionToken::GreaterThanEqualTo: return InstructionToken::LessThanEqualTo;
+		case InstructionToken::LessThanEqualTo: return InstructionToken::GreaterThanEqualTo;
+		default: return op;
+	}
+}
+
+ValueRange ValueRange::ofInternal(ScriptCode internal)
+{
+	for (const InternalRange& range : INTERNAL_RANGES)
+		if (internal >= range.first && internal <= range.last)
+			return { range.min, range.max };
+	return full();
+}
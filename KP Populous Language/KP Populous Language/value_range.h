@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cinttypes>
+
+#include "config_and_consts.h"
+
+struct ValueRange
+{
+	int64_t min;
+	int64_t max;
+
+	bool empty() const;
+	bool isConstant() const;
+	bool contains(int64_t value) const;
+
+	bool alwaysTrue() const;
+	bool alwaysFalse() const;
+
+	ValueRange join(const ValueRange& other) const;
+	ValueRange intersect(const ValueRange& other) const;
+
+	ValueRange operator+ (const ValueRange& other) const;
+	ValueRange operator- (const ValueRange& other) const;
+	ValueRange operator* (const ValueRange& other) const;
+	ValueRange operator/ (const ValueRange& other) const;
+
+	bool operator== (const ValueRange& other) const;
+	bool operator!= (const ValueRange& other) const;
+
+	static ValueRange full();
+	static ValueRange constant(int64_t value);
+	static ValueRange boolean();
+
+	static ValueRange compare(const ValueRange& left, ScriptCode op, const ValueRange& right);
+	static ValueRange narrow(const ValueRange& left, ScriptCode op, const ValueRange& right);
+	static ScriptCode negate(ScriptCode op);
+	static ScriptCode swap(ScriptCode op);
+
+	static ValueRange ofInternal(ScriptCode internal);
+};
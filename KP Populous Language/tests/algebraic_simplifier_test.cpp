@@ -0,0 +1,83 @@
+#include <cassert>
+#include <cinttypes>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+
+#include "optimizer.h"
+
+namespace
+{
+	const unsigned int EXPRESSIONS = 20000;
+	const field_value_t INPUTS[] = { INT32_MIN, -1073741824, -1000000, -4097, -200, -101, -100, -99, -3, -2, -1, 0, 1, 2, 3, 99, 100, 101, 200, 4097, 65536, 1000000, 1073741824, INT32_MAX };
+
+	class ExpressionGenerator
+	{
+	private:
+		std::mt19937 _random;
+
+	public:
+		ExpressionGenerator(unsigned int seed) : _random{ seed } {}
+
+		Statement* comparison()
+		{
+			static const Operator* const comparisons[] = { &Operator::GreaterThan, &Operator::SmallerThan, &Operator::GreaterEqualsThan,
+				&Operator::SmallerEqualsThan, &Operator::EqualsTo, &Operator::NotEqualsTo };
+			Statement* const left = pick(2) ? arithmetic(3) : constant();
+			Statement* const right = pick(4) ? arithmetic(2) : constant();
+			return new Operation{ Operation::make(*comparisons[pick(6)], left, right) };
+		}
+
+		Statement* arithmetic(unsigned int depth)
+		{
+			if (depth == 0 || pick(4) == 0)
+				return pick(3) ? static_cast<Statement*>(new Identifier{ "x" }) : constant();
+
+			const Operator& oper = pick(2) ? Operator::Multiplication : Operator::Division;
+			Statement* const left = arithmetic(depth - 1);
+			return new Operation{ Operation::make(oper, left, pick(4) ? constant() : arithmetic(depth - 1)) };
+		}
+
+	private:
+		unsigned int pick(unsigned int count) { return std::uniform_int_distribution<unsigned int>{ 0, count - 1 }(_random); }
+
+		Statement* constant()
+		{
+			static const field_value_t values[] = { -7, -2, -1, 0, 1, 2, 3, 4, 5, 10, 50, 100, 200, 1000, 65536 };
+			return new LiteralInteger{ values[pick(sizeof(values) / sizeof(values[0]))] };
+		}
+	};
+}
+
+int main()
+{
+	ExpressionGenerator generator{ 20261019 };
+	const AlgebraicSimplifier simplifier{};
+	unsigned int checked = 0;
+	for (unsigned int i = 0; i < EXPRESSIONS; ++i)
+	{
+		const std::unique_ptr<Statement> original{ i % 2 ? generator.comparison() : generator.arithmetic(4) };
+		const std::unique_ptr<Statement> simplified{ simplifier.simplify(*original) };
+		for (const field_value_t x : INPUTS)
+		{
+			ConstantEvaluator evaluator{};
+			evaluator.define("x", x);
+			const std::optional<field_value_t> expected = evaluator.evaluate(*original);
+			if (!expected)
+				continue;
+
+			const std::optional<field_value_t> actual = evaluator.evaluate(*simplified);
+			if (!actual || *actual != *expected)
+			{
+				std::cerr << original->toString() << " => " << simplified->toString() << " differs at x = " << x << std::endl;
+				return 1;
+			}
+			++checked;
+		}
+	}
+	assert(checked > EXPRESSIONS);
+
+	std::cout << "algebraic_simplifier_test passed (" << checked << " evaluations)" << std::endl;
+	return 0;
+}
@@ -0,0 +1,86 @@
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "server.h"
+
+namespace
+{
+	class CompileClient
+	{
+	private:
+		CompileServer& _server;
+		int _nextId;
+
+	public:
+		CompileClient(CompileServer& server) : _server{ server }, _nextId{ 1 } {}
+
+		std::string call(const std::string& method, const std::string& params = "{}")
+		{
+			return _server.handle("{\"jsonrpc\":\"2.0\",\"id\":" + std::to_string(_nextId++) +
+				",\"method\":\"" + method + "\",\"params\":" + params + "}");
+		}
+	};
+
+	bool contains(const std::string& text, const std::string& part) { return text.find(part) != std::string::npos; }
+}
+
+int main()
+{
+	const std::string file = "compile_server_test.scr";
+	Script script{};
+	script.codeData[0] = SCRIPT_VERSION;
+	script.codeData[1] = InstructionToken::ScriptEnd;
+	script.writeToFile(file);
+
+	CompileServer server{};
+	CompileClient client{ server };
+
+	const std::pair<std::string, std::string> replies[] = {
+		{ client.call("types"), "\"result\":[" },
+		{ client.call("hover", "{\"name\":\"Integer\"}"), "\"kind\":\"type\"" },
+		{ client.call("hover"), "\"code\":-32602" },
+		{ client.call("unknown"), "\"code\":-32601" },
+		{ server.handle("{\"id\":1,"), "\"code\":-32700" },
+		{ client.call("load", "{\"file\":\"missing_script.scr\"}"), "\"error\":{\"code\":-32602" },
+		{ client.call("diagnostics", "{\"file\":\"missing_script.scr\"}"), "is not loaded" },
+		{ client.call("load", "{\"file\":\"" + file + "\"}"), "\"codes\":1" },
+		{ client.call("diagnostics", "{\"file\":\"" + file + "\"}"), "\"result\":[]" },
+		{ client.call("unload", "{\"file\":\"" + file + "\"}"), "\"result\":true" },
+		{ client.call("unload", "{\"file\":\"" + file + "\"}"), "\"result\":false" }
+	};
+	std::remove(file.c_str());
+	for (const std::pair<std::string, std::string>& reply : replies)
+	{
+		if (!contains(reply.first, reply.second))
+		{
+			std::cerr << "compile_server_test: expected " << reply.second << " in " << reply.first << std::endl;
+			return 1;
+		}
+	}
+
+	std::istringstream input{
+		"{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"types\"}\n"
+		"\n"
+		"{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"shutdown\"}\n"
+		"{\"jsonrpc\":\"2.0\",\"id\":3,\"method\":\"types\"}\n" };
+	std::ostringstream output{};
+	CompileServer session{};
+	session.run(input, output);
+
+	std::vector<std::string> lines{};
+	std::istringstream stream{ output.str() };
+	for (std::string line{}; std::getline(stream, line);)
+		lines.push_back(line);
+	if (lines.size() != 2 || !contains(lines[1], "\"id\":2") || session.isRunning())
+	{
+		std::cerr << "compile_server_test: session did not stop after shutdown:\n" << output.str() << std::endl;
+		return 1;
+	}
+
+	std::cout << "compile_server_test passed" << std::endl;
+	return 0;
+}
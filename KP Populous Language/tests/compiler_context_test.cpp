@@ -0,0 +1,87 @@
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "compiler_context.h"
+#include "ir.h"
+
+namespace
+{
+	const unsigned int THREADS = 8;
+	const unsigned int COMPILES = 200;
+
+	bool compile(CompilerContext& context, unsigned int seed)
+	{
+		IrFunction function{};
+		IrBuilder builder{ function };
+
+		const IrValue turn = builder.internal(ReadOnlyInternal::GameTurn);
+		const IrValue limit = builder.constant(static_cast<field_value_t>(seed % 50));
+		const uint32_t branch = builder.beginIf(builder.binary(IrOpcode::GreaterThan, turn, limit));
+		builder.store("counter", builder.binary(IrOpcode::Add, builder.load("counter"), builder.constant(1)));
+		builder.beginElse(branch);
+		builder.store("counter", builder.constant(static_cast<field_value_t>(seed)));
+		builder.endIf(branch);
+
+		ScriptCodeBuilder fragment{};
+		const Result<void> emitted = IrEmitter{ context }.emit(function, fragment);
+		if (!emitted)
+			return false;
+		fragment.push_back(InstructionToken::ScriptEnd);
+		const Result<void> placed = context.tryEmit(fragment);
+		if (!placed)
+			return false;
+
+		return context.types().getType("Spell") == DataType::spell() &&
+			context.types().findTypeFromValueName("Blast") == DataType::spell() &&
+			context.types().findTypeFromValue(ReadOnlyInternal::Brave) == DataType::follower() &&
+			!context.types().getType("Unknown");
+	}
+}
+
+int main()
+{
+	std::vector<Script> expected(COMPILES);
+	for (unsigned int i = 0; i < COMPILES; ++i)
+	{
+		CompilerContext context{};
+		if (!compile(context, i))
+		{
+			std::cerr << "compiler_context_test: compile " << i << " failed" << std::endl;
+			return 1;
+		}
+		expected[i] = context.script();
+	}
+
+	std::vector<std::thread> threads{};
+	std::vector<unsigned int> mismatches(THREADS, 0);
+	for (unsigned int t = 0; t < THREADS; ++t)
+	{
+		threads.emplace_back([t, &expected, &mismatches]() {
+			CompilerContext context{};
+			for (unsigned int i = 0; i < COMPILES; ++i)
+			{
+				const unsigned int seed = (i + t * 7) % COMPILES;
+				context.reset();
+				if (!compile(context, seed) || std::memcmp(context.script().data, expected[seed].data, SCRIPT_SIZE) != 0)
+					++mismatches[t];
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+
+	for (unsigned int t = 0; t < THREADS; ++t)
+	{
+		if (mismatches[t] != 0)
+		{
+			std::cerr << "compiler_context_test: thread " << t << " produced " << mismatches[t] << " mismatches" << std::endl;
+			return 1;
+		}
+	}
+
+	std::cout << "compiler_context_test passed" << std::endl;
+	return 0;
+}